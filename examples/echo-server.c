@@ -44,54 +44,6 @@ struct message_s
 
 unsigned char stop_loop = 0;
 
-int transmission_callback(void *context,
-                          unsigned char *payload,
-                          unsigned int payload_size)
-{
-  struct message_s *message = (struct message_s *) context;
-  unsigned int size = message->size - message->done;
-
-  if(size == 0)
-  {
-    return(-1);
-  }
-  size = (payload_size < size) ? payload_size : size;
-  memcpy(payload, &message->data[message->done], size);
-  message->done += size;
-  return(size);
-}
-
-void transmit(unsigned char *data,
-              unsigned int size,
-              unsigned long int frequency)
-{
-  struct message_s message = {data, size, 0};
-  dsss_transfer_t transfer = dsss_transfer_create_callback(RADIO_DRIVER,
-                                                           1,
-                                                           transmission_callback,
-                                                           (void *) &message,
-                                                           SAMPLE_RATE,
-                                                           BIT_RATE,
-                                                           frequency,
-                                                           FREQUENCY_OFFSET,
-                                                           TRANSMISSION_GAIN,
-                                                           0,
-                                                           SPREADING_FACTOR,
-                                                           INNER_FEC,
-                                                           OUTER_FEC,
-                                                           "",
-                                                           NULL,
-                                                           0,
-                                                           0);
-  if(transfer == NULL)
-  {
-    return;
-  }
-  dsss_transfer_start(transfer);
-  sleep(1); /* Give time to the hackrf to send the last samples */
-  dsss_transfer_free(transfer);
-}
-
 int reception_callback(void *context,
                        unsigned char *payload,
                        unsigned int payload_size)
@@ -99,6 +51,7 @@ int reception_callback(void *context,
   struct message_s *message = (struct message_s *) context;
   unsigned int size = message->size;
 
+  /* The payload is a complete message, the request can be processed */
   size = (payload_size < size) ? payload_size : size;
   memcpy(message->data, payload, size);
   message->done = size;
@@ -106,15 +59,15 @@ int reception_callback(void *context,
   return(payload_size);
 }
 
-void receive_1(unsigned char *data,
-               unsigned int *size,
-               unsigned long int frequency)
+/* Open the radio once and keep it for all the exchanges, switching between
+ * reception and transmission only takes a few milliseconds */
+dsss_transfer_t open_session(unsigned long int frequency,
+                             struct message_s *message)
 {
-  struct message_s message = {data, *size, 0};
   dsss_transfer_t transfer = dsss_transfer_create_callback(RADIO_DRIVER,
                                                            0,
-                                                           reception_callback,
-                                                           (void *) &message,
+                                                           NULL,
+                                                           NULL,
                                                            SAMPLE_RATE,
                                                            BIT_RATE,
                                                            frequency,
@@ -130,11 +83,35 @@ void receive_1(unsigned char *data,
                                                            0);
   if(transfer == NULL)
   {
-    return;
+    return(NULL);
   }
+  dsss_transfer_set_message_mode(transfer,
+                                 reception_callback,
+                                 (void *) message);
+  return(transfer);
+}
+
+void transmit(dsss_transfer_t transfer,
+              unsigned char *data,
+              unsigned int size)
+{
+  dsss_transfer_set_direction(transfer, 1, TRANSMISSION_GAIN);
+  dsss_transfer_send_message(transfer, data, size);
+  dsss_transfer_send_message(transfer, NULL, 0);
   dsss_transfer_start(transfer);
-  dsss_transfer_free(transfer);
-  *size = message.done;
+}
+
+void receive_1(dsss_transfer_t transfer,
+               struct message_s *message,
+               unsigned char *data,
+               unsigned int *size)
+{
+  message->data = data;
+  message->size = *size;
+  message->done = 0;
+  dsss_transfer_set_direction(transfer, 0, RECEPTION_GAIN);
+  dsss_transfer_start(transfer);
+  *size = message->done;
 }
 
 void process_request(unsigned char *data, unsigned int size)
@@ -154,38 +131,52 @@ void server(unsigned long int frequency)
 {
   unsigned char data[1024];
   unsigned int size;
+  struct message_s message;
+  dsss_transfer_t transfer = open_session(frequency, &message);
 
+  if(transfer == NULL)
+  {
+    return;
+  }
   while(!stop_loop)
   {
     size = sizeof(data) - 1;
-    receive_1(data, &size, frequency);
+    receive_1(transfer, &message, data, &size);
     if(stop_loop)
     {
-      return;
+      break;
     }
     data[size] = '\0';
     printf("\nReceived: %s\n", data);
     process_request(data, size);
     printf("Sending: %s\n", data);
-    sleep(1);
+    usleep(100000); /* Give time to the client to switch to reception */
     if(stop_loop)
     {
-      return;
+      break;
     }
-    transmit(data, size, frequency);
+    transmit(transfer, data, size);
   }
+  dsss_transfer_free(transfer);
 }
 
 void client(unsigned char *data, unsigned int size, unsigned long int frequency)
 {
   unsigned char buffer[1024];
   unsigned int n = sizeof(buffer) - 1;
+  struct message_s message;
+  dsss_transfer_t transfer = open_session(frequency, &message);
 
+  if(transfer == NULL)
+  {
+    return;
+  }
   printf("\nSending: %s\n", data);
-  transmit(data, size, frequency);
-  receive_1(buffer, &n, frequency);
+  transmit(transfer, data, size);
+  receive_1(transfer, &message, buffer, &n);
   buffer[n] = '\0';
   printf("Received: %s\n", buffer);
+  dsss_transfer_free(transfer);
 }
 
 void signal_handler(int signum)
@@ -18,7 +18,6 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <dsss-transfer.h>
-#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,6 +34,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define SPREADING_FACTOR 16
 #define INNER_FEC "none"
 #define OUTER_FEC "secded3932"
+#define ARQ_WINDOW 16
 
 void usage()
 {
@@ -47,23 +47,12 @@ void signal_handler(int signum)
   dsss_transfer_stop_all();
 }
 
-void * transfer_thread(void *arg)
-{
-  dsss_transfer_t *transfer = (dsss_transfer_t *) arg;
-
-  dsss_transfer_start(*transfer);
-
-  return(NULL);
-}
-
 int main(int argc, char **argv)
 {
   unsigned long int downlink_frequency;
   dsss_transfer_t downlink;
-  pthread_t downlink_thread;
   unsigned long int uplink_frequency;
   dsss_transfer_t uplink;
-  pthread_t uplink_thread;
 
   if(argc != 3)
   {
@@ -118,17 +107,23 @@ int main(int argc, char **argv)
     return(EXIT_FAILURE);
   }
 
-  if(pthread_create(&downlink_thread, NULL, transfer_thread, &downlink) != 0)
+  /* Retransmit the frames that the peer didn't receive, and adapt the FEC
+   * codes to the quality of the link */
+  dsss_transfer_set_arq(downlink, uplink, ARQ_WINDOW);
+  dsss_transfer_set_adaptive_rate(uplink, 1);
+
+  /* Each transfer runs in its own thread of the library */
+  if(dsss_transfer_start_async(downlink) != 0)
   {
-    fprintf(stderr, "Error: Failed to start downlink thread.\n");
+    fprintf(stderr, "Error: Failed to start downlink.\n");
     return(EXIT_FAILURE);
   }
 
-  if(pthread_create(&uplink_thread, NULL, transfer_thread, &uplink) != 0)
+  if(dsss_transfer_start_async(uplink) != 0)
   {
-    fprintf(stderr, "Error: Failed to start uplink thread.\n");
-    dsss_transfer_stop_all();
-    pthread_join(downlink_thread, NULL);
+    fprintf(stderr, "Error: Failed to start uplink.\n");
+    dsss_transfer_stop(downlink);
+    dsss_transfer_wait(downlink);
     dsss_transfer_free(downlink);
     return(EXIT_FAILURE);
   }
@@ -138,8 +133,8 @@ int main(int argc, char **argv)
   signal(SIGABRT, &signal_handler);
   fprintf(stderr, "Use CTRL-C to quit.\n");
 
-  pthread_join(uplink_thread, NULL);
-  pthread_join(downlink_thread, NULL);
+  dsss_transfer_wait(uplink);
+  dsss_transfer_wait(downlink);
   dsss_transfer_free(uplink);
   dsss_transfer_free(downlink);
   fprintf(stderr, "\n");
@@ -0,0 +1,408 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <complex.h>
+#include <liquid/liquid.h>
+#include <math.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <time.h>
+#include "acquisition.h"
+#include "dsssframe.h"
+
+#define TAU (2 * M_PI)
+
+#define MIN(x, y) ((x < y) ? x : y)
+#define MAX(x, y) ((x > y) ? x : y)
+
+/* Characteristics of the preamble sent by the frame generator */
+#define FILTER_DELAY 7
+#define FILTER_EXCESS_BANDWIDTH 0.25
+
+/* Number of input samples processed at once */
+#define CHUNK_SIZE 1024
+
+/* The preamble is searched by correlating the received samples with the
+ * reference preamble by segments and by doing a FFT of the partial
+ * correlations. Each bin of the FFT gives the correlation for a different
+ * carrier frequency offset, which allows searching the whole frequency range
+ * in parallel. */
+struct acquisition_s
+{
+  float rate;
+  unsigned int preamble_size;
+  nco_crcf oscillator;
+  msresamp_crcf resampler;
+  complex float *chunk;
+  complex float *resampled;
+  windowcf window;
+  complex float *reference;
+  unsigned int reference_size;
+  float reference_energy;
+  unsigned int segment_size;
+  unsigned int segments;
+  unsigned int fft_size;
+  complex float *fft_input;
+  complex float *fft_output;
+  fftplan fft;
+  float threshold;
+  unsigned int step;
+  unsigned int step_counter;
+  unsigned int holdoff;
+  float peak_metric;
+  float peak_offset;
+  unsigned int peak_age;
+  unsigned int peak_timeout;
+  unsigned int delay;
+  unsigned long int detections;
+  clock_t cpu_time;
+};
+
+int acquisition_make_reference(acquisition_t acquisition,
+                               unsigned int samples_per_chip)
+{
+  firinterp_crcf interpolator;
+  msequence ms;
+  unsigned int preamble_size = acquisition->preamble_size;
+  unsigned int size = (preamble_size + (2 * FILTER_DELAY)) * samples_per_chip;
+  complex float *buffer;
+  complex float symbol;
+  unsigned int i;
+
+  /* Long preambles with many samples per chip don't fit on the stack */
+  buffer = malloc(size * sizeof(complex float));
+  if(buffer == NULL)
+  {
+    return(-1);
+  }
+
+  /* Same preamble as the one made by the frame generator */
+  interpolator = firinterp_crcf_create_prototype(LIQUID_FIRFILT_ARKAISER,
+                                                 samples_per_chip,
+                                                 FILTER_DELAY,
+                                                 FILTER_EXCESS_BANDWIDTH,
+                                                 0);
+  ms = dsssframe_create_preamble_msequence(preamble_size);
+  for(i = 0; i < preamble_size + (2 * FILTER_DELAY); i++)
+  {
+    if(i < preamble_size)
+    {
+      symbol = msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2;
+      symbol += (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2) * _Complex_I;
+    }
+    else
+    {
+      symbol = 0;
+    }
+    firinterp_crcf_execute(interpolator,
+                           symbol,
+                           &buffer[i * samples_per_chip]);
+  }
+  msequence_destroy(ms);
+  firinterp_crcf_destroy(interpolator);
+
+  /* Skip the delay of the interpolation filter, and keep the conjugate
+   * of the samples for the correlation */
+  acquisition->reference_energy = 0;
+  for(i = 0; i < acquisition->reference_size; i++)
+  {
+    symbol = buffer[(FILTER_DELAY * samples_per_chip) + i];
+    acquisition->reference[i] = conjf(symbol);
+    acquisition->reference_energy += crealf(symbol * conjf(symbol));
+  }
+  free(buffer);
+
+  return(0);
+}
+
+acquisition_t acquisition_create(float sample_rate,
+                                 float chip_rate,
+                                 float center_frequency,
+                                 float range,
+                                 unsigned int preamble_size)
+{
+  unsigned int samples_per_chip;
+  unsigned int oversampling;
+  acquisition_t acquisition;
+
+  if((sample_rate <= 0) || (chip_rate <= 0) || (range <= 0) ||
+     (preamble_size == 0))
+  {
+    return(NULL);
+  }
+
+  acquisition = malloc(sizeof(struct acquisition_s));
+  if(acquisition == NULL)
+  {
+    return(NULL);
+  }
+  bzero(acquisition, sizeof(struct acquisition_s));
+
+  /* The samples must contain the whole bandwidth of the signal for all the
+   * frequency offsets in the search range, but not more than the bandwidth
+   * of the input samples */
+  oversampling = ceilf(((1.25 * chip_rate) + (2 * range)) / (2 * chip_rate));
+  while((oversampling > 1) && (2 * oversampling * chip_rate > sample_rate))
+  {
+    oversampling--;
+  }
+  samples_per_chip = 2 * oversampling;
+  acquisition->rate = samples_per_chip * chip_rate;
+
+  acquisition->oscillator = nco_crcf_create(LIQUID_NCO);
+  nco_crcf_set_phase(acquisition->oscillator, 0);
+  nco_crcf_set_frequency(acquisition->oscillator,
+                         TAU * (center_frequency / sample_rate));
+  acquisition->resampler = msresamp_crcf_create(acquisition->rate / sample_rate,
+                                                60);
+
+  acquisition->preamble_size = preamble_size;
+  acquisition->reference_size = preamble_size * samples_per_chip;
+  acquisition->window = windowcf_create(acquisition->reference_size);
+
+  /* Make the segments short enough to keep the phase rotation in a segment
+   * below a quarter of a turn for the largest offset */
+  acquisition->segment_size = floorf(acquisition->rate / (4 * range));
+  acquisition->segment_size = MIN(MAX(acquisition->segment_size, 1),
+                                  acquisition->reference_size);
+  acquisition->segments = (acquisition->reference_size +
+                           acquisition->segment_size - 1) / acquisition->segment_size;
+  /* Zero padding to get a finer frequency resolution */
+  acquisition->fft_size = 1;
+  while(acquisition->fft_size < 2 * acquisition->segments)
+  {
+    acquisition->fft_size *= 2;
+  }
+
+  /* Computing the correlation twice per chip is enough to find the peak */
+  acquisition->step = oversampling;
+  acquisition->step_counter = 0;
+  acquisition->peak_timeout = 2 * samples_per_chip;
+  acquisition->threshold = 0.5;
+
+  acquisition->chunk = malloc(CHUNK_SIZE * sizeof(complex float));
+  acquisition->resampled = malloc((ceilf(CHUNK_SIZE * (acquisition->rate / sample_rate)) + 16) *
+                                  sizeof(complex float));
+  acquisition->reference = malloc(acquisition->reference_size * sizeof(complex float));
+  acquisition->fft_input = malloc(acquisition->fft_size * sizeof(complex float));
+  acquisition->fft_output = malloc(acquisition->fft_size * sizeof(complex float));
+  if((acquisition->chunk == NULL) ||
+     (acquisition->resampled == NULL) ||
+     (acquisition->reference == NULL) ||
+     (acquisition->fft_input == NULL) ||
+     (acquisition->fft_output == NULL))
+  {
+    acquisition_free(acquisition);
+    return(NULL);
+  }
+  acquisition->fft = fft_create_plan(acquisition->fft_size,
+                                     acquisition->fft_input,
+                                     acquisition->fft_output,
+                                     LIQUID_FFT_FORWARD,
+                                     0);
+  if(acquisition_make_reference(acquisition, samples_per_chip) < 0)
+  {
+    acquisition_free(acquisition);
+    return(NULL);
+  }
+
+  acquisition->delay = ceilf((acquisition->reference_size +
+                              acquisition->peak_timeout +
+                              acquisition->step +
+                              msresamp_crcf_get_delay(acquisition->resampler)) *
+                             (sample_rate / acquisition->rate));
+
+  return(acquisition);
+}
+
+void acquisition_free(acquisition_t acquisition)
+{
+  if(acquisition)
+  {
+    if(acquisition->fft)
+    {
+      fft_destroy_plan(acquisition->fft);
+    }
+    free(acquisition->fft_output);
+    free(acquisition->fft_input);
+    free(acquisition->reference);
+    free(acquisition->resampled);
+    free(acquisition->chunk);
+    windowcf_destroy(acquisition->window);
+    msresamp_crcf_destroy(acquisition->resampler);
+    nco_crcf_destroy(acquisition->oscillator);
+    free(acquisition);
+  }
+}
+
+/* Correlate the window of received samples with the reference preamble
+ * for all the frequency bins, and return the normalized correlation of
+ * the best bin */
+float acquisition_correlate(acquisition_t acquisition, float *carrier_offset)
+{
+  complex float *window;
+  complex float sum;
+  float energy = 0;
+  float magnitude;
+  float previous;
+  float next;
+  float delta = 0;
+  float bin;
+  unsigned int peak = 0;
+  unsigned int end;
+  unsigned int i;
+  unsigned int j;
+
+  windowcf_read(acquisition->window, &window);
+  for(j = 0; j < acquisition->segments; j++)
+  {
+    sum = 0;
+    end = MIN((j + 1) * acquisition->segment_size, acquisition->reference_size);
+    for(i = j * acquisition->segment_size; i < end; i++)
+    {
+      sum += window[i] * acquisition->reference[i];
+      energy += crealf(window[i] * conjf(window[i]));
+    }
+    acquisition->fft_input[j] = sum;
+  }
+  for(j = acquisition->segments; j < acquisition->fft_size; j++)
+  {
+    acquisition->fft_input[j] = 0;
+  }
+  fft_execute(acquisition->fft);
+
+  magnitude = 0;
+  for(j = 0; j < acquisition->fft_size; j++)
+  {
+    if(cabsf(acquisition->fft_output[j]) > magnitude)
+    {
+      magnitude = cabsf(acquisition->fft_output[j]);
+      peak = j;
+    }
+  }
+  if((energy == 0) || (magnitude == 0))
+  {
+    return(0);
+  }
+
+  /* Parabolic interpolation between the bins around the peak */
+  previous = cabsf(acquisition->fft_output[(peak + acquisition->fft_size - 1) %
+                                           acquisition->fft_size]);
+  next = cabsf(acquisition->fft_output[(peak + 1) % acquisition->fft_size]);
+  if(previous - (2 * magnitude) + next < 0)
+  {
+    delta = 0.5 * (previous - next) / (previous - (2 * magnitude) + next);
+  }
+  bin = peak + delta;
+  if(bin > acquisition->fft_size / 2.0)
+  {
+    bin -= acquisition->fft_size;
+  }
+  *carrier_offset = (bin * acquisition->rate) / (acquisition->fft_size *
+                                                 acquisition->segment_size);
+
+  return(magnitude / sqrtf(energy * acquisition->reference_energy));
+}
+
+int acquisition_execute(acquisition_t acquisition,
+                        complex float *samples,
+                        unsigned int samples_size,
+                        float *carrier_offset)
+{
+  clock_t start = clock();
+  int detected = 0;
+  unsigned int i;
+  unsigned int j;
+  unsigned int n;
+  unsigned int size;
+  float metric;
+  float offset;
+
+  for(i = 0; i < samples_size; i += size)
+  {
+    size = MIN(samples_size - i, CHUNK_SIZE);
+    nco_crcf_mix_block_down(acquisition->oscillator,
+                            &samples[i],
+                            acquisition->chunk,
+                            size);
+    msresamp_crcf_execute(acquisition->resampler,
+                          acquisition->chunk,
+                          size,
+                          acquisition->resampled,
+                          &n);
+
+    for(j = 0; j < n; j++)
+    {
+      windowcf_push(acquisition->window, acquisition->resampled[j]);
+      if(acquisition->holdoff > 0)
+      {
+        /* Don't detect the same preamble again */
+        acquisition->holdoff--;
+        continue;
+      }
+      acquisition->step_counter++;
+      if(acquisition->step_counter < acquisition->step)
+      {
+        continue;
+      }
+      acquisition->step_counter = 0;
+
+      metric = acquisition_correlate(acquisition, &offset);
+      if((metric > acquisition->threshold) && (metric > acquisition->peak_metric))
+      {
+        acquisition->peak_metric = metric;
+        acquisition->peak_offset = offset;
+        acquisition->peak_age = 0;
+      }
+      else if(acquisition->peak_metric > 0)
+      {
+        acquisition->peak_age += acquisition->step;
+        if(acquisition->peak_age >= acquisition->peak_timeout)
+        {
+          /* The correlation peak is over */
+          *carrier_offset = acquisition->peak_offset;
+          detected = 1;
+          acquisition->detections++;
+          acquisition->peak_metric = 0;
+          acquisition->holdoff = acquisition->reference_size;
+        }
+      }
+    }
+  }
+
+  acquisition->cpu_time += clock() - start;
+
+  return(detected);
+}
+
+unsigned int acquisition_get_delay(acquisition_t acquisition)
+{
+  return(acquisition->delay);
+}
+
+unsigned long int acquisition_get_detections(acquisition_t acquisition)
+{
+  return(acquisition->detections);
+}
+
+double acquisition_get_cpu_time(acquisition_t acquisition)
+{
+  return((double) acquisition->cpu_time / CLOCKS_PER_SEC);
+}
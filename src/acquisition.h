@@ -0,0 +1,66 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ACQUISITION_H
+#define ACQUISITION_H
+
+#include <complex.h>
+
+typedef struct acquisition_s *acquisition_t;
+
+/* Create a wideband preamble acquisition stage
+ *  - sample_rate: rate of the input samples
+ *  - chip_rate: rate of the spread symbols
+ *  - center_frequency: frequency of the signal in the input samples (Hz)
+ *  - range: maximum carrier frequency offset to search for (Hz)
+ *  - preamble_size: number of symbols in the preamble of the frames
+ *
+ * If the initialization fails, the function returns NULL.
+ */
+acquisition_t acquisition_create(float sample_rate,
+                                 float chip_rate,
+                                 float center_frequency,
+                                 float range,
+                                 unsigned int preamble_size);
+
+/* Cleanup after an acquisition stage */
+void acquisition_free(acquisition_t acquisition);
+
+/* Search for preambles in a block of input samples
+ * If a preamble has been detected, the function returns 1 and sets
+ * 'carrier_offset' to the estimated carrier frequency offset (Hz).
+ * Otherwise it returns 0.
+ */
+int acquisition_execute(acquisition_t acquisition,
+                        complex float *samples,
+                        unsigned int samples_size,
+                        float *carrier_offset);
+
+/* Get the maximum number of input samples between the beginning of a preamble
+ * and its detection */
+unsigned int acquisition_get_delay(acquisition_t acquisition);
+
+/* Get the number of preambles detected */
+unsigned long int acquisition_get_detections(acquisition_t acquisition);
+
+/* Get the processor time used by the acquisition stage (seconds) */
+double acquisition_get_cpu_time(acquisition_t acquisition);
+
+#endif
@@ -0,0 +1,636 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <math.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include "arq.h"
+
+/* Retransmission timeout (seconds) */
+#define INITIAL_RTO 3.0
+#define MIN_RTO 0.5
+#define MAX_RTO 60.0
+
+/* Number of times a frame is sent before giving up */
+#define MAX_TRANSMISSIONS 10
+
+/* Adaptive rate: number of consecutive frames acknowledged without
+ * retransmission before trying a faster rate, and number of consecutive
+ * frames needing a retransmission before using a slower rate */
+#define RATE_UP_SUCCESSES 10
+#define RATE_DOWN_FAILURES 2
+
+/* Bits of the flags byte of the header */
+#define FLAG_ACK_ONLY 0x80
+#define FLAG_BASE_OFFSET 0x7f
+
+typedef struct
+{
+  unsigned char *payload;
+  unsigned int payload_size;
+  unsigned char present;
+  unsigned char acknowledged;
+  unsigned char lost;
+  unsigned int transmissions;
+  unsigned int rate;
+  double first_sent;
+  double last_sent;
+} arq_slot_t;
+
+/* Payloads ready to be given to the data callback once the lock has been
+ * released */
+typedef struct arq_delivery_s
+{
+  unsigned char *payload;
+  unsigned int payload_size;
+  struct arq_delivery_s *next;
+} arq_delivery_t;
+
+/* The frames are numbered with the counter of the header. The sender keeps
+ * the frames that have not been acknowledged yet, and the receiver keeps the
+ * frames received out of order. The acknowledgements for the frames received
+ * are sent in the header of the frames going in the other direction. */
+struct arq_s
+{
+  pthread_mutex_t lock;
+  unsigned int references;
+  unsigned int window;
+
+  /* Sender */
+  arq_slot_t *tx_slots;
+  uint32_t tx_base;
+  uint32_t tx_next;
+  unsigned char tx_end;
+  double srtt;
+  double rttvar;
+  double rto;
+  unsigned long int frames_sent;
+  unsigned long int retransmissions;
+  unsigned long int frames_dropped;
+  unsigned int rates;
+  unsigned int rate;
+  unsigned int rate_successes;
+  unsigned int rate_failures;
+  unsigned char rate_probing;
+
+  /* Receiver */
+  arq_slot_t *rx_slots;
+  unsigned char rx_started;
+  uint32_t rx_expected;
+  unsigned char ack_pending;
+};
+
+static double get_time()
+{
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return(t.tv_sec + (t.tv_nsec / 1000000000.0));
+}
+
+static void put_uint32(unsigned char *buffer, uint32_t x)
+{
+  buffer[0] = (x >> 24) & 255;
+  buffer[1] = (x >> 16) & 255;
+  buffer[2] = (x >> 8) & 255;
+  buffer[3] = x & 255;
+}
+
+static uint32_t get_uint32(unsigned char *buffer)
+{
+  return(((uint32_t) buffer[0] << 24) |
+         ((uint32_t) buffer[1] << 16) |
+         ((uint32_t) buffer[2] << 8) |
+         (uint32_t) buffer[3]);
+}
+
+/* Signed distance between two sequence numbers */
+static int32_t seq_diff(uint32_t a, uint32_t b)
+{
+  return((int32_t) (a - b));
+}
+
+static int store_payload(arq_slot_t *slot,
+                         unsigned char *payload,
+                         unsigned int payload_size)
+{
+  unsigned char *p;
+
+  if(slot->payload_size < payload_size)
+  {
+    p = realloc(slot->payload, payload_size);
+    if(p == NULL)
+    {
+      return(-1);
+    }
+    slot->payload = p;
+  }
+  memcpy(slot->payload, payload, payload_size);
+  slot->payload_size = payload_size;
+  return(0);
+}
+
+arq_t arq_create(unsigned int window)
+{
+  arq_t arq;
+
+  if((window == 0) || (window > ARQ_MAX_WINDOW))
+  {
+    return(NULL);
+  }
+
+  arq = malloc(sizeof(struct arq_s));
+  if(arq == NULL)
+  {
+    return(NULL);
+  }
+  bzero(arq, sizeof(struct arq_s));
+
+  arq->tx_slots = calloc(window, sizeof(arq_slot_t));
+  arq->rx_slots = calloc(window, sizeof(arq_slot_t));
+  if((arq->tx_slots == NULL) || (arq->rx_slots == NULL))
+  {
+    free(arq->tx_slots);
+    free(arq->rx_slots);
+    free(arq);
+    return(NULL);
+  }
+
+  pthread_mutex_init(&arq->lock, NULL);
+  arq->references = 1;
+  arq->window = window;
+  arq->rto = INITIAL_RTO;
+
+  return(arq);
+}
+
+arq_t arq_share(arq_t arq)
+{
+  pthread_mutex_lock(&arq->lock);
+  arq->references++;
+  pthread_mutex_unlock(&arq->lock);
+
+  return(arq);
+}
+
+void arq_free(arq_t arq)
+{
+  unsigned int references;
+  unsigned int i;
+
+  if(arq)
+  {
+    pthread_mutex_lock(&arq->lock);
+    arq->references--;
+    references = arq->references;
+    pthread_mutex_unlock(&arq->lock);
+
+    if(references == 0)
+    {
+      for(i = 0; i < arq->window; i++)
+      {
+        free(arq->tx_slots[i].payload);
+        free(arq->rx_slots[i].payload);
+      }
+      free(arq->tx_slots);
+      free(arq->rx_slots);
+      pthread_mutex_destroy(&arq->lock);
+      free(arq);
+    }
+  }
+}
+
+void arq_set_rates(arq_t arq, unsigned int rates, unsigned int rate)
+{
+  pthread_mutex_lock(&arq->lock);
+  arq->rates = rates;
+  arq->rate = (rate < rates) ? rate : 0;
+  arq->rate_successes = 0;
+  arq->rate_failures = 0;
+  arq->rate_probing = 0;
+  pthread_mutex_unlock(&arq->lock);
+}
+
+unsigned int arq_get_rate(arq_t arq)
+{
+  unsigned int rate;
+
+  pthread_mutex_lock(&arq->lock);
+  rate = arq->rate;
+  pthread_mutex_unlock(&arq->lock);
+
+  return(rate);
+}
+
+/* Choose the rate like the Auto Rate Fallback algorithm: use a faster rate
+ * after several successes, and go back to a slower rate after several
+ * failures, or after a single failure if the faster rate was being tried */
+static void rate_success(arq_t arq, unsigned int rate)
+{
+  if((arq->rates < 2) || (rate != arq->rate))
+  {
+    return;
+  }
+  arq->rate_failures = 0;
+  arq->rate_probing = 0;
+  arq->rate_successes++;
+  if((arq->rate_successes >= RATE_UP_SUCCESSES) && (arq->rate + 1 < arq->rates))
+  {
+    arq->rate++;
+    arq->rate_successes = 0;
+    arq->rate_probing = 1;
+  }
+}
+
+static void rate_failure(arq_t arq, unsigned int rate)
+{
+  if((arq->rates < 2) || (rate != arq->rate))
+  {
+    return;
+  }
+  arq->rate_successes = 0;
+  arq->rate_failures++;
+  if((arq->rate_probing || (arq->rate_failures >= RATE_DOWN_FAILURES)) &&
+     (arq->rate > 0))
+  {
+    arq->rate--;
+    arq->rate_failures = 0;
+    arq->rate_probing = 0;
+  }
+}
+
+/* Estimate the round trip time and the retransmission timeout like TCP
+ * (RFC 6298) */
+static void update_rtt(arq_t arq, double rtt)
+{
+  if(arq->srtt == 0)
+  {
+    arq->srtt = rtt;
+    arq->rttvar = rtt / 2;
+  }
+  else
+  {
+    arq->rttvar = (0.75 * arq->rttvar) + (0.25 * fabs(arq->srtt - rtt));
+    arq->srtt = (0.875 * arq->srtt) + (0.125 * rtt);
+  }
+  arq->rto = arq->srtt + (4 * arq->rttvar);
+  arq->rto = fmin(fmax(arq->rto, MIN_RTO), MAX_RTO);
+}
+
+static void write_header(arq_t arq,
+                         unsigned char *header,
+                         uint32_t seq,
+                         unsigned char ack_only)
+{
+  uint32_t bitmap = 0;
+  unsigned int i;
+
+  if(arq->rx_started)
+  {
+    for(i = 1; i < arq->window; i++)
+    {
+      if(arq->rx_slots[(arq->rx_expected + i) % arq->window].present)
+      {
+        bitmap |= 1u << (i - 1);
+      }
+    }
+  }
+
+  put_uint32(&header[4], seq);
+  put_uint32(&header[8], arq->rx_expected);
+  put_uint32(&header[12], bitmap);
+  header[16] = (seq - arq->tx_base) & FLAG_BASE_OFFSET;
+  if(ack_only)
+  {
+    header[16] |= FLAG_ACK_ONLY;
+  }
+  arq->ack_pending = 0;
+}
+
+int arq_get_frame(arq_t arq,
+                  unsigned char *header,
+                  unsigned char *payload,
+                  unsigned int payload_size,
+                  int (*data_callback)(void *, unsigned char *, unsigned int),
+                  void *callback_context)
+{
+  arq_slot_t *slot;
+  double now = get_time();
+  uint32_t seq;
+  int r;
+
+  pthread_mutex_lock(&arq->lock);
+
+  /* Retransmit the oldest frame lost or not acknowledged in time */
+  for(seq = arq->tx_base; seq != arq->tx_next; seq++)
+  {
+    slot = &arq->tx_slots[seq % arq->window];
+    if(slot->acknowledged ||
+       (!slot->lost && (now - slot->last_sent < arq->rto)))
+    {
+      continue;
+    }
+    if(slot->transmissions >= MAX_TRANSMISSIONS)
+    {
+      /* Give up, the receiver will skip this frame */
+      slot->acknowledged = 1;
+      arq->frames_dropped++;
+      continue;
+    }
+    if(!slot->lost)
+    {
+      /* Timeout, the link is probably slower than estimated */
+      arq->rto = fmin(2 * arq->rto, MAX_RTO);
+    }
+    if(slot->transmissions == 1)
+    {
+      rate_failure(arq, slot->rate);
+    }
+    slot->lost = 0;
+    slot->transmissions++;
+    slot->rate = arq->rate;
+    slot->last_sent = now;
+    arq->retransmissions++;
+    memcpy(payload, slot->payload, slot->payload_size);
+    r = slot->payload_size;
+    write_header(arq, header, seq, 0);
+    pthread_mutex_unlock(&arq->lock);
+    return(r);
+  }
+  while((arq->tx_base != arq->tx_next) &&
+        arq->tx_slots[arq->tx_base % arq->window].acknowledged)
+  {
+    arq->tx_base++;
+  }
+
+  /* Send new data if the window is not full */
+  if(!arq->tx_end && (arq->tx_next - arq->tx_base < arq->window))
+  {
+    /* Only this function modifies 'tx_next', so the lock can be released
+     * while waiting for the data */
+    seq = arq->tx_next;
+    pthread_mutex_unlock(&arq->lock);
+    r = data_callback(callback_context, payload, payload_size);
+    pthread_mutex_lock(&arq->lock);
+    if(r < 0)
+    {
+      arq->tx_end = 1;
+    }
+    else if(r > 0)
+    {
+      slot = &arq->tx_slots[seq % arq->window];
+      if(store_payload(slot, payload, r) == 0)
+      {
+        now = get_time();
+        slot->acknowledged = 0;
+        slot->lost = 0;
+        slot->transmissions = 1;
+        slot->rate = arq->rate;
+        slot->first_sent = now;
+        slot->last_sent = now;
+        arq->tx_next++;
+        arq->frames_sent++;
+        write_header(arq, header, seq, 0);
+        pthread_mutex_unlock(&arq->lock);
+        return(r);
+      }
+    }
+  }
+
+  /* Nothing to send, but the peer is waiting for an acknowledgement */
+  if(arq->ack_pending)
+  {
+    payload[0] = 0;
+    write_header(arq, header, arq->tx_next, 1);
+    pthread_mutex_unlock(&arq->lock);
+    return(1);
+  }
+
+  r = (arq->tx_end && (arq->tx_base == arq->tx_next)) ? -1 : 0;
+  pthread_mutex_unlock(&arq->lock);
+
+  return(r);
+}
+
+static void acknowledge(arq_t arq, uint32_t seq, double now)
+{
+  arq_slot_t *slot = &arq->tx_slots[seq % arq->window];
+
+  if(!slot->acknowledged)
+  {
+    slot->acknowledged = 1;
+    /* Karn's algorithm: the time of retransmitted frames is ambiguous */
+    if(slot->transmissions == 1)
+    {
+      update_rtt(arq, now - slot->first_sent);
+      rate_success(arq, slot->rate);
+    }
+  }
+}
+
+static void process_acknowledgements(arq_t arq, uint32_t ack, uint32_t bitmap)
+{
+  double now = get_time();
+  double delay;
+  uint32_t seq;
+  uint32_t last = ack;
+  unsigned int i;
+
+  /* All the frames before 'ack' have been received */
+  for(seq = arq->tx_base;
+      (seq != arq->tx_next) && (seq_diff(ack, seq) > 0);
+      seq++)
+  {
+    acknowledge(arq, seq, now);
+  }
+
+  /* Frames received after a missing one */
+  for(i = 0; i < 32; i++)
+  {
+    seq = ack + 1 + i;
+    if((bitmap & (1u << i)) &&
+       (seq_diff(seq, arq->tx_base) >= 0) &&
+       (seq_diff(arq->tx_next, seq) > 0))
+    {
+      acknowledge(arq, seq, now);
+      last = seq;
+    }
+  }
+
+  /* The frames sent before a frame that has been received are lost, unless
+   * they have been retransmitted too recently to be acknowledged yet */
+  delay = (arq->srtt > 0) ? arq->srtt : arq->rto / 2;
+  for(seq = arq->tx_base; seq_diff(last, seq) > 0; seq++)
+  {
+    if(seq == arq->tx_next)
+    {
+      break;
+    }
+    if(!arq->tx_slots[seq % arq->window].acknowledged &&
+       (now - arq->tx_slots[seq % arq->window].last_sent > delay))
+    {
+      arq->tx_slots[seq % arq->window].lost = 1;
+    }
+  }
+
+  while((arq->tx_base != arq->tx_next) &&
+        arq->tx_slots[arq->tx_base % arq->window].acknowledged)
+  {
+    arq->tx_base++;
+  }
+}
+
+/* Move the payload of a slot at the end of the delivery list, and return the
+ * new end of the list */
+static arq_delivery_t * queue_payload(arq_delivery_t *last, arq_slot_t *slot)
+{
+  arq_delivery_t *delivery;
+
+  slot->present = 0;
+  delivery = malloc(sizeof(arq_delivery_t));
+  if(delivery == NULL)
+  {
+    return(last);
+  }
+  delivery->payload = slot->payload;
+  delivery->payload_size = slot->payload_size;
+  delivery->next = NULL;
+  slot->payload = NULL;
+  slot->payload_size = 0;
+  last->next = delivery;
+  return(delivery);
+}
+
+static arq_delivery_t * deliver(arq_t arq, arq_delivery_t *last)
+{
+  arq_slot_t *slot = &arq->rx_slots[arq->rx_expected % arq->window];
+
+  while(slot->present)
+  {
+    last = queue_payload(last, slot);
+    arq->rx_expected++;
+    slot = &arq->rx_slots[arq->rx_expected % arq->window];
+  }
+  return(last);
+}
+
+/* Called without the lock, the callback may use the ARQ state */
+static void flush_deliveries(arq_delivery_t *delivery,
+                             int (*data_callback)(void *, unsigned char *, unsigned int),
+                             void *callback_context)
+{
+  arq_delivery_t *next;
+
+  while(delivery)
+  {
+    next = delivery->next;
+    data_callback(callback_context, delivery->payload, delivery->payload_size);
+    free(delivery->payload);
+    free(delivery);
+    delivery = next;
+  }
+}
+
+void arq_frame_received(arq_t arq,
+                        unsigned char *header,
+                        unsigned char *payload,
+                        unsigned int payload_size,
+                        int (*data_callback)(void *, unsigned char *, unsigned int),
+                        void *callback_context)
+{
+  uint32_t seq = get_uint32(&header[4]);
+  uint32_t ack = get_uint32(&header[8]);
+  uint32_t bitmap = get_uint32(&header[12]);
+  uint32_t sender_base = seq - (header[16] & FLAG_BASE_OFFSET);
+  arq_slot_t *slot;
+  arq_delivery_t deliveries;
+  arq_delivery_t *last = &deliveries;
+  unsigned int i;
+  int32_t d;
+
+  deliveries.next = NULL;
+  pthread_mutex_lock(&arq->lock);
+
+  process_acknowledgements(arq, ack, bitmap);
+  if(header[16] & FLAG_ACK_ONLY)
+  {
+    pthread_mutex_unlock(&arq->lock);
+    return;
+  }
+
+  d = seq_diff(sender_base, arq->rx_expected);
+  if(!arq->rx_started || (d < -(int32_t) arq->window))
+  {
+    /* First frame, or the peer has restarted */
+    arq->rx_started = 1;
+    arq->rx_expected = sender_base;
+    for(i = 0; i < arq->window; i++)
+    {
+      arq->rx_slots[i].present = 0;
+    }
+  }
+  else
+  {
+    /* The peer gave up sending some frames, skip them */
+    while(seq_diff(sender_base, arq->rx_expected) > 0)
+    {
+      slot = &arq->rx_slots[arq->rx_expected % arq->window];
+      if(slot->present)
+      {
+        last = queue_payload(last, slot);
+      }
+      arq->rx_expected++;
+    }
+  }
+
+  arq->ack_pending = 1;
+  d = seq_diff(seq, arq->rx_expected);
+  if((d >= 0) && (d < (int32_t) arq->window))
+  {
+    slot = &arq->rx_slots[seq % arq->window];
+    if(!slot->present && (store_payload(slot, payload, payload_size) == 0))
+    {
+      slot->present = 1;
+    }
+  }
+  deliver(arq, last);
+
+  pthread_mutex_unlock(&arq->lock);
+
+  flush_deliveries(deliveries.next, data_callback, callback_context);
+}
+
+void arq_get_statistics(arq_t arq,
+                        unsigned long int *frames_sent,
+                        unsigned long int *retransmissions,
+                        unsigned long int *frames_dropped,
+                        float *round_trip_time)
+{
+  pthread_mutex_lock(&arq->lock);
+  *frames_sent = arq->frames_sent;
+  *retransmissions = arq->retransmissions;
+  *frames_dropped = arq->frames_dropped;
+  *round_trip_time = arq->srtt;
+  pthread_mutex_unlock(&arq->lock);
+}
@@ -0,0 +1,95 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ARQ_H
+#define ARQ_H
+
+/* Header of the frames when ARQ is used:
+ *  - transfer id (4 bytes)
+ *  - sequence number of the frame (4 bytes)
+ *  - sequence number of the next frame expected from the peer (4 bytes)
+ *  - bitmap of the frames received after the next expected one (4 bytes)
+ *  - flags (1 byte)
+ */
+#define ARQ_HEADER_SIZE 17
+
+/* Maximum number of frames waiting for an acknowledgement */
+#define ARQ_MAX_WINDOW 32
+
+typedef struct arq_s *arq_t;
+
+/* Create the state of a selective-repeat ARQ link
+ *  - window: maximum number of frames waiting for an acknowledgement
+ *
+ * If the initialization fails, the function returns NULL.
+ */
+arq_t arq_create(unsigned int window);
+
+/* Get another reference to an ARQ link state */
+arq_t arq_share(arq_t arq);
+
+/* Release a reference to an ARQ link state */
+void arq_free(arq_t arq);
+
+/* Enable the adaptive rate
+ *  - rates: number of rates, from the slowest (0) to the fastest
+ *  - rate: initial rate
+ *
+ * The rate is increased when the frames are acknowledged without
+ * retransmission, and decreased when they need to be retransmitted.
+ */
+void arq_set_rates(arq_t arq, unsigned int rates, unsigned int rate);
+
+/* Get the rate to use for the frames sent now */
+unsigned int arq_get_rate(arq_t arq);
+
+/* Get the next frame to send
+ * The data for new frames is obtained by calling 'data_callback'.
+ * The function writes the header (after the transfer id) and the payload
+ * of the frame, and returns the size of the payload. It returns 0 if there
+ * is nothing to send for now, and -1 when there is no more data and all
+ * the frames have been acknowledged.
+ */
+int arq_get_frame(arq_t arq,
+                  unsigned char *header,
+                  unsigned char *payload,
+                  unsigned int payload_size,
+                  int (*data_callback)(void *, unsigned char *, unsigned int),
+                  void *callback_context);
+
+/* Process a frame received from the peer
+ * The acknowledgements are applied to the frames sent, and the data is
+ * given in order to 'data_callback'.
+ */
+void arq_frame_received(arq_t arq,
+                        unsigned char *header,
+                        unsigned char *payload,
+                        unsigned int payload_size,
+                        int (*data_callback)(void *, unsigned char *, unsigned int),
+                        void *callback_context);
+
+/* Get the statistics of the frames sent */
+void arq_get_statistics(arq_t arq,
+                        unsigned long int *frames_sent,
+                        unsigned long int *retransmissions,
+                        unsigned long int *frames_dropped,
+                        float *round_trip_time);
+
+#endif
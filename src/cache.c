@@ -0,0 +1,241 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include "cache.h"
+
+enum object_type
+{
+  RESAMPLER,
+  FRAME_GENERATOR,
+  FRAME_SYNCHRONIZER
+};
+
+struct entry_s
+{
+  enum object_type type;
+  float ratio;
+  unsigned int spreading_factor;
+  unsigned int preamble_size;
+  void *object;
+  struct entry_s *next;
+};
+
+/* Unused objects, the most recently released first */
+static struct entry_s *entries = NULL;
+static unsigned int entries_count = 0;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void destroy_object(enum object_type type, void *object)
+{
+  switch(type)
+  {
+  case RESAMPLER:
+    msresamp_crcf_destroy((msresamp_crcf) object);
+    break;
+
+  case FRAME_GENERATOR:
+    dsss_framegen_destroy((dsss_framegen) object);
+    break;
+
+  case FRAME_SYNCHRONIZER:
+    dsss_framesync_destroy((dsss_framesync) object);
+    break;
+  }
+}
+
+/* Remove a matching object from the cache and return it, or return NULL if
+ * there is none */
+static void * take(enum object_type type,
+                   float ratio,
+                   unsigned int spreading_factor,
+                   unsigned int preamble_size)
+{
+  struct entry_s **p;
+  struct entry_s *entry;
+  void *object = NULL;
+
+  pthread_mutex_lock(&lock);
+  for(p = &entries; *p != NULL; p = &(*p)->next)
+  {
+    entry = *p;
+    if((entry->type == type) &&
+       (entry->ratio == ratio) &&
+       (entry->spreading_factor == spreading_factor) &&
+       (entry->preamble_size == preamble_size))
+    {
+      *p = entry->next;
+      entries_count--;
+      object = entry->object;
+      free(entry);
+      break;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+
+  return(object);
+}
+
+/* Put an unused object in the cache, destroying the least recently released
+ * one if the cache is full */
+static void put(enum object_type type,
+                float ratio,
+                unsigned int spreading_factor,
+                unsigned int preamble_size,
+                void *object)
+{
+  struct entry_s **p;
+  struct entry_s *entry = malloc(sizeof(struct entry_s));
+
+  if(entry == NULL)
+  {
+    destroy_object(type, object);
+    return;
+  }
+  entry->type = type;
+  entry->ratio = ratio;
+  entry->spreading_factor = spreading_factor;
+  entry->preamble_size = preamble_size;
+  entry->object = object;
+
+  pthread_mutex_lock(&lock);
+  entry->next = entries;
+  entries = entry;
+  entries_count++;
+  if(entries_count > CACHE_SIZE)
+  {
+    for(p = &entries; (*p)->next != NULL; p = &(*p)->next)
+    {
+    }
+    entry = *p;
+    *p = NULL;
+    entries_count--;
+  }
+  else
+  {
+    entry = NULL;
+  }
+  pthread_mutex_unlock(&lock);
+
+  if(entry)
+  {
+    destroy_object(entry->type, entry->object);
+    free(entry);
+  }
+}
+
+msresamp_crcf cache_get_resampler(float ratio)
+{
+  msresamp_crcf resampler = take(RESAMPLER, ratio, 0, 0);
+
+  if(resampler)
+  {
+    msresamp_crcf_reset(resampler);
+  }
+  else
+  {
+    resampler = msresamp_crcf_create(ratio, 60);
+  }
+
+  return(resampler);
+}
+
+void cache_release_resampler(msresamp_crcf resampler, float ratio)
+{
+  if(resampler)
+  {
+    put(RESAMPLER, ratio, 0, 0, resampler);
+  }
+}
+
+dsss_framegen cache_get_frame_generator(unsigned int spreading_factor)
+{
+  dsss_framegen frame_generator = take(FRAME_GENERATOR,
+                                       0,
+                                       spreading_factor,
+                                       0);
+
+  if(frame_generator)
+  {
+    dsss_framegen_reset(frame_generator);
+  }
+  else
+  {
+    frame_generator = dsss_framegen_create(spreading_factor, NULL);
+  }
+
+  return(frame_generator);
+}
+
+void cache_release_frame_generator(dsss_framegen frame_generator,
+                                   unsigned int spreading_factor)
+{
+  if(frame_generator)
+  {
+    put(FRAME_GENERATOR, 0, spreading_factor, 0, frame_generator);
+  }
+}
+
+dsss_framesync cache_get_frame_synchronizer(unsigned int spreading_factor,
+                                            unsigned int preamble_size,
+                                            framesync_callback callback,
+                                            void *userdata)
+{
+  dsss_framesync frame_synchronizer = take(FRAME_SYNCHRONIZER,
+                                           0,
+                                           spreading_factor,
+                                           preamble_size);
+
+  if(frame_synchronizer)
+  {
+    dsss_framesync_set_callback(frame_synchronizer, callback, userdata);
+    dsss_framesync_reset(frame_synchronizer);
+    dsss_framesync_reset_framedatastats(frame_synchronizer);
+  }
+  else
+  {
+    frame_synchronizer = dsss_framesync_create(spreading_factor,
+                                               callback,
+                                               userdata);
+    if(frame_synchronizer)
+    {
+      dsss_framesync_set_preamble_len(frame_synchronizer, preamble_size);
+    }
+  }
+
+  return(frame_synchronizer);
+}
+
+void cache_release_frame_synchronizer(dsss_framesync frame_synchronizer,
+                                      unsigned int spreading_factor,
+                                      unsigned int preamble_size)
+{
+  if(frame_synchronizer)
+  {
+    /* Don't keep the symbols of the frames of the previous transfer */
+    dsss_framesync_set_combining(frame_synchronizer, 0, NULL);
+    put(FRAME_SYNCHRONIZER,
+        0,
+        spreading_factor,
+        preamble_size,
+        frame_synchronizer);
+  }
+}
@@ -0,0 +1,69 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <complex.h>
+#include <liquid/liquid.h>
+#include "dsssframe.h"
+
+/* Maximum number of unused signal processing objects kept for the next
+ * transfers */
+#define CACHE_SIZE 16
+
+/* The design of the filters and of the preamble detector takes much more time
+ * than the processing of a short burst of frames. The signal processing
+ * objects of finished transfers are kept in a cache shared by all the
+ * transfers of the process, and given to the next transfers needing objects
+ * with the same parameters instead of designing new ones. The objects taken
+ * from the cache are reset, but their other settings (header, FEC, etc.) must
+ * be set again by the caller.
+ * These functions can be called from several threads.
+ */
+
+/* Get a resampler for 'ratio' */
+msresamp_crcf cache_get_resampler(float ratio);
+
+/* Give back a resampler obtained with cache_get_resampler() */
+void cache_release_resampler(msresamp_crcf resampler, float ratio);
+
+/* Get a frame generator for 'spreading_factor' */
+dsss_framegen cache_get_frame_generator(unsigned int spreading_factor);
+
+/* Give back a frame generator obtained with cache_get_frame_generator() */
+void cache_release_frame_generator(dsss_framegen frame_generator,
+                                   unsigned int spreading_factor);
+
+/* Get a frame synchronizer for 'spreading_factor' with a preamble of
+ * 'preamble_size' symbols, calling 'callback' with 'userdata' for each
+ * frame received */
+dsss_framesync cache_get_frame_synchronizer(unsigned int spreading_factor,
+                                            unsigned int preamble_size,
+                                            framesync_callback callback,
+                                            void *userdata);
+
+/* Give back a frame synchronizer obtained with
+ * cache_get_frame_synchronizer() */
+void cache_release_frame_synchronizer(dsss_framesync frame_synchronizer,
+                                      unsigned int spreading_factor,
+                                      unsigned int preamble_size);
+
+#endif
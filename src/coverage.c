@@ -0,0 +1,416 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "coverage.h"
+
+/* Beginning of the map files */
+#define MAP_MAGIC "DSSSMAP1"
+#define MAP_MAGIC_SIZE 8
+
+/* The stream is cut in blocks of fixed size and one bit tells whether all the
+ * bytes of a block have been received. The last block can be shorter than the
+ * others. */
+struct coverage_s
+{
+  unsigned int block_size;
+  unsigned long long int size;
+  unsigned long long int blocks;
+  unsigned char *bitmap;
+  unsigned long long int blocks_received;
+  unsigned long long int run_start;
+  unsigned long long int run_end;
+};
+
+static void put_uint64(unsigned char *buffer, unsigned long long int x)
+{
+  unsigned int i;
+
+  for(i = 0; i < 8; i++)
+  {
+    buffer[i] = (x >> (56 - (8 * i))) & 255;
+  }
+}
+
+static unsigned long long int get_uint64(unsigned char *buffer)
+{
+  unsigned long long int x = 0;
+  unsigned int i;
+
+  for(i = 0; i < 8; i++)
+  {
+    x = (x << 8) | buffer[i];
+  }
+  return(x);
+}
+
+static unsigned char get_bit(coverage_t coverage, unsigned long long int block)
+{
+  return((coverage->bitmap[block >> 3] >> (block & 7)) & 1);
+}
+
+static void set_bit(coverage_t coverage, unsigned long long int block)
+{
+  if(!get_bit(coverage, block))
+  {
+    coverage->bitmap[block >> 3] |= 1 << (block & 7);
+    coverage->blocks_received++;
+  }
+}
+
+static void clear_bit(coverage_t coverage, unsigned long long int block)
+{
+  if(get_bit(coverage, block))
+  {
+    coverage->bitmap[block >> 3] &= ~(1 << (block & 7));
+    coverage->blocks_received--;
+  }
+}
+
+coverage_t coverage_create(unsigned int block_size)
+{
+  coverage_t coverage;
+
+  if(block_size == 0)
+  {
+    return(NULL);
+  }
+  coverage = malloc(sizeof(struct coverage_s));
+  if(coverage == NULL)
+  {
+    return(NULL);
+  }
+  bzero(coverage, sizeof(struct coverage_s));
+  coverage->block_size = block_size;
+
+  return(coverage);
+}
+
+void coverage_free(coverage_t coverage)
+{
+  if(coverage)
+  {
+    free(coverage->bitmap);
+    free(coverage);
+  }
+}
+
+void coverage_clear(coverage_t coverage)
+{
+  if(coverage->bitmap)
+  {
+    bzero(coverage->bitmap, (coverage->blocks + 7) / 8);
+  }
+  coverage->blocks_received = 0;
+  coverage->run_start = 0;
+  coverage->run_end = 0;
+}
+
+int coverage_set_size(coverage_t coverage, unsigned long long int size)
+{
+  unsigned long long int blocks;
+  unsigned long long int bytes;
+  unsigned long long int old_bytes;
+  unsigned long long int block;
+  unsigned char *bitmap;
+
+  blocks = (size + coverage->block_size - 1) / coverage->block_size;
+  bytes = (blocks + 7) / 8;
+  old_bytes = (coverage->blocks + 7) / 8;
+  /* Forget the blocks after the end */
+  for(block = blocks; block < coverage->blocks; block++)
+  {
+    clear_bit(coverage, block);
+  }
+  if(bytes != old_bytes)
+  {
+    bitmap = realloc(coverage->bitmap, (bytes > 0) ? bytes : 1);
+    if(bitmap == NULL)
+    {
+      return(-1);
+    }
+    if(bytes > old_bytes)
+    {
+      bzero(&bitmap[old_bytes], bytes - old_bytes);
+    }
+    coverage->bitmap = bitmap;
+  }
+  /* Forget the last block if it was incomplete and is now longer */
+  if((size > coverage->size) &&
+     (coverage->size % coverage->block_size != 0) &&
+     (coverage->size / coverage->block_size < blocks))
+  {
+    clear_bit(coverage, coverage->size / coverage->block_size);
+  }
+  coverage->blocks = blocks;
+  coverage->size = size;
+
+  return(0);
+}
+
+unsigned long long int coverage_get_size(coverage_t coverage)
+{
+  return(coverage->size);
+}
+
+int coverage_load(coverage_t coverage, char *path)
+{
+  FILE *file;
+  unsigned char header[MAP_MAGIC_SIZE + 12];
+  unsigned long long int size;
+  unsigned int block_size;
+  unsigned int old_block_size = coverage->block_size;
+  unsigned long long int bytes;
+  unsigned long long int block;
+
+  file = fopen(path, "rb");
+  if(file == NULL)
+  {
+    return(-1);
+  }
+  if((fread(header, 1, sizeof(header), file) != sizeof(header)) ||
+     (memcmp(header, MAP_MAGIC, MAP_MAGIC_SIZE) != 0))
+  {
+    fclose(file);
+    return(-1);
+  }
+  size = get_uint64(&header[MAP_MAGIC_SIZE]);
+  block_size = ((unsigned int) header[MAP_MAGIC_SIZE + 8] << 24) |
+    ((unsigned int) header[MAP_MAGIC_SIZE + 9] << 16) |
+    ((unsigned int) header[MAP_MAGIC_SIZE + 10] << 8) |
+    (unsigned int) header[MAP_MAGIC_SIZE + 11];
+  if(block_size == 0)
+  {
+    fclose(file);
+    return(-1);
+  }
+
+  coverage->block_size = block_size;
+  coverage->size = 0;
+  coverage->blocks = 0;
+  coverage->blocks_received = 0;
+  if(coverage_set_size(coverage, size) != 0)
+  {
+    coverage->block_size = old_block_size;
+    fclose(file);
+    return(-1);
+  }
+  bytes = (coverage->blocks + 7) / 8;
+  if(fread(coverage->bitmap, 1, bytes, file) != bytes)
+  {
+    coverage_clear(coverage);
+    coverage_set_size(coverage, 0);
+    coverage->block_size = old_block_size;
+    fclose(file);
+    return(-1);
+  }
+  fclose(file);
+  for(block = 0; block < coverage->blocks; block++)
+  {
+    coverage->blocks_received += get_bit(coverage, block);
+  }
+  coverage->run_start = 0;
+  coverage->run_end = 0;
+
+  return(0);
+}
+
+int coverage_save(coverage_t coverage, char *path)
+{
+  FILE *file;
+  unsigned char header[MAP_MAGIC_SIZE + 12];
+  unsigned long long int bytes = (coverage->blocks + 7) / 8;
+  char *tmp_path;
+  int r = 0;
+
+  memcpy(header, MAP_MAGIC, MAP_MAGIC_SIZE);
+  put_uint64(&header[MAP_MAGIC_SIZE], coverage->size);
+  header[MAP_MAGIC_SIZE + 8] = (coverage->block_size >> 24) & 255;
+  header[MAP_MAGIC_SIZE + 9] = (coverage->block_size >> 16) & 255;
+  header[MAP_MAGIC_SIZE + 10] = (coverage->block_size >> 8) & 255;
+  header[MAP_MAGIC_SIZE + 11] = coverage->block_size & 255;
+
+  /* Write a temporary file and rename it, so that an interruption can't
+   * leave a truncated map */
+  tmp_path = malloc(strlen(path) + 5);
+  if(tmp_path == NULL)
+  {
+    return(-1);
+  }
+  sprintf(tmp_path, "%s.tmp", path);
+  file = fopen(tmp_path, "wb");
+  if(file == NULL)
+  {
+    free(tmp_path);
+    return(-1);
+  }
+  if((fwrite(header, 1, sizeof(header), file) != sizeof(header)) ||
+     ((bytes > 0) && (fwrite(coverage->bitmap, 1, bytes, file) != bytes)))
+  {
+    r = -1;
+  }
+  if(fclose(file) != 0)
+  {
+    r = -1;
+  }
+  if((r == 0) && (rename(tmp_path, path) != 0))
+  {
+    r = -1;
+  }
+  if(r != 0)
+  {
+    remove(tmp_path);
+  }
+  free(tmp_path);
+
+  return(r);
+}
+
+void coverage_add(coverage_t coverage,
+                  unsigned long long int offset,
+                  unsigned long long int size)
+{
+  unsigned long long int end = offset + size;
+  unsigned long long int block;
+  unsigned long long int last;
+
+  if(size == 0)
+  {
+    return;
+  }
+  if((end > coverage->size) && (coverage_set_size(coverage, end) != 0))
+  {
+    return;
+  }
+
+  /* Merge with the previous data if they are contiguous */
+  if((offset >= coverage->run_start) && (offset <= coverage->run_end))
+  {
+    offset = coverage->run_start;
+    if(end < coverage->run_end)
+    {
+      end = coverage->run_end;
+    }
+  }
+  coverage->run_start = offset;
+  coverage->run_end = end;
+
+  block = (offset + coverage->block_size - 1) / coverage->block_size;
+  last = (end == coverage->size) ?
+    coverage->blocks :
+    end / coverage->block_size;
+  for(; block < last; block++)
+  {
+    set_bit(coverage, block);
+  }
+}
+
+unsigned long long int coverage_get_run(coverage_t coverage,
+                                        unsigned long long int offset,
+                                        unsigned long long int size,
+                                        unsigned char received)
+{
+  unsigned long long int block = offset / coverage->block_size;
+  unsigned long long int end = offset;
+  unsigned char bit;
+
+  while(end < offset + size)
+  {
+    bit = (block < coverage->blocks) ? get_bit(coverage, block) : 0;
+    if(bit != (received ? 1 : 0))
+    {
+      break;
+    }
+    block++;
+    end = block * coverage->block_size;
+  }
+  if(end > offset + size)
+  {
+    end = offset + size;
+  }
+
+  return(end - offset);
+}
+
+int coverage_get_missing(coverage_t coverage,
+                         unsigned long long int offset,
+                         unsigned long long int *missing_offset,
+                         unsigned long long int *missing_size)
+{
+  unsigned long long int block = offset / coverage->block_size;
+  unsigned long long int start;
+  unsigned long long int end;
+
+  while((block < coverage->blocks) && get_bit(coverage, block))
+  {
+    block++;
+  }
+  if(block >= coverage->blocks)
+  {
+    return(-1);
+  }
+  start = block * coverage->block_size;
+  while((block < coverage->blocks) && !get_bit(coverage, block))
+  {
+    block++;
+  }
+  end = block * coverage->block_size;
+  if(end > coverage->size)
+  {
+    end = coverage->size;
+  }
+  if(start < offset)
+  {
+    start = offset;
+  }
+  *missing_offset = start;
+  *missing_size = end - start;
+
+  return(0);
+}
+
+int coverage_is_complete(coverage_t coverage)
+{
+  return(coverage->blocks_received == coverage->blocks);
+}
+
+unsigned long long int coverage_get_missing_bytes(coverage_t coverage)
+{
+  unsigned long long int offset = 0;
+  unsigned long long int missing_offset;
+  unsigned long long int missing_size;
+  unsigned long long int missing = 0;
+
+  while(coverage_get_missing(coverage,
+                             offset,
+                             &missing_offset,
+                             &missing_size) == 0)
+  {
+    missing += missing_size;
+    offset = missing_offset + missing_size;
+  }
+
+  return(missing);
+}
@@ -0,0 +1,95 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COVERAGE_H
+#define COVERAGE_H
+
+/* Default size of the blocks of the stream tracked by the coverage map */
+#define COVERAGE_BLOCK_SIZE 512
+
+typedef struct coverage_s *coverage_t;
+
+/* Create a map of the parts of a stream that have been received
+ *  - block_size: number of bytes of the stream represented by one bit
+ *
+ * If the initialization fails, the function returns NULL.
+ */
+coverage_t coverage_create(unsigned int block_size);
+
+/* Cleanup after a coverage map */
+void coverage_free(coverage_t coverage);
+
+/* Forget all the data received */
+void coverage_clear(coverage_t coverage);
+
+/* Load a map previously saved with coverage_save()
+ * The function returns 0 if the map was loaded, and -1 otherwise.
+ */
+int coverage_load(coverage_t coverage, char *path);
+
+/* Save the map to a file
+ * The map is written to a temporary file which then replaces 'path', so
+ * the previous map is kept if the program is interrupted.
+ * The function returns 0 on success, and -1 otherwise.
+ */
+int coverage_save(coverage_t coverage, char *path);
+
+/* Set the size of the stream
+ * The map grows if needed. If it shrinks, the blocks after the end are
+ * forgotten. The function returns 0 on success, and -1 otherwise.
+ */
+int coverage_set_size(coverage_t coverage, unsigned long long int size);
+
+/* Get the size of the stream */
+unsigned long long int coverage_get_size(coverage_t coverage);
+
+/* Mark some data as received
+ * Only the blocks that are entirely covered are marked. Data adjacent to the
+ * previous data added is merged with it, so that blocks spanning several
+ * consecutive frames are also marked. The map grows if needed.
+ */
+void coverage_add(coverage_t coverage,
+                  unsigned long long int offset,
+                  unsigned long long int size);
+
+/* Get the number of consecutive bytes, starting at 'offset' and at most
+ * 'size', that have all been received (if 'received' is not 0) or that have
+ * all not been received (if 'received' is 0). */
+unsigned long long int coverage_get_run(coverage_t coverage,
+                                        unsigned long long int offset,
+                                        unsigned long long int size,
+                                        unsigned char received);
+
+/* Get the first range of missing data starting at 'offset' or after it
+ * The function returns 0 and sets 'missing_offset' and 'missing_size' if
+ * there is such a range, and returns -1 otherwise.
+ */
+int coverage_get_missing(coverage_t coverage,
+                         unsigned long long int offset,
+                         unsigned long long int *missing_offset,
+                         unsigned long long int *missing_size);
+
+/* Check whether all the data of the stream has been received */
+int coverage_is_complete(coverage_t coverage);
+
+/* Get the number of bytes of the stream that have not been received */
+unsigned long long int coverage_get_missing_bytes(coverage_t coverage);
+
+#endif
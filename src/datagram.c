@@ -0,0 +1,332 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "datagram.h"
+
+#define RECORD_FRAGMENT 0x8000
+
+struct message_s
+{
+  unsigned char *data;
+  unsigned int size;
+  unsigned int done;
+  struct message_s *next;
+};
+
+/* Small messages are packed together into the frames, and the messages that
+ * don't fit in the space left in a frame are cut into fragments sent in the
+ * next frames. The receiver rebuilds a fragmented message only if all its
+ * fragments are received in order. */
+struct datagram_s
+{
+  /* Sender */
+  pthread_mutex_t lock;
+  struct message_s *tx_first;
+  struct message_s *tx_last;
+  unsigned char tx_end;
+  unsigned int tx_number;
+
+  /* Receiver */
+  unsigned char *rx_message;
+  unsigned int rx_number;
+  unsigned int rx_size;
+  unsigned int rx_done;
+  unsigned char rx_started;
+  unsigned long int messages_received;
+  unsigned long int messages_dropped;
+};
+
+static void put_uint16(unsigned char *buffer, unsigned int x)
+{
+  buffer[0] = (x >> 8) & 255;
+  buffer[1] = x & 255;
+}
+
+static unsigned int get_uint16(unsigned char *buffer)
+{
+  return((buffer[0] << 8) | buffer[1]);
+}
+
+datagram_t datagram_create()
+{
+  datagram_t datagram = malloc(sizeof(struct datagram_s));
+
+  if(datagram == NULL)
+  {
+    return(NULL);
+  }
+  bzero(datagram, sizeof(struct datagram_s));
+  datagram->rx_message = malloc(DATAGRAM_MAX_MESSAGE_SIZE);
+  if(datagram->rx_message == NULL)
+  {
+    free(datagram);
+    return(NULL);
+  }
+  pthread_mutex_init(&datagram->lock, NULL);
+
+  return(datagram);
+}
+
+void datagram_free(datagram_t datagram)
+{
+  struct message_s *message;
+
+  if(datagram)
+  {
+    while(datagram->tx_first)
+    {
+      message = datagram->tx_first;
+      datagram->tx_first = message->next;
+      free(message->data);
+      free(message);
+    }
+    pthread_mutex_destroy(&datagram->lock);
+    free(datagram->rx_message);
+    free(datagram);
+  }
+}
+
+int datagram_send(datagram_t datagram,
+                  unsigned char *message,
+                  unsigned int message_size)
+{
+  struct message_s *m;
+
+  if(message == NULL)
+  {
+    pthread_mutex_lock(&datagram->lock);
+    datagram->tx_end = 1;
+    pthread_mutex_unlock(&datagram->lock);
+    return(0);
+  }
+  if(message_size > DATAGRAM_MAX_MESSAGE_SIZE)
+  {
+    return(-1);
+  }
+
+  m = malloc(sizeof(struct message_s));
+  if(m == NULL)
+  {
+    return(-1);
+  }
+  m->data = malloc((message_size > 0) ? message_size : 1);
+  if(m->data == NULL)
+  {
+    free(m);
+    return(-1);
+  }
+  memcpy(m->data, message, message_size);
+  m->size = message_size;
+  m->done = 0;
+  m->next = NULL;
+
+  pthread_mutex_lock(&datagram->lock);
+  if(datagram->tx_end)
+  {
+    pthread_mutex_unlock(&datagram->lock);
+    free(m->data);
+    free(m);
+    return(-1);
+  }
+  if(datagram->tx_last)
+  {
+    datagram->tx_last->next = m;
+  }
+  else
+  {
+    datagram->tx_first = m;
+  }
+  datagram->tx_last = m;
+  pthread_mutex_unlock(&datagram->lock);
+
+  return(0);
+}
+
+int datagram_get_frame(datagram_t datagram,
+                       unsigned char *payload,
+                       unsigned int payload_size)
+{
+  struct message_s *m;
+  unsigned int pos = 0;
+  unsigned int n;
+  int r;
+
+  pthread_mutex_lock(&datagram->lock);
+  while(datagram->tx_first)
+  {
+    m = datagram->tx_first;
+    n = m->size - m->done;
+    if((m->done == 0) &&
+       (n < RECORD_FRAGMENT) &&
+       (pos + DATAGRAM_RECORD_HEADER_SIZE + n <= payload_size))
+    {
+      /* The whole message fits in the frame */
+      put_uint16(&payload[pos], n);
+      memcpy(&payload[pos + DATAGRAM_RECORD_HEADER_SIZE], m->data, n);
+      pos += DATAGRAM_RECORD_HEADER_SIZE + n;
+    }
+    else
+    {
+      if(pos + DATAGRAM_FRAGMENT_HEADER_SIZE >= payload_size)
+      {
+        break;
+      }
+      if(m->done == 0)
+      {
+        datagram->tx_number = (datagram->tx_number + 1) & 0xffff;
+      }
+      if(n > payload_size - pos - DATAGRAM_FRAGMENT_HEADER_SIZE)
+      {
+        n = payload_size - pos - DATAGRAM_FRAGMENT_HEADER_SIZE;
+      }
+      put_uint16(&payload[pos], RECORD_FRAGMENT | n);
+      put_uint16(&payload[pos + 2], datagram->tx_number);
+      put_uint16(&payload[pos + 4], m->size);
+      put_uint16(&payload[pos + 6], m->done);
+      memcpy(&payload[pos + DATAGRAM_FRAGMENT_HEADER_SIZE],
+             &m->data[m->done],
+             n);
+      pos += DATAGRAM_FRAGMENT_HEADER_SIZE + n;
+      m->done += n;
+      if(m->done < m->size)
+      {
+        /* The frame is full */
+        break;
+      }
+    }
+    datagram->tx_first = m->next;
+    if(datagram->tx_first == NULL)
+    {
+      datagram->tx_last = NULL;
+    }
+    free(m->data);
+    free(m);
+  }
+  if((pos == 0) && datagram->tx_end && (datagram->tx_first == NULL))
+  {
+    /* The messages queued from now on will be sent by the next transfer */
+    datagram->tx_end = 0;
+    r = -1;
+  }
+  else
+  {
+    r = pos;
+  }
+  pthread_mutex_unlock(&datagram->lock);
+
+  return(r);
+}
+
+void datagram_frame_received(datagram_t datagram,
+                             unsigned char *payload,
+                             unsigned int payload_size,
+                             int (*message_callback)(void *, unsigned char *, unsigned int),
+                             void *callback_context)
+{
+  unsigned int pos = 0;
+  unsigned int n;
+  unsigned int number;
+  unsigned int size;
+  unsigned int offset;
+
+  while(pos + DATAGRAM_RECORD_HEADER_SIZE <= payload_size)
+  {
+    n = get_uint16(&payload[pos]);
+    if(!(n & RECORD_FRAGMENT))
+    {
+      if(pos + DATAGRAM_RECORD_HEADER_SIZE + n > payload_size)
+      {
+        break;
+      }
+      datagram->messages_received++;
+      if(message_callback)
+      {
+        message_callback(callback_context,
+                         &payload[pos + DATAGRAM_RECORD_HEADER_SIZE],
+                         n);
+      }
+      pos += DATAGRAM_RECORD_HEADER_SIZE + n;
+      continue;
+    }
+
+    n &= ~RECORD_FRAGMENT;
+    if(pos + DATAGRAM_FRAGMENT_HEADER_SIZE + n > payload_size)
+    {
+      break;
+    }
+    number = get_uint16(&payload[pos + 2]);
+    size = get_uint16(&payload[pos + 4]);
+    offset = get_uint16(&payload[pos + 6]);
+    if(offset == 0)
+    {
+      if(datagram->rx_started)
+      {
+        /* The end of the previous message was lost */
+        datagram->messages_dropped++;
+      }
+      datagram->rx_started = 1;
+      datagram->rx_number = number;
+      datagram->rx_size = size;
+      datagram->rx_done = 0;
+    }
+    if(datagram->rx_started &&
+       (number == datagram->rx_number) &&
+       (size == datagram->rx_size) &&
+       (offset == datagram->rx_done) &&
+       (offset + n <= size))
+    {
+      memcpy(&datagram->rx_message[offset],
+             &payload[pos + DATAGRAM_FRAGMENT_HEADER_SIZE],
+             n);
+      datagram->rx_done += n;
+      if(datagram->rx_done == datagram->rx_size)
+      {
+        datagram->rx_started = 0;
+        datagram->messages_received++;
+        if(message_callback)
+        {
+          message_callback(callback_context,
+                           datagram->rx_message,
+                           datagram->rx_size);
+        }
+      }
+    }
+    else if(datagram->rx_started)
+    {
+      /* A fragment of the message was lost */
+      datagram->rx_started = 0;
+      datagram->messages_dropped++;
+    }
+    pos += DATAGRAM_FRAGMENT_HEADER_SIZE + n;
+  }
+}
+
+void datagram_get_statistics(datagram_t datagram,
+                             unsigned long int *messages_received,
+                             unsigned long int *messages_dropped)
+{
+  *messages_received = datagram->messages_received;
+  *messages_dropped = datagram->messages_dropped;
+}
@@ -0,0 +1,82 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DATAGRAM_H
+#define DATAGRAM_H
+
+/* The payload of the frames is a sequence of records:
+ *  - complete message: length (2 bytes), data
+ *  - fragment of a message: 0x8000 + length of the fragment (2 bytes),
+ *    message number (2 bytes), size of the message (2 bytes), offset of the
+ *    fragment in the message (2 bytes), data
+ */
+#define DATAGRAM_RECORD_HEADER_SIZE 2
+#define DATAGRAM_FRAGMENT_HEADER_SIZE 8
+
+/* Maximum size of a message */
+#define DATAGRAM_MAX_MESSAGE_SIZE 65535
+
+typedef struct datagram_s *datagram_t;
+
+/* Create the state of a message layer
+ * If the initialization fails, the function returns NULL.
+ */
+datagram_t datagram_create();
+
+/* Cleanup after a message layer */
+void datagram_free(datagram_t datagram);
+
+/* Add a message to the queue of messages to send
+ * The data is copied. If 'message' is NULL, no more messages will be sent,
+ * and datagram_get_frame() returns -1 once the queue is empty. After that,
+ * new messages can be added again for another transfer.
+ * This function can be called from another thread than the one sending the
+ * frames. It returns 0 on success, and -1 otherwise.
+ */
+int datagram_send(datagram_t datagram,
+                  unsigned char *message,
+                  unsigned int message_size);
+
+/* Get the payload of the next frame to send
+ * The messages of the queue are packed into the payload, and the messages
+ * too big for the space left are fragmented. The function returns the size
+ * of the payload, 0 if there is nothing to send for now, and -1 when there
+ * are no more messages.
+ */
+int datagram_get_frame(datagram_t datagram,
+                       unsigned char *payload,
+                       unsigned int payload_size);
+
+/* Process the payload of a received frame
+ * Each complete message is given to 'message_callback'. The messages whose
+ * fragments have not all been received are dropped.
+ */
+void datagram_frame_received(datagram_t datagram,
+                             unsigned char *payload,
+                             unsigned int payload_size,
+                             int (*message_callback)(void *, unsigned char *, unsigned int),
+                             void *callback_context);
+
+/* Get the number of messages received and dropped by the receiver */
+void datagram_get_statistics(datagram_t datagram,
+                             unsigned long int *messages_received,
+                             unsigned long int *messages_dropped);
+
+#endif
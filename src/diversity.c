@@ -0,0 +1,237 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "diversity.h"
+
+/* A frame older than this number of windows starts a new stream */
+#define DIVERSITY_RESTART (4 * DIVERSITY_WINDOW)
+
+typedef struct
+{
+  unsigned char *header;
+  unsigned int header_size;
+  unsigned int payload_size;
+} pending_frame_t;
+
+struct diversity_s
+{
+  void (*frame_callback)(void *, unsigned char *, unsigned char *, unsigned int);
+  void *callback_context;
+  pthread_mutex_t lock;
+  unsigned char started;
+  /* Counter of the next frame to give to the callback */
+  unsigned int next;
+  pending_frame_t pending[DIVERSITY_WINDOW];
+  unsigned long int frames_selected;
+  unsigned long int duplicates;
+  unsigned long int frames_lost;
+};
+
+diversity_t diversity_create(void (*frame_callback)(void *,
+                                                    unsigned char *,
+                                                    unsigned char *,
+                                                    unsigned int),
+                             void *callback_context)
+{
+  diversity_t diversity;
+
+  if(frame_callback == NULL)
+  {
+    return(NULL);
+  }
+  diversity = malloc(sizeof(struct diversity_s));
+  if(diversity == NULL)
+  {
+    return(NULL);
+  }
+  bzero(diversity, sizeof(struct diversity_s));
+  if(pthread_mutex_init(&diversity->lock, NULL) != 0)
+  {
+    free(diversity);
+    return(NULL);
+  }
+  diversity->frame_callback = frame_callback;
+  diversity->callback_context = callback_context;
+
+  return(diversity);
+}
+
+static void drop_pending_frames(diversity_t diversity)
+{
+  unsigned int i;
+
+  for(i = 0; i < DIVERSITY_WINDOW; i++)
+  {
+    free(diversity->pending[i].header);
+    diversity->pending[i].header = NULL;
+  }
+}
+
+void diversity_free(diversity_t diversity)
+{
+  if(diversity)
+  {
+    drop_pending_frames(diversity);
+    pthread_mutex_destroy(&diversity->lock);
+    free(diversity);
+  }
+}
+
+void diversity_reset(diversity_t diversity)
+{
+  pthread_mutex_lock(&diversity->lock);
+  drop_pending_frames(diversity);
+  diversity->started = 0;
+  diversity->frames_selected = 0;
+  diversity->duplicates = 0;
+  diversity->frames_lost = 0;
+  pthread_mutex_unlock(&diversity->lock);
+}
+
+/* Give the next frame to the callback if it has been received, and move to
+ * the following one */
+static void advance(diversity_t diversity)
+{
+  pending_frame_t *frame = &diversity->pending[diversity->next % DIVERSITY_WINDOW];
+
+  if(frame->header)
+  {
+    diversity->frame_callback(diversity->callback_context,
+                              frame->header,
+                              frame->header + frame->header_size,
+                              frame->payload_size);
+    free(frame->header);
+    frame->header = NULL;
+    diversity->frames_selected++;
+  }
+  else
+  {
+    diversity->frames_lost++;
+  }
+  diversity->next++;
+}
+
+/* Give the frames received to the callback, only the missing frames before
+ * the last one received are lost */
+static void flush_pending_frames(diversity_t diversity)
+{
+  unsigned int i;
+  unsigned int last = 0;
+
+  for(i = 0; i < DIVERSITY_WINDOW; i++)
+  {
+    if(diversity->pending[(diversity->next + i) % DIVERSITY_WINDOW].header)
+    {
+      last = i + 1;
+    }
+  }
+  for(i = 0; i < last; i++)
+  {
+    advance(diversity);
+  }
+}
+
+void diversity_frame_received(diversity_t diversity,
+                              unsigned int counter,
+                              unsigned char *header,
+                              unsigned int header_size,
+                              unsigned char *payload,
+                              unsigned int payload_size)
+{
+  pending_frame_t *frame;
+  int distance;
+
+  pthread_mutex_lock(&diversity->lock);
+  if(!diversity->started)
+  {
+    diversity->next = counter;
+    diversity->started = 1;
+  }
+  distance = (int) (counter - diversity->next);
+  if(distance < -DIVERSITY_RESTART)
+  {
+    /* The sender has started a new stream */
+    flush_pending_frames(diversity);
+    diversity->next = counter;
+    distance = 0;
+  }
+  if(distance < 0)
+  {
+    /* Copy of a frame already given to the callback (or considered lost) */
+    diversity->duplicates++;
+    pthread_mutex_unlock(&diversity->lock);
+    return;
+  }
+  while(distance >= DIVERSITY_WINDOW)
+  {
+    /* Make room for the new frame, the missing frames are lost */
+    advance(diversity);
+    distance--;
+  }
+
+  frame = &diversity->pending[counter % DIVERSITY_WINDOW];
+  if(frame->header)
+  {
+    diversity->duplicates++;
+  }
+  else
+  {
+    frame->header = malloc(header_size + payload_size);
+    if(frame->header)
+    {
+      memcpy(frame->header, header, header_size);
+      memcpy(frame->header + header_size, payload, payload_size);
+      frame->header_size = header_size;
+      frame->payload_size = payload_size;
+    }
+  }
+
+  while(diversity->pending[diversity->next % DIVERSITY_WINDOW].header)
+  {
+    advance(diversity);
+  }
+  pthread_mutex_unlock(&diversity->lock);
+}
+
+void diversity_flush(diversity_t diversity)
+{
+  pthread_mutex_lock(&diversity->lock);
+  if(diversity->started)
+  {
+    flush_pending_frames(diversity);
+  }
+  pthread_mutex_unlock(&diversity->lock);
+}
+
+void diversity_get_statistics(diversity_t diversity,
+                              unsigned long int *frames_selected,
+                              unsigned long int *duplicates,
+                              unsigned long int *frames_lost)
+{
+  pthread_mutex_lock(&diversity->lock);
+  *frames_selected = diversity->frames_selected;
+  *duplicates = diversity->duplicates;
+  *frames_lost = diversity->frames_lost;
+  pthread_mutex_unlock(&diversity->lock);
+}
@@ -0,0 +1,78 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DIVERSITY_H
+#define DIVERSITY_H
+
+/* Maximum number of additional radios receiving the same transfer */
+#define DIVERSITY_MAX_BRANCHES 7
+
+/* Number of frames kept to put back in order the frames received by radios
+ * having different delays */
+#define DIVERSITY_WINDOW 16
+
+typedef struct diversity_s *diversity_t;
+
+/* Create the state of a selection combiner
+ *  - frame_callback: function receiving the header, the payload and the size
+ *    of the payload of each frame, in the order of the frame counters
+ *  - callback_context: first argument given to 'frame_callback'
+ *
+ * The frames received by all the radios are given to the combiner, which
+ * keeps the first copy of each frame and drops the other ones.
+ * These functions can be called from several threads, 'frame_callback' is
+ * never called by two threads at the same time.
+ * If the initialization fails, the function returns NULL.
+ */
+diversity_t diversity_create(void (*frame_callback)(void *,
+                                                    unsigned char *,
+                                                    unsigned char *,
+                                                    unsigned int),
+                             void *callback_context);
+
+/* Cleanup after a selection combiner */
+void diversity_free(diversity_t diversity);
+
+/* Forget the frames of a previous transfer */
+void diversity_reset(diversity_t diversity);
+
+/* Process a frame with counter 'counter' received by one of the radios
+ * The frame is given to 'frame_callback' when the frames preceding it have
+ * been given, or when they are considered lost because too many frames
+ * following them have been received.
+ */
+void diversity_frame_received(diversity_t diversity,
+                              unsigned int counter,
+                              unsigned char *header,
+                              unsigned int header_size,
+                              unsigned char *payload,
+                              unsigned int payload_size);
+
+/* Give the frames waiting for missing frames to 'frame_callback' */
+void diversity_flush(diversity_t diversity);
+
+/* Get the number of frames given to the callback, of copies dropped and of
+ * frames received by none of the radios */
+void diversity_get_statistics(diversity_t diversity,
+                              unsigned long int *frames_selected,
+                              unsigned long int *duplicates,
+                              unsigned long int *frames_lost);
+
+#endif
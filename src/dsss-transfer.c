@@ -22,21 +22,56 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <fcntl.h>
 #include <liquid/liquid.h>
 #include <math.h>
+#include <pthread.h>
 #include <signal.h>
 #include <SoapySDR/Device.h>
 #include <SoapySDR/Formats.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <time.h>
 #include <unistd.h>
+#include "acquisition.h"
+#include "arq.h"
+#include "cache.h"
+#include "coverage.h"
+#include "datagram.h"
+#include "diversity.h"
 #include "dsssframe.h"
 #include "dsss-transfer.h"
+#include "erasure.h"
+#include "excision.h"
 #include "gettext.h"
+#include "hopping.h"
 
 #define TAU (2 * M_PI)
 
+#define HEADER_SIZE 8
+#define MAX_HEADER_SIZE MAX(MAX(ARQ_HEADER_SIZE, ERASURE_HEADER_SIZE), \
+                            EXTENDED_HEADER_SIZE)
+
+/* Extended header: id (4 bytes), counter (4 bytes), version (1 byte),
+ * flags (1 byte), offset of the payload in the stream (8 bytes), total size
+ * of the stream (8 bytes) and checksum (2 bytes) */
+#define EXTENDED_HEADER_SIZE 28
+#define EXTENDED_HEADER_VERSION 1
+#define EXTENDED_FLAG_EOF 0x01
+#define EXTENDED_FLAG_SIZE 0x02
+#define EXTENDED_FLAG_EMPTY 0x04
+#define EXTENDED_FLAG_CAROUSEL 0x08
+
+/* Time between two checkpoints of the data received in the output file
+ * (seconds) */
+#define CHECKPOINT_INTERVAL 10
+
+/* Semi-length (in samples) of the filter of the resampler following the
+ * variations of the clock error */
+#define CLOCK_RESAMPLER_DELAY 7
+
 #define MIN(x, y) ((x < y) ? x : y)
 #define MAX(x, y) ((x > y) ? x : y)
 
@@ -56,9 +91,25 @@ typedef enum
   {
     IO,
     FILENAME,
-    SOAPYSDR
+    SOAPYSDR,
+    EXTERNAL
   } radio_type_t;
 
+/* Inner and outer FEC codes used by the adaptive rate, from the slowest to
+ * the fastest */
+static const fec_scheme adaptive_rates[][2] =
+  {
+    { LIQUID_FEC_REP5, LIQUID_FEC_NONE },
+    { LIQUID_FEC_REP3, LIQUID_FEC_NONE },
+    { LIQUID_FEC_GOLAY2412, LIQUID_FEC_NONE },
+    { LIQUID_FEC_HAMMING74, LIQUID_FEC_NONE },
+    { LIQUID_FEC_HAMMING128, LIQUID_FEC_NONE },
+    { LIQUID_FEC_SECDED7264, LIQUID_FEC_NONE },
+    { LIQUID_FEC_NONE, LIQUID_FEC_NONE }
+  };
+#define ADAPTIVE_RATES (sizeof(adaptive_rates) / sizeof(adaptive_rates[0]))
+#define ADAPTIVE_RATE_DEFAULT 4
+
 typedef union
 {
   FILE *file;
@@ -85,18 +136,105 @@ struct dsss_transfer_s
   crc_scheme crc;
   fec_scheme inner_fec;
   fec_scheme outer_fec;
+  crc_scheme header_crc;
+  fec_scheme header_inner_fec;
+  fec_scheme header_outer_fec;
+  unsigned char header_fec_set;
   char id[5];
   FILE *dump;
-  unsigned char stop;
+  atomic_uchar stop;
   int (*data_callback)(void *, unsigned char *, unsigned int);
   void *callback_context;
   unsigned int timeout;
   time_t timeout_start;
   firhilbf audio_converter;
   float audio_gain;
+  unsigned int acquisition_range;
+  float carrier_correction;
+  float ppm;
+  unsigned char auto_ppm;
+  char serial[64];
+  float clock_error;
+  unsigned int clock_estimates;
+  unsigned char clock_update;
+  unsigned int frames_received;
+  unsigned int first_counter;
+  unsigned int last_counter;
+  unsigned char tracking;
+  unsigned int superframe;
+  unsigned int preamble_size;
+  float detector_threshold;
+  unsigned int false_alarms;
+  unsigned int frames_missed;
+  arq_t arq;
+  erasure_t erasure;
+  unsigned int interleaving;
+  unsigned char adaptive_rate;
+  unsigned char extended_header;
+  unsigned long long int stream_offset;
+  unsigned long long int stream_size;
+  unsigned char stream_size_known;
+  unsigned char stream_end;
+  unsigned long long int bytes_missing;
+  char *map_file;
+  unsigned char truncate_file;
+  coverage_t coverage;
+  unsigned int passes;
+  unsigned int pass;
+  unsigned int combining;
+  off_t stream_start;
+  unsigned long long int start_offset;
+  time_t checkpoint_time;
+  datagram_t datagram;
+  int (*message_callback)(void *, unsigned char *, unsigned int);
+  void *message_context;
+  char *radio_file;
+  char *radio_gain;
+  radio_stream_t other_stream;
+  msresamp_crcf tx_resampler;
+  float tx_resampling_ratio;
+  dsss_framegen tx_frame_generator;
+  msresamp_crcf rx_resampler;
+  float rx_resampling_ratio;
+  resamp_crcf rx_clock_resampler;
+  complex float *rx_clock_samples;
+  dsss_framesync rx_frame_synchronizer;
+  hopping_t hopping;
+  unsigned int hop_counter;
+  unsigned int hop_guard;
+  unsigned char hop_retune;
+  double hop_time;
+  unsigned char excision;
+  dsss_transfer_t diversity_main;
+  dsss_transfer_t branches[DIVERSITY_MAX_BRANCHES];
+  unsigned int branches_count;
+  diversity_t diversity;
+  pthread_t thread;
+  unsigned char thread_started;
+  int event_fds[2];
+  unsigned char event_fds_open;
+  atomic_uint events;
+  pthread_mutex_t external_lock;
+  pthread_cond_t external_cond;
+  complex float *external_samples;
+  unsigned int external_size;
+  unsigned int external_done;
+  unsigned char external_end;
+  unsigned char external_finished;
+  int (*batch_callback)(void *, struct iovec *, unsigned int);
+  void *batch_context;
+  struct iovec batch[DSSS_TRANSFER_MAX_BATCH];
+  unsigned int batch_count;
+  unsigned int batch_index;
+  size_t batch_offset;
+  unsigned char batch_end;
+  size_t batch_offsets[DSSS_TRANSFER_MAX_BATCH];
+  unsigned char *batch_data;
+  size_t batch_data_size;
+  size_t batch_data_used;
 };
 
-unsigned char stop = 0;
+atomic_uchar stop = 0;
 unsigned char verbose = 0;
 
 void dsss_transfer_set_verbose(unsigned char v)
@@ -152,6 +290,183 @@ int write_data(void *context,
   return(payload_size);
 }
 
+int read_messages(void *context,
+                  unsigned char *payload,
+                  unsigned int payload_size)
+{
+  dsss_transfer_t transfer = (dsss_transfer_t) context;
+  int n;
+
+  n = datagram_get_frame(transfer->datagram, payload, payload_size);
+  if(n == 0)
+  {
+    usleep(1);
+  }
+
+  return(n);
+}
+
+int write_messages(void *context,
+                   unsigned char *payload,
+                   unsigned int payload_size)
+{
+  dsss_transfer_t transfer = (dsss_transfer_t) context;
+
+  datagram_frame_received(transfer->datagram,
+                          payload,
+                          payload_size,
+                          transfer->message_callback,
+                          transfer->message_context);
+
+  return(payload_size);
+}
+
+/* Make sure that the current batch of buffers to send is not empty, asking
+ * the application for a new one if needed. The function returns 1 if there
+ * is data to send, 0 if there is none for now, and -1 when there is no more
+ * data. */
+int fill_batch(dsss_transfer_t transfer)
+{
+  int r;
+
+  while((transfer->batch_index < transfer->batch_count) &&
+        (transfer->batch_offset == transfer->batch[transfer->batch_index].iov_len))
+  {
+    transfer->batch_index++;
+    transfer->batch_offset = 0;
+  }
+  if(transfer->batch_index < transfer->batch_count)
+  {
+    return(1);
+  }
+  if(transfer->batch_end)
+  {
+    return(-1);
+  }
+  /* All the buffers of the previous batch have been used */
+  r = transfer->batch_callback(transfer->batch_context,
+                               transfer->batch,
+                               DSSS_TRANSFER_MAX_BATCH);
+  transfer->batch_count = (r > 0) ? MIN(r, DSSS_TRANSFER_MAX_BATCH) : 0;
+  transfer->batch_index = 0;
+  transfer->batch_offset = 0;
+  if(r < 0)
+  {
+    transfer->batch_end = 1;
+    return(-1);
+  }
+  if(r == 0)
+  {
+    usleep(1);
+    return(0);
+  }
+  return(fill_batch(transfer));
+}
+
+/* Get the payload of the next frame from the batch of buffers given by the
+ * application, without copying it */
+int get_batch_data(dsss_transfer_t transfer,
+                   unsigned int payload_size,
+                   unsigned char **data)
+{
+  struct iovec *buffer;
+  unsigned int n;
+  int r = fill_batch(transfer);
+
+  if(r <= 0)
+  {
+    return(r);
+  }
+  buffer = &transfer->batch[transfer->batch_index];
+  n = MIN(buffer->iov_len - transfer->batch_offset, payload_size);
+  *data = (unsigned char *) buffer->iov_base + transfer->batch_offset;
+  transfer->batch_offset += n;
+
+  return(n);
+}
+
+/* Data callback copying the data from the batch of buffers given by the
+ * application, for the layers that need their own copy (ARQ and erasure
+ * coding) */
+int read_batch(void *context,
+               unsigned char *payload,
+               unsigned int payload_size)
+{
+  dsss_transfer_t transfer = (dsss_transfer_t) context;
+  unsigned char *data;
+  unsigned int n = 0;
+  int r;
+
+  while(n < payload_size)
+  {
+    r = get_batch_data(transfer, payload_size - n, &data);
+    if(r <= 0)
+    {
+      return((n > 0) ? (int) n : r);
+    }
+    memcpy(payload + n, data, r);
+    n += r;
+  }
+
+  return(n);
+}
+
+/* Give the payloads received to the application */
+void flush_batch(dsss_transfer_t transfer)
+{
+  unsigned int i;
+
+  if(transfer->batch_callback && (transfer->batch_count > 0))
+  {
+    /* The buffer of the payloads may have been moved by realloc(), so the
+     * addresses are computed only now */
+    for(i = 0; i < transfer->batch_count; i++)
+    {
+      transfer->batch[i].iov_base = transfer->batch_data +
+        transfer->batch_offsets[i];
+    }
+    transfer->batch_callback(transfer->batch_context,
+                             transfer->batch,
+                             transfer->batch_count);
+    transfer->batch_count = 0;
+    transfer->batch_data_used = 0;
+  }
+}
+
+/* Data callback keeping the payloads received until the end of the block of
+ * samples */
+int write_batch(void *context,
+                unsigned char *payload,
+                unsigned int payload_size)
+{
+  dsss_transfer_t transfer = (dsss_transfer_t) context;
+  size_t size = transfer->batch_data_used + payload_size;
+  unsigned char *data;
+
+  if(size > transfer->batch_data_size)
+  {
+    data = realloc(transfer->batch_data, size);
+    if(data == NULL)
+    {
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      return(0);
+    }
+    transfer->batch_data = data;
+    transfer->batch_data_size = size;
+  }
+  memcpy(transfer->batch_data + transfer->batch_data_used, payload, payload_size);
+  transfer->batch_offsets[transfer->batch_count] = transfer->batch_data_used;
+  transfer->batch[transfer->batch_count].iov_len = payload_size;
+  transfer->batch_count++;
+  transfer->batch_data_used = size;
+  if(transfer->batch_count == DSSS_TRANSFER_MAX_BATCH)
+  {
+    flush_batch(transfer);
+  }
+
+  return(payload_size);
+}
+
 void write_audio(dsss_transfer_t transfer,
                  complex float *samples,
                  unsigned int samples_size,
@@ -196,6 +511,100 @@ unsigned int read_audio(dsss_transfer_t transfer,
   return(n);
 }
 
+/* Get the time until which to wait for the application before checking the
+ * stop flags again */
+void get_external_deadline(struct timespec *deadline)
+{
+  clock_gettime(CLOCK_REALTIME, deadline);
+  deadline->tv_nsec += 100000000;
+  if(deadline->tv_nsec >= 1000000000)
+  {
+    deadline->tv_sec++;
+    deadline->tv_nsec -= 1000000000;
+  }
+}
+
+/* Copy samples to or from the buffers given by the application with
+ * dsss_transfer_pull_samples() or dsss_transfer_push_samples(). The function
+ * returns when 'samples_size' samples have been copied, or earlier when the
+ * application has no more samples or when the transfer is stopped. */
+unsigned int exchange_external_samples(dsss_transfer_t transfer,
+                                       complex float *samples,
+                                       unsigned int samples_size)
+{
+  struct timespec deadline;
+  unsigned int n = 0;
+  unsigned int size;
+  complex float *buffer;
+
+  pthread_mutex_lock(&transfer->external_lock);
+  while((n < samples_size) && (!stop) && (!transfer->stop))
+  {
+    if(transfer->external_done == transfer->external_size)
+    {
+      if(transfer->external_end)
+      {
+        break;
+      }
+      get_external_deadline(&deadline);
+      pthread_cond_timedwait(&transfer->external_cond,
+                             &transfer->external_lock,
+                             &deadline);
+      continue;
+    }
+    size = MIN(samples_size - n,
+               transfer->external_size - transfer->external_done);
+    buffer = &transfer->external_samples[transfer->external_done];
+    if(transfer->emit)
+    {
+      memcpy(buffer, &samples[n], size * sizeof(complex float));
+    }
+    else
+    {
+      memcpy(&samples[n], buffer, size * sizeof(complex float));
+    }
+    n += size;
+    transfer->external_done += size;
+    if(transfer->external_done == transfer->external_size)
+    {
+      /* Give the buffer back to the application */
+      pthread_cond_broadcast(&transfer->external_cond);
+    }
+  }
+  pthread_mutex_unlock(&transfer->external_lock);
+  return(n);
+}
+
+/* Lend a buffer of the application to a transfer using the external radio
+ * until the transfer has used all of it */
+unsigned int lend_external_buffer(dsss_transfer_t transfer,
+                                  complex float *samples,
+                                  unsigned int samples_size)
+{
+  struct timespec deadline;
+  unsigned int n;
+
+  pthread_mutex_lock(&transfer->external_lock);
+  transfer->external_samples = samples;
+  transfer->external_size = samples_size;
+  transfer->external_done = 0;
+  pthread_cond_broadcast(&transfer->external_cond);
+  while((transfer->external_done < transfer->external_size) &&
+        !transfer->external_finished && (!stop) && (!transfer->stop))
+  {
+    get_external_deadline(&deadline);
+    pthread_cond_timedwait(&transfer->external_cond,
+                           &transfer->external_lock,
+                           &deadline);
+  }
+  n = transfer->external_done;
+  transfer->external_samples = NULL;
+  transfer->external_size = 0;
+  transfer->external_done = 0;
+  pthread_mutex_unlock(&transfer->external_lock);
+  return(n);
+}
+
 void send_to_radio(dsss_transfer_t transfer,
                    complex float *samples,
                    unsigned int samples_size,
@@ -295,6 +704,10 @@ void send_to_radio(dsss_transfer_t transfer,
       while((r != SOAPY_SDR_UNDERFLOW) && (!stop) && (!transfer->stop));
     }
     break;
+
+  case EXTERNAL:
+    exchange_external_samples(transfer, samples, samples_size);
+    break;
   }
 }
 
@@ -352,6 +765,10 @@ unsigned int receive_from_radio(dsss_transfer_t transfer,
       n = r;
     }
     break;
+
+  case EXTERNAL:
+    n = exchange_external_samples(transfer, samples, samples_size);
+    break;
   }
   return(n);
 }
@@ -369,726 +786,3315 @@ unsigned int get_counter(unsigned char *header)
   return((header[4] << 24) | (header[5] << 16) | (header[6] << 8) | header[7]);
 }
 
-void send_dummy_samples(dsss_transfer_t transfer,
-                        msresamp_crcf resampler,
-                        nco_crcf oscillator,
-                        complex float *samples,
-                        unsigned int delay,
-                        int last)
+void set_uint64(unsigned char *buffer, unsigned long long int x)
 {
   unsigned int i;
-  unsigned int n;
-  complex float zero_sample = 0;
 
-  for(i = 0; i < delay; i++)
+  for(i = 0; i < 8; i++)
   {
-    msresamp_crcf_execute(resampler, &zero_sample, 1, samples, &n);
-    if(transfer->frequency_offset != 0)
-    {
-      nco_crcf_mix_block_up(oscillator, samples, samples, n);
-    }
-    if(i + 1 < delay)
-    {
-      send_to_radio(transfer, samples, n, 0);
-    }
-    else
-    {
-      send_to_radio(transfer, samples, n, last);
-    }
+    buffer[i] = (x >> (56 - (8 * i))) & 255;
   }
 }
 
-void send_frames(dsss_transfer_t transfer)
+unsigned long long int get_uint64(unsigned char *buffer)
 {
-  unsigned int samples_per_symbol = 2;
-  float samples_per_bit = transfer->spreading_factor * samples_per_symbol;
-  dsssframegenprops_s frame_properties;
-  dsssframegen frame_generator;
-  float resampling_ratio = (float) transfer->sample_rate / (transfer->bit_rate *
-                                                            samples_per_bit);
-  msresamp_crcf resampler = msresamp_crcf_create(resampling_ratio, 60);
-  unsigned int delay = ceilf(msresamp_crcf_get_delay(resampler));
-  unsigned int header_size = 8;
-  unsigned char header[header_size];
-  /* Try to make frames of approximately 100 ms, but containing at least
-   * 16 bytes and at most 8000 bytes of payload */
-  unsigned int byte_rate = transfer->bit_rate / 8;
-  unsigned int payload_size = MIN(MAX(byte_rate * 0.1, 16), 8000);
-  int r;
-  unsigned int n;
+  unsigned long long int x = 0;
   unsigned int i;
-  /* Process data by blocks of 50 ms */
-  unsigned int frame_samples_size = ceilf((transfer->bit_rate *
-                                           samples_per_bit) / 20.0);
-  unsigned int samples_size = ceilf((frame_samples_size + delay) * resampling_ratio);
-  int frame_complete;
-  float center_frequency = (float) transfer->frequency_offset / transfer->sample_rate;
-  nco_crcf oscillator = nco_crcf_create(LIQUID_NCO);
-  float maximum_amplitude = 1;
-  unsigned int counter = 0;
-  unsigned char *payload = malloc(payload_size);
-  complex float *frame_samples = malloc(frame_samples_size * sizeof(complex float));
-  complex float *samples = malloc(samples_size * sizeof(complex float));
 
-  if((payload == NULL) || (frame_samples == NULL) || (samples == NULL))
+  for(i = 0; i < 8; i++)
   {
-    fprintf(stderr, _("Error: Memory allocation failed\n"));
-    exit(EXIT_FAILURE);
+    x = (x << 8) | buffer[i];
   }
+  return(x);
+}
 
-  nco_crcf_set_phase(oscillator, 0);
-  nco_crcf_set_frequency(oscillator, TAU * center_frequency);
+void set_extended_header(unsigned char *header,
+                         unsigned char flags,
+                         unsigned long long int offset,
+                         unsigned long long int size)
+{
+  unsigned int checksum;
 
-  frame_properties.check = transfer->crc;
-  frame_properties.fec0 = transfer->inner_fec;
-  frame_properties.fec1 = transfer->outer_fec;
-  frame_generator = dsssframegen_create_set(transfer->spreading_factor,
-                                            &frame_properties);
-  dsssframegen_set_header_props(frame_generator, &frame_properties);
-  dsssframegen_set_header_len(frame_generator, header_size);
-  memcpy(header, transfer->id, 4);
-  set_counter(header, counter);
+  header[8] = EXTENDED_HEADER_VERSION;
+  header[9] = flags;
+  set_uint64(&header[10], offset);
+  set_uint64(&header[18], size);
+  checksum = crc_generate_key(LIQUID_CRC_16, header, EXTENDED_HEADER_SIZE - 2);
+  header[26] = (checksum >> 8) & 255;
+  header[27] = checksum & 255;
+}
 
-  while((!stop) && (!transfer->stop))
+int check_extended_header(unsigned char *header)
+{
+  unsigned int checksum = crc_generate_key(LIQUID_CRC_16,
+                                           header,
+                                           EXTENDED_HEADER_SIZE - 2);
+
+  return((header[8] == EXTENDED_HEADER_VERSION) &&
+         (header[26] == ((checksum >> 8) & 255)) &&
+         (header[27] == (checksum & 255)));
+}
+
+/* Set the gain of the radio for a direction */
+void set_radio_gain(dsss_transfer_t transfer, int direction, char *gain)
+{
+  SoapySDRKwargs kwargs;
+  unsigned int n;
+  char *gain_name;
+  int gain_value;
+
+  if(strchr(gain, '='))
   {
-    r = transfer->data_callback(transfer->callback_context, payload, payload_size);
-    if(r < 0)
+    kwargs = SoapySDRKwargs_fromString(gain);
+    for(n = 0; n < kwargs.size; n++)
     {
-      break;
+      gain_name = kwargs.keys[n];
+      gain_value = strtoul(kwargs.vals[n], NULL, 10);
+      SOAPYSDR_CHECK(SoapySDRDevice_setGainElement(transfer->radio_device.soapysdr,
+                                                   direction,
+                                                   0,
+                                                   gain_name,
+                                                   gain_value));
     }
-    n = r;
-    if(n > 0)
+    SoapySDRKwargs_clear(&kwargs);
+  }
+  else
+  {
+    gain_value = strtoul(gain, NULL, 10);
+    SOAPYSDR_CHECK(SoapySDRDevice_setGain(transfer->radio_device.soapysdr,
+                                          direction,
+                                          0,
+                                          gain_value));
+  }
+}
+
+/* Configure the radio for a direction and open the stream of samples */
+SoapySDRStream * setup_radio_stream(dsss_transfer_t transfer,
+                                    int direction,
+                                    char *gain)
+{
+  SoapySDRStream *stream;
+
+  SOAPYSDR_CHECK(SoapySDRDevice_setSampleRate(transfer->radio_device.soapysdr,
+                                              direction,
+                                              0,
+                                              transfer->sample_rate));
+  SOAPYSDR_CHECK(SoapySDRDevice_setFrequency(transfer->radio_device.soapysdr,
+                                             direction,
+                                             0,
+                                             transfer->frequency - transfer->frequency_offset,
+                                             NULL));
+  set_radio_gain(transfer, direction, gain);
+  stream = SoapySDRDevice_setupStream(transfer->radio_device.soapysdr,
+                                      direction,
+                                      SOAPY_SDR_CF32,
+                                      NULL,
+                                      0,
+                                      NULL);
+  if(stream == NULL)
+  {
+    fprintf(stderr, _("Error: %s\n"), SoapySDRDevice_lastError());
+  }
+
+  return(stream);
+}
+
+/* Find the serial number of the radio, to be able to save its clock error */
+void set_radio_serial(dsss_transfer_t transfer, char *radio_driver)
+{
+  SoapySDRKwargs args = SoapySDRKwargs_fromString(radio_driver);
+  SoapySDRKwargs info;
+  const char *serial = SoapySDRKwargs_get(&args, "serial");
+  unsigned int i;
+  unsigned int n = 0;
+
+  if(serial == NULL)
+  {
+    info = SoapySDRDevice_getHardwareInfo(transfer->radio_device.soapysdr);
+    serial = SoapySDRKwargs_get(&info, "serial");
+  }
+  else
+  {
+    bzero(&info, sizeof(info));
+  }
+  if(serial != NULL)
+  {
+    /* Only keep the characters that can safely be used in a filename */
+    for(i = 0; (serial[i] != '\0') && (n + 1 < sizeof(transfer->serial)); i++)
     {
-      dsssframegen_assemble(frame_generator, header, payload, n);
-      frame_complete = 0;
-      while(!frame_complete)
+      if(((serial[i] >= '0') && (serial[i] <= '9')) ||
+         ((serial[i] >= 'a') && (serial[i] <= 'z')) ||
+         ((serial[i] >= 'A') && (serial[i] <= 'Z')) ||
+         (serial[i] == '-') ||
+         (serial[i] == '_'))
       {
-        frame_complete = dsssframegen_write_samples(frame_generator,
-                                                    frame_samples,
-                                                    frame_samples_size);
-        n = frame_samples_size;
-        if(frame_complete)
-        {
-          /* Don't send the padding 0 bytes */
-          while((n > 0) && (frame_samples[n - 1] == 0))
-          {
-            n--;
-          }
-        }
-        /* Reduce the amplitude of samples because the frame generator and
-         * the resampler may produce samples with an amplitude greater than
-         * 1.0 depending on the number of carriers and resampling ratio */
-        maximum_amplitude = 1;
-        for(i = 0; i < n; i++)
-        {
-          if(cabsf(frame_samples[i]) > maximum_amplitude)
-          {
-            maximum_amplitude = cabsf(frame_samples[i]);
-          }
-        }
-        liquid_vectorcf_mulscalar(frame_samples,
-                                  n,
-                                  0.75 / maximum_amplitude,
-                                  frame_samples);
-        msresamp_crcf_execute(resampler, frame_samples, n, samples, &n);
-        if(transfer->frequency_offset != 0)
-        {
-          nco_crcf_mix_block_up(oscillator, samples, samples, n);
-        }
-        send_to_radio(transfer, samples, n, 0);
+        transfer->serial[n] = serial[i];
+        n++;
       }
-      counter++;
-      set_counter(header, counter);
     }
-    else
+  }
+  transfer->serial[n] = '\0';
+  SoapySDRKwargs_clear(&info);
+  SoapySDRKwargs_clear(&args);
+}
+
+/* Get the path of the file where the clock error of the radio is saved */
+int get_clock_error_file(dsss_transfer_t transfer,
+                         char *path,
+                         unsigned int path_size,
+                         unsigned char create_directory)
+{
+  char *config = getenv("XDG_CONFIG_HOME");
+  char *home = getenv("HOME");
+  char directory[path_size];
+
+  if(transfer->serial[0] == '\0')
+  {
+    return(-1);
+  }
+  if((config != NULL) && (config[0] != '\0'))
+  {
+    snprintf(directory, path_size, "%s/dsss-transfer", config);
+  }
+  else if((home != NULL) && (home[0] != '\0'))
+  {
+    snprintf(directory, path_size, "%s/.config", home);
+    if(create_directory)
     {
-      /* Underrun when reading from stdin. Send some dummy samples to get the
-       * remaining output samples for the end of current frame (because of
-       * resampler and filter delays) and send them */
-      send_dummy_samples(transfer,
-                         resampler,
-                         oscillator,
-                         samples,
-                         delay,
-                         0);
+      mkdir(directory, 0755);
     }
+    snprintf(directory, path_size, "%s/.config/dsss-transfer", home);
+  }
+  else
+  {
+    return(-1);
+  }
+  if(create_directory)
+  {
+    mkdir(directory, 0755);
   }
+  snprintf(path, path_size, "%s/clock-%s", directory, transfer->serial);
 
-  /* Send some dummy samples to get the remaining output samples (because of
-   * resampler and filter delays) */
-  send_dummy_samples(transfer,
-                     resampler,
-                     oscillator,
-                     samples,
-                     delay,
-                     1);
-
-  free(samples);
-  free(frame_samples);
-  free(payload);
-  nco_crcf_destroy(oscillator);
-  msresamp_crcf_destroy(resampler);
-  dsssframegen_destroy(frame_generator);
+  return(0);
 }
 
-int frame_received(unsigned char *header,
-                   int header_valid,
-                   unsigned char *payload,
-                   unsigned int payload_size,
-                   int payload_valid,
-                   framesyncstats_s stats,
-                   void *user_data)
+void load_clock_error(dsss_transfer_t transfer)
 {
-  dsss_transfer_t transfer = (dsss_transfer_t) user_data;
-  char id[5];
-  unsigned int counter;
-
-  transfer->timeout_start = time(NULL);
-  memcpy(id, header, 4);
-  id[4] = '\0';
-  counter = get_counter(header);
+  char path[1024];
+  FILE *file;
+  float ppm;
 
-  if(!header_valid || !payload_valid)
+  transfer->clock_error = 0;
+  transfer->clock_estimates = 0;
+  if(get_clock_error_file(transfer, path, sizeof(path), 0) != 0)
   {
-    if(verbose)
-    {
-      if(!header_valid)
-      {
-        fprintf(stderr, _("Frame %u for '%s': corrupted header\n"), counter, id);
-      }
-      if(!payload_valid)
-      {
-        fprintf(stderr, _("Frame %u for '%s': corrupted payload\n"), counter, id);
-      }
-      fflush(stderr);
-    }
+    return;
   }
-  else if(memcmp(id, transfer->id, 4) != 0)
+  file = fopen(path, "r");
+  if(file == NULL)
+  {
+    return;
+  }
+  if(fscanf(file, "%f", &ppm) == 1)
   {
+    /* The saved value is the total clock error, including the manual
+     * correction used at the time */
+    transfer->clock_error = ppm - transfer->ppm;
+    transfer->clock_estimates = 1;
     if(verbose)
     {
-      fprintf(stderr, _("Frame %u for '%s': ignored\n"), counter, id);
-      fflush(stderr);
+      fprintf(stderr, _("Info: Using saved clock error: %.2f ppm\n"), ppm);
     }
   }
-  else
-  {
-    transfer->data_callback(transfer->callback_context, payload, payload_size);
-  }
-  return(0);
+  fclose(file);
 }
 
-void receive_frames(dsss_transfer_t transfer)
+void save_clock_error(dsss_transfer_t transfer)
 {
-  unsigned int samples_per_symbol = 2;
-  float samples_per_bit = transfer->spreading_factor * samples_per_symbol;
-  dsssframegenprops_s frame_properties;
-  dsssframesync frame_synchronizer;
-  float resampling_ratio = (transfer->bit_rate *
-                            samples_per_bit) / (float) transfer->sample_rate;
-  msresamp_crcf resampler = msresamp_crcf_create(resampling_ratio, 60);
-  unsigned int delay = ceilf(msresamp_crcf_get_delay(resampler));
-  unsigned int header_size = 8;
-  unsigned int n;
-  /* Process data by blocks of 50 ms */
-  unsigned int frame_samples_size = ceilf((transfer->bit_rate *
-                                           samples_per_bit) / 20.0);
-  unsigned int samples_size = floorf(frame_samples_size / resampling_ratio);
-  nco_crcf oscillator = nco_crcf_create(LIQUID_NCO);
-  complex float *frame_samples = malloc((frame_samples_size + delay) *
-                                        sizeof(complex float));
-  complex float *samples = malloc((samples_size + delay) *
-                                  sizeof(complex float));
-
-  if((frame_samples == NULL) || (samples == NULL))
-  {
-    fprintf(stderr, _("Error: Memory allocation failed\n"));
-    exit(EXIT_FAILURE);
-  }
-
-  nco_crcf_set_phase(oscillator, 0);
-  nco_crcf_set_frequency(oscillator, TAU * ((float) transfer->frequency_offset /
-                                            transfer->sample_rate));
-
-  frame_synchronizer = dsssframesync_create_set(transfer->spreading_factor,
-                                                frame_received,
-                                                transfer);
-  frame_properties.check = transfer->crc;
-  frame_properties.fec0 = transfer->inner_fec;
-  frame_properties.fec1 = transfer->outer_fec;
-  dsssframesync_set_header_props(frame_synchronizer, &frame_properties);
-  dsssframesync_set_header_len(frame_synchronizer, header_size);
+  char path[1024];
+  FILE *file;
 
-  while((!stop) && (!transfer->stop))
+  if(verbose)
   {
-    n = receive_from_radio(transfer, samples, samples_size);
-    if((n == 0) &&
-       ((transfer->radio_type == IO) || (transfer->radio_type == FILENAME)))
-    {
-      break;
-    }
-    if((transfer->timeout > 0) &&
-       (time(NULL) > transfer->timeout_start + transfer->timeout))
-    {
-      if(verbose)
-      {
-        fprintf(stderr, _("Timeout: %d s without frames\n"), transfer->timeout);
-      }
-      break;
-    }
-    if(transfer->dump)
-    {
-      dump_samples(transfer, samples, n);
-    }
-    if(transfer->frequency_offset != 0)
-    {
-      nco_crcf_mix_block_down(oscillator, samples, samples, n);
-    }
-    msresamp_crcf_execute(resampler, samples, n, frame_samples, &n);
-    dsssframesync_execute(frame_synchronizer, frame_samples, n);
+    fprintf(stderr,
+            _("Info: Estimated clock error: %.2f ppm\n"),
+            transfer->ppm + transfer->clock_error);
   }
-
-  for(n = 0; n < delay; n++)
+  if(get_clock_error_file(transfer, path, sizeof(path), 1) != 0)
   {
-    samples[n] = 0;
+    return;
   }
-  msresamp_crcf_execute(resampler, samples, delay, frame_samples, &n);
-  dsssframesync_execute(frame_synchronizer, frame_samples, n);
-  while(dsssframesync_is_frame_open(frame_synchronizer))
+  file = fopen(path, "w");
+  if(file == NULL)
   {
-    dsssframesync_execute(frame_synchronizer, samples, 1);
+    fprintf(stderr, _("Error: Failed to open '%s'\n"), path);
+    return;
   }
-
-  free(samples);
-  free(frame_samples);
-  nco_crcf_destroy(oscillator);
-  msresamp_crcf_destroy(resampler);
-  dsssframesync_destroy(frame_synchronizer);
+  fprintf(file, "%f\n", transfer->ppm + transfer->clock_error);
+  fclose(file);
 }
 
-dsss_transfer_t dsss_transfer_create_callback(char *radio_driver,
-                                              unsigned char emit,
-                                              int (*data_callback)(void *,
-                                                                   unsigned char *,
-                                                                   unsigned int),
-                                              void *callback_context,
-                                              unsigned long int sample_rate,
-                                              unsigned int bit_rate,
-                                              unsigned long int frequency,
-                                              long int frequency_offset,
-                                              char *gain,
-                                              float ppm,
-                                              unsigned int spreading_factor,
-                                              char *inner_fec,
-                                              char *outer_fec,
-                                              char *id,
-                                              char *dump,
-                                              unsigned int timeout,
-                                              unsigned char audio)
+/* Get the time of a monotonic clock (in s) */
+double get_time()
 {
-  int direction;
-  SoapySDRKwargs kwargs;
-  unsigned int n;
-  char *gain_name;
-  int gain_value;
-  dsss_transfer_t transfer = malloc(sizeof(struct dsss_transfer_s));
+  struct timespec t;
 
-  if(transfer == NULL)
-  {
-    fprintf(stderr, _("Error: Memory allocation failed\n"));
-    return(NULL);
-  }
-  bzero(transfer, sizeof(struct dsss_transfer_s));
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return(t.tv_sec + (t.tv_nsec / 1000000000.0));
+}
 
-  if(strcasecmp(radio_driver, "io") == 0)
-  {
-    transfer->radio_type = IO;
-  }
-  else if(strncasecmp(radio_driver, "file=", 5) == 0)
+/* Get a resampler for a ratio, reusing the one kept from the previous
+ * transfers when the ratio didn't change */
+msresamp_crcf get_resampler(msresamp_crcf *resampler,
+                            float *resampling_ratio,
+                            float ratio)
+{
+  if(*resampler && (*resampling_ratio == ratio))
   {
-    transfer->radio_type = FILENAME;
+    msresamp_crcf_reset(*resampler);
   }
   else
   {
-    transfer->radio_type = SOAPYSDR;
+    cache_release_resampler(*resampler, *resampling_ratio);
+    *resampler = cache_get_resampler(ratio);
+    *resampling_ratio = ratio;
   }
 
-  transfer->stop = 0;
-  transfer->emit = emit;
-  transfer->file = NULL;
-  transfer->data_callback = data_callback;
-  transfer->callback_context = callback_context;
+  return(*resampler);
+}
 
-  if(sample_rate != 0)
+/* Get the sample rate of the radio, taking the estimated clock error into
+ * account */
+float get_corrected_sample_rate(dsss_transfer_t transfer)
+{
+  return(transfer->sample_rate * (1 + (transfer->clock_error / 1000000.0)));
+}
+
+/* Get the frequency shift (in Hz) of the signal caused by the estimated clock
+ * error of the radio */
+float get_clock_frequency_shift(dsss_transfer_t transfer)
+{
+  float radio_frequency = (float) transfer->frequency - transfer->frequency_offset;
+
+  return((-transfer->clock_error * radio_frequency) / 1000000.0);
+}
+
+/* Get the frequency of the signal in the samples of the radio (Hz), which is
+ * the frequency of the channel of the current frame when using frequency
+ * hopping */
+float get_signal_frequency(dsss_transfer_t transfer)
+{
+  if(transfer->hopping)
   {
-    transfer->sample_rate = sample_rate * ((1000000.0 - ppm) / 1000000.0);
+    return(transfer->frequency_offset +
+           hopping_get_offset(transfer->hopping, transfer->hop_counter));
   }
-  else
+  return(transfer->frequency_offset);
+}
+
+/* Update the estimated clock error of the radio using the carrier frequency
+ * offset found by the synchronizer for a frame
+ *  - cfo: residual carrier frequency offset (radians per sample) */
+void update_clock_error(dsss_transfer_t transfer, float cfo)
+{
+  float synchronizer_rate = transfer->bit_rate * transfer->spreading_factor * 2;
+  float radio_frequency = (float) transfer->frequency - transfer->frequency_offset;
+  float offset;
+  float clock_error;
+
+  if(radio_frequency <= 0)
   {
-    fprintf(stderr, _("Error: Invalid sample rate\n"));
-    free(transfer);
-    return(NULL);
+    return;
   }
 
-  if(frequency != 0)
+  /* Shift of the signal before the corrections applied by the receiver */
+  offset = transfer->carrier_correction + ((cfo * synchronizer_rate) / TAU);
+  clock_error = (-offset * 1000000.0) / radio_frequency;
+  if(transfer->clock_estimates == 0)
   {
-    transfer->frequency = frequency * ((1000000.0 - ppm) / 1000000.0);
+    transfer->clock_error = clock_error;
   }
   else
   {
-    fprintf(stderr, _("Error: Invalid frequency\n"));
-    free(transfer);
-    return(NULL);
+    transfer->clock_error += 0.25 * (clock_error - transfer->clock_error);
   }
+  transfer->clock_estimates++;
+  transfer->clock_update = 1;
+}
 
-  transfer->frequency_offset = frequency_offset;
-
-  if(audio)
+unsigned int get_header_size(dsss_transfer_t transfer)
+{
+  if(transfer->diversity_main)
   {
-    if((transfer->radio_type == IO) || (transfer->radio_type == FILENAME))
-    {
-      transfer->audio_converter = firhilbf_create(25, 60);
-      /* The rate of audio samples is twice the rate of IQ samples */
-      transfer->sample_rate = transfer->sample_rate / 2;
-      /* -(sample_rate / 2) Hz IQ <=> 0 Hz audio
-       * (sample_rate / 2) Hz IQ <=> (sample_rate * 2) Hz audio */
-      transfer->frequency_offset = transfer->frequency - (transfer->sample_rate / 2);
-      transfer->frequency = 0;
-      gain_value = strtol(gain, NULL, 10);
-      transfer->audio_gain = powf(10, gain_value / 20.0);
-    }
-    else
-    {
-      fprintf(stderr, _("Error: This radio type only supports IQ samples\n"));
-      free(transfer);
-      return(NULL);
-    }
+    /* The frames are decoded by a branch but processed by the main transfer */
+    return(get_header_size(transfer->diversity_main));
   }
-  else
+  else if(transfer->arq)
   {
-    transfer->audio_converter = NULL;
-    transfer->audio_gain = 0;
+    return(ARQ_HEADER_SIZE);
   }
-
-  if(bit_rate != 0)
+  else if(transfer->erasure)
   {
-    transfer->bit_rate = bit_rate;
+    return(ERASURE_HEADER_SIZE);
   }
-  else
+  else if(transfer->extended_header)
   {
-    fprintf(stderr, _("Error: Invalid bit rate\n"));
-    free(transfer);
-    return(NULL);
+    return(EXTENDED_HEADER_SIZE);
   }
-
-  if(spreading_factor >= 2)
+  else
   {
-    transfer->spreading_factor = spreading_factor;
+    return(HEADER_SIZE);
   }
-  else
+}
+
+/* The total size of the data is known when sending a regular file */
+void set_stream_size(dsss_transfer_t transfer)
+{
+  struct stat file_stat;
+
+  transfer->stream_size = 0;
+  transfer->stream_size_known = 0;
+  if(transfer->file &&
+     (fstat(fileno(transfer->file), &file_stat) == 0) &&
+     S_ISREG(file_stat.st_mode))
   {
-    fprintf(stderr, _("Error: Invalid spreading factor\n"));
-    free(transfer);
-    return(NULL);
+    transfer->stream_start = ftello(transfer->file);
+    transfer->stream_size = file_stat.st_size - transfer->stream_start;
+    transfer->stream_size_known = 1;
   }
+}
 
-  transfer->crc = LIQUID_CRC_32;
+/* Get the data for the next frame and prepare its header */
+int get_frame_data(dsss_transfer_t transfer,
+                   unsigned char *header,
+                   unsigned char *payload,
+                   unsigned int payload_size,
+                   unsigned int *counter,
+                   unsigned char **data)
+{
+  unsigned char flags;
+  unsigned char repeat = 0;
+  int r;
 
-  transfer->inner_fec = liquid_getopt_str2fec(inner_fec);
-  if(transfer->inner_fec == LIQUID_FEC_UNKNOWN)
+  /* The data is in 'payload', unless it is taken directly from a buffer of
+   * the application */
+  *data = payload;
+  if(transfer->arq)
   {
-    fprintf(stderr, _("Error: Invalid inner FEC\n"));
-    free(transfer);
-    return(NULL);
+    return(arq_get_frame(transfer->arq,
+                         header,
+                         payload,
+                         payload_size,
+                         transfer->data_callback,
+                         transfer->callback_context));
+  }
+  if(transfer->erasure)
+  {
+    return(erasure_get_frame(transfer->erasure,
+                             header,
+                             payload,
+                             payload_size,
+                             transfer->data_callback,
+                             transfer->callback_context));
   }
 
-  transfer->outer_fec = liquid_getopt_str2fec(outer_fec);
-  if(transfer->outer_fec == LIQUID_FEC_UNKNOWN)
+  if(transfer->extended_header && transfer->stream_end)
   {
-    fprintf(stderr, _("Error: Invalid outer FEC\n"));
-    free(transfer);
-    return(NULL);
+    return(-1);
   }
 
-  if(strlen(id) <= 4)
+  if(transfer->batch_callback)
   {
-    strcpy(transfer->id, id);
+    r = get_batch_data(transfer, payload_size, data);
   }
   else
   {
-    fprintf(stderr, _("Error: Id must be at most 4 bytes long\n"));
-    free(transfer);
-    return(NULL);
+    r = transfer->data_callback(transfer->callback_context, payload, payload_size);
   }
-
-  if(dump)
+  if(r > 0)
   {
-    transfer->dump = fopen(dump, "wb");
+    set_counter(header, *counter);
+    (*counter)++;
+  }
+  if(transfer->extended_header)
+  {
+    flags = transfer->stream_size_known ? EXTENDED_FLAG_SIZE : 0;
+    if(transfer->passes != 1)
+    {
+      flags |= EXTENDED_FLAG_CAROUSEL;
+    }
+    if(r < 0)
+    {
+      /* Tell the receiver that there is no more data with a last frame
+       * without data */
+      set_counter(header, *counter);
+      (*counter)++;
+      payload[0] = 0;
+      set_extended_header(header,
+                          flags | EXTENDED_FLAG_EOF | EXTENDED_FLAG_EMPTY,
+                          transfer->stream_offset,
+                          transfer->stream_size);
+      transfer->stream_end = 1;
+      return(1);
+    }
+    if(r > 0)
+    {
+      if(transfer->stream_size_known &&
+         (transfer->stream_offset + r >= transfer->stream_size))
+      {
+        flags |= EXTENDED_FLAG_EOF;
+        transfer->pass++;
+        if((transfer->passes == 0) || (transfer->pass < transfer->passes))
+        {
+          repeat = 1;
+        }
+        else
+        {
+          transfer->stream_end = 1;
+        }
+      }
+      set_extended_header(header,
+                          flags,
+                          transfer->stream_offset,
+                          transfer->stream_size);
+      transfer->stream_offset += r;
+      if(repeat)
+      {
+        /* Send the file again with the same offsets */
+        fseeko(transfer->file, transfer->stream_start, SEEK_SET);
+        transfer->stream_offset = 0;
+        if(verbose)
+        {
+          fprintf(stderr,
+                  _("Info: Repetition %u of the stream\n"),
+                  transfer->pass + 1);
+        }
+      }
+    }
+  }
+  return(r);
+}
+
+void send_dummy_samples(dsss_transfer_t transfer,
+                        msresamp_crcf resampler,
+                        nco_crcf oscillator,
+                        complex float *samples,
+                        unsigned int delay,
+                        int last)
+{
+  unsigned int i;
+  unsigned int n;
+  complex float zero_sample = 0;
+
+  for(i = 0; i < delay; i++)
+  {
+    msresamp_crcf_execute(resampler, &zero_sample, 1, samples, &n);
+    if((transfer->frequency_offset != 0) || (transfer->clock_error != 0) ||
+       transfer->hopping)
+    {
+      nco_crcf_mix_block_up(oscillator, samples, samples, n);
+    }
+    if(i + 1 < delay)
+    {
+      send_to_radio(transfer, samples, n, 0);
+    }
+    else
+    {
+      send_to_radio(transfer, samples, n, last);
+    }
+  }
+}
+
+/* Get the rate to use for the frame whose data has just been obtained */
+unsigned int get_frame_rate(dsss_transfer_t transfer)
+{
+  return(transfer->adaptive_rate ? arq_get_rate(transfer->arq) : 0);
+}
+
+/* Use the FEC codes of an adaptive rate for the next frames */
+void set_frame_rate(dsss_framegen frame_generator,
+                    dsssframegenprops_s *frame_properties,
+                    unsigned int rate)
+{
+  if((frame_properties->fec0 == adaptive_rates[rate][0]) &&
+     (frame_properties->fec1 == adaptive_rates[rate][1]))
+  {
+    return;
+  }
+  frame_properties->fec0 = adaptive_rates[rate][0];
+  frame_properties->fec1 = adaptive_rates[rate][1];
+  dsss_framegen_setprops(frame_generator, frame_properties);
+  if(verbose)
+  {
+    fprintf(stderr,
+            _("Info: Using FEC %s,%s\n"),
+            fec_scheme_str[frame_properties->fec0][0],
+            fec_scheme_str[frame_properties->fec1][0]);
+  }
+}
+
+/* Write the frames that the frame generator has ready */
+void send_assembled_frames(dsss_transfer_t transfer,
+                           dsss_framegen frame_generator,
+                           msresamp_crcf resampler,
+                           nco_crcf oscillator,
+                           complex float *frame_samples,
+                           unsigned int frame_samples_size,
+                           complex float *samples)
+{
+  int frame_complete;
+  float maximum_amplitude;
+  unsigned int n;
+  unsigned int m;
+  unsigned int i;
+
+  while(dsss_framegen_is_assembled(frame_generator))
+  {
+    if(transfer->hopping)
+    {
+      /* Go to the channel of this frame */
+      nco_crcf_set_frequency(oscillator,
+                             TAU * ((get_signal_frequency(transfer) +
+                                     get_clock_frequency_shift(transfer)) /
+                                    get_corrected_sample_rate(transfer)));
+    }
+    frame_complete = 0;
+    while(!frame_complete)
+    {
+      frame_complete = dsss_framegen_write_samples(frame_generator,
+                                                   frame_samples,
+                                                   frame_samples_size);
+      n = frame_samples_size;
+      if(frame_complete)
+      {
+        /* Don't send the padding 0 bytes. The exact length of the frame is
+         * kept so that the receiver can find the next frame right after
+         * this one when tracking. */
+        n = dsss_framegen_get_frame_end(frame_generator);
+      }
+      /* Reduce the amplitude of samples because the frame generator and
+       * the resampler may produce samples with an amplitude greater than
+       * 1.0 depending on the number of carriers and resampling ratio */
+      maximum_amplitude = 1;
+      for(i = 0; i < n; i++)
+      {
+        if(cabsf(frame_samples[i]) > maximum_amplitude)
+        {
+          maximum_amplitude = cabsf(frame_samples[i]);
+        }
+      }
+      liquid_vectorcf_mulscalar(frame_samples,
+                                n,
+                                0.75 / maximum_amplitude,
+                                frame_samples);
+      msresamp_crcf_execute(resampler, frame_samples, n, samples, &n);
+      if((transfer->frequency_offset != 0) || (transfer->clock_error != 0) ||
+         transfer->hopping)
+      {
+        nco_crcf_mix_block_up(oscillator, samples, samples, n);
+      }
+      send_to_radio(transfer, samples, n, 0);
+    }
+    if(transfer->hopping)
+    {
+      /* Leave some silence on the channel of this frame before going to the
+       * channel of the next one, to flush the resampler and to give the
+       * receiver time to retune */
+      bzero(frame_samples, frame_samples_size * sizeof(complex float));
+      for(i = 0; i < transfer->hop_guard; i += m)
+      {
+        m = MIN(frame_samples_size, transfer->hop_guard - i);
+        msresamp_crcf_execute(resampler, frame_samples, m, samples, &n);
+        nco_crcf_mix_block_up(oscillator, samples, samples, n);
+        send_to_radio(transfer, samples, n, 0);
+      }
+      transfer->hop_counter++;
+    }
+  }
+}
+
+/* Resample the samples of the radio to the rate of the synchronizer and
+ * give them to the synchronizer. When the clock error is estimated during
+ * the transfer, a second resampler follows its variations by changing its
+ * rate without losing its state. */
+void synchronize_samples(dsss_transfer_t transfer,
+                         msresamp_crcf resampler,
+                         excision_t excision,
+                         dsss_framesync frame_synchronizer,
+                         complex float *samples,
+                         unsigned int samples_size,
+                         complex float *frame_samples)
+{
+  unsigned int n;
+
+  msresamp_crcf_execute(resampler, samples, samples_size, frame_samples, &n);
+  if(transfer->rx_clock_resampler)
+  {
+    resamp_crcf_execute_block(transfer->rx_clock_resampler,
+                              frame_samples,
+                              n,
+                              transfer->rx_clock_samples,
+                              &n);
+    frame_samples = transfer->rx_clock_samples;
+  }
+  if(excision)
+  {
+    excision_execute(excision, frame_samples, n);
+  }
+  dsss_framesync_execute(frame_synchronizer, frame_samples, n);
+}
+
+/* Process received samples by small blocks when using frequency hopping, so
+ * that the oscillator can be retuned to the channel of the next frame during
+ * the silence between the frames */
+void receive_hopping_samples(dsss_transfer_t transfer,
+                             nco_crcf oscillator,
+                             msresamp_crcf resampler,
+                             excision_t excision,
+                             dsss_framesync frame_synchronizer,
+                             complex float *samples,
+                             unsigned int samples_size,
+                             complex float *frame_samples,
+                             float sample_rate)
+{
+  unsigned int block = MAX(1, (HOPPING_GUARD_TIME / 4) * sample_rate);
+  unsigned int i;
+  unsigned int n;
+
+  for(i = 0; i < samples_size; i += n)
+  {
+    n = MIN(block, samples_size - i);
+    nco_crcf_mix_block_down(oscillator, &samples[i], &samples[i], n);
+    synchronize_samples(transfer,
+                        resampler,
+                        excision,
+                        frame_synchronizer,
+                        &samples[i],
+                        n,
+                        frame_samples);
+    transfer->hop_time += n / sample_rate;
+    if(hopping_update(transfer->hopping,
+                      transfer->hop_time,
+                      dsss_framesync_is_frame_open(frame_synchronizer)))
+    {
+      transfer->hop_retune = 1;
+    }
+    if(transfer->hop_retune)
+    {
+      transfer->hop_retune = 0;
+      transfer->hop_counter = hopping_get_expected(transfer->hopping);
+      nco_crcf_set_frequency(oscillator,
+                             TAU * ((get_signal_frequency(transfer) +
+                                     transfer->carrier_correction) /
+                                    sample_rate));
+    }
+  }
+}
+
+void send_frames(dsss_transfer_t transfer)
+{
+  double setup_start = get_time();
+  unsigned int samples_per_symbol = 2;
+  float samples_per_bit = transfer->spreading_factor * samples_per_symbol;
+  dsssframegenprops_s frame_properties;
+  dsssframegenprops_s header_properties;
+  dsss_framegen frame_generator;
+  float sample_rate = get_corrected_sample_rate(transfer);
+  float resampling_ratio = sample_rate / (transfer->bit_rate * samples_per_bit);
+  msresamp_crcf resampler = get_resampler(&transfer->tx_resampler,
+                                          &transfer->tx_resampling_ratio,
+                                          resampling_ratio);
+  unsigned int delay = ceilf(msresamp_crcf_get_delay(resampler));
+  unsigned int header_size = get_header_size(transfer);
+  unsigned char header_buffers[2][MAX_HEADER_SIZE];
+  unsigned char *header = header_buffers[0];
+  unsigned char *next_header = header_buffers[1];
+  /* Try to make frames of approximately 100 ms, but containing at least
+   * 16 bytes and at most 8000 bytes of payload */
+  unsigned int byte_rate = transfer->bit_rate / 8;
+  unsigned int payload_size = MIN(MAX(byte_rate * 0.1, 16), 8000);
+  int r;
+  unsigned int n;
+  /* Process data by blocks of 50 ms */
+  unsigned int frame_samples_size = ceilf((transfer->bit_rate *
+                                           samples_per_bit) / 20.0);
+  unsigned int samples_size = ceilf((frame_samples_size + delay) * resampling_ratio);
+  int continued;
+  int next_size;
+  unsigned int rate = 0;
+  unsigned int next_rate = 0;
+  unsigned char have_next = 0;
+  unsigned int block = 0;
+  float center_frequency = (get_signal_frequency(transfer) +
+                            get_clock_frequency_shift(transfer)) / sample_rate;
+  nco_crcf oscillator = nco_crcf_create(LIQUID_NCO);
+  unsigned int counter = 0;
+  unsigned long int frames_sent;
+  unsigned long int retransmissions;
+  unsigned long int frames_dropped;
+  float round_trip_time;
+  unsigned char *payload = malloc(payload_size);
+  unsigned char *next_payload = malloc(payload_size);
+  unsigned char *data;
+  unsigned char *next_data;
+  unsigned char *tmp;
+  complex float *frame_samples = malloc(frame_samples_size * sizeof(complex float));
+  complex float *samples = malloc(samples_size * sizeof(complex float));
+
+  if((payload == NULL) || (next_payload == NULL) ||
+     (frame_samples == NULL) || (samples == NULL))
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    exit(EXIT_FAILURE);
+  }
+
+  nco_crcf_set_phase(oscillator, 0);
+  nco_crcf_set_frequency(oscillator, TAU * center_frequency);
+  /* Silence between frames when using frequency hopping, longer than the
+   * delays of the resamplers */
+  transfer->hop_guard = ceilf(HOPPING_GUARD_TIME *
+                              transfer->bit_rate *
+                              samples_per_bit) + (2 * delay);
+
+  frame_properties.check = transfer->crc;
+  frame_properties.fec0 = transfer->inner_fec;
+  frame_properties.fec1 = transfer->outer_fec;
+  header_properties.check = transfer->header_crc;
+  header_properties.fec0 = transfer->header_inner_fec;
+  header_properties.fec1 = transfer->header_outer_fec;
+  if(transfer->tx_frame_generator)
+  {
+    /* Keep the frame generator of the previous transfers */
+    frame_generator = transfer->tx_frame_generator;
+    dsss_framegen_reset(frame_generator);
+  }
+  else
+  {
+    frame_generator = cache_get_frame_generator(transfer->spreading_factor);
+    transfer->tx_frame_generator = frame_generator;
+  }
+  /* The settings may have changed since the previous transfers (setters or
+   * dsss_transfer_reconfigure()), apply them also to a kept generator */
+  dsss_framegen_set_header_props(frame_generator, &header_properties);
+  dsss_framegen_set_header_len(frame_generator, header_size);
+  dsss_framegen_set_preamble_len(frame_generator, transfer->preamble_size);
+  dsss_framegen_setprops(frame_generator, &frame_properties);
+  /* The size of the payload depends on the bit rate, which can be changed
+   * by dsss_transfer_reconfigure() */
+  dsss_framegen_set_interleaving(frame_generator,
+                                 transfer->interleaving,
+                                 payload_size);
+  memcpy(header, transfer->id, 4);
+  memcpy(next_header, transfer->id, 4);
+  if(verbose)
+  {
+    fprintf(stderr,
+            _("Info: Setup time %.3f ms\n"),
+            (get_time() - setup_start) * 1000);
+  }
+
+  while((!stop) && (!transfer->stop))
+  {
+    if(have_next)
+    {
+      tmp = payload;
+      payload = next_payload;
+      next_payload = tmp;
+      tmp = header;
+      header = next_header;
+      next_header = tmp;
+      data = next_data;
+      r = next_size;
+      rate = next_rate;
+      have_next = 0;
+    }
+    else
+    {
+      r = get_frame_data(transfer, header, payload, payload_size, &counter, &data);
+      rate = get_frame_rate(transfer);
+    }
+    if(r < 0)
+    {
+      /* Send the last incomplete interleaver block */
+      dsss_framegen_flush(frame_generator);
+      send_assembled_frames(transfer,
+                            frame_generator,
+                            resampler,
+                            oscillator,
+                            frame_samples,
+                            frame_samples_size,
+                            samples);
+      break;
+    }
+    n = r;
+    if(n > 0)
+    {
+      /* In superframe mode, a frame can be followed immediately by the next
+       * one (without preamble) only if the data for the next frame is
+       * already available */
+      continued = 0;
+      block++;
+      if(block < transfer->superframe)
+      {
+        if(data != payload)
+        {
+          /* Getting the next frame can give the buffers of the application
+           * back to it */
+          memcpy(payload, data, n);
+          data = payload;
+        }
+        next_size = get_frame_data(transfer,
+                                   next_header,
+                                   next_payload,
+                                   payload_size,
+                                   &counter,
+                                   &next_data);
+        next_rate = get_frame_rate(transfer);
+        have_next = 1;
+        continued = (next_size > 0);
+      }
+      if(!continued)
+      {
+        block = 0;
+      }
+      dsss_framegen_set_continued(frame_generator, continued);
+      if(transfer->adaptive_rate)
+      {
+        set_frame_rate(frame_generator, &frame_properties, rate);
+      }
+      dsss_framegen_assemble(frame_generator, header, data, n);
+      send_assembled_frames(transfer,
+                            frame_generator,
+                            resampler,
+                            oscillator,
+                            frame_samples,
+                            frame_samples_size,
+                            samples);
+    }
+    else
+    {
+      /* Underrun when reading from stdin. Don't wait for the interleaver
+       * block to be full, and send some dummy samples to get the remaining
+       * output samples for the end of current frame (because of resampler and
+       * filter delays) and send them */
+      dsss_framegen_flush(frame_generator);
+      send_assembled_frames(transfer,
+                            frame_generator,
+                            resampler,
+                            oscillator,
+                            frame_samples,
+                            frame_samples_size,
+                            samples);
+      send_dummy_samples(transfer,
+                         resampler,
+                         oscillator,
+                         samples,
+                         delay,
+                         0);
+    }
+  }
+
+  /* Send some dummy samples to get the remaining output samples (because of
+   * resampler and filter delays) */
+  send_dummy_samples(transfer,
+                     resampler,
+                     oscillator,
+                     samples,
+                     delay,
+                     1);
+
+  if(transfer->arq && verbose)
+  {
+    arq_get_statistics(transfer->arq,
+                       &frames_sent,
+                       &retransmissions,
+                       &frames_dropped,
+                       &round_trip_time);
+    fprintf(stderr,
+            _("ARQ: %lu frames sent, %lu retransmissions, %lu frames dropped, round trip time %.3f s\n"),
+            frames_sent,
+            retransmissions,
+            frames_dropped,
+            round_trip_time);
+  }
+
+  free(samples);
+  free(frame_samples);
+  free(next_payload);
+  free(payload);
+  nco_crcf_destroy(oscillator);
+}
+
+/* Load the map of the data already received in the output file by previous
+ * transfers */
+void load_coverage(dsss_transfer_t transfer)
+{
+  if(coverage_load(transfer->coverage, transfer->map_file) == 0)
+  {
+    if(verbose)
+    {
+      fprintf(stderr,
+              _("Info: Resuming the transfer using '%s', %llu bytes missing\n"),
+              transfer->map_file,
+              coverage_get_missing_bytes(transfer->coverage));
+    }
+  }
+  else
+  {
+    coverage_clear(transfer->coverage);
+    coverage_set_size(transfer->coverage, 0);
+  }
+}
+
+/* Save the map of the data received, after making sure that the data it
+ * refers to is on the disk, so that an interrupted receiver can resume the
+ * transfer */
+void checkpoint_coverage(dsss_transfer_t transfer)
+{
+  fdatasync(fileno(transfer->file));
+  if(coverage_save(transfer->coverage, transfer->map_file) != 0)
+  {
+    fprintf(stderr, _("Error: Failed to write '%s'\n"), transfer->map_file);
+  }
+  transfer->checkpoint_time = time(NULL);
+}
+
+/* Report the data missing in the output file, and save the map of the data
+ * received for the next transfer (or remove it if the file is complete) */
+void save_coverage(dsss_transfer_t transfer)
+{
+  unsigned long long int offset = 0;
+  unsigned long long int missing_offset;
+  unsigned long long int missing_size;
+
+  if(transfer->stream_size_known && coverage_is_complete(transfer->coverage))
+  {
+    unlink(transfer->map_file);
+    return;
+  }
+  if(verbose)
+  {
+    while(coverage_get_missing(transfer->coverage,
+                               offset,
+                               &missing_offset,
+                               &missing_size) == 0)
+    {
+      if(offset == 0)
+      {
+        fprintf(stderr,
+                _("Info: The transfer can be resumed by sending from offset %llu\n"),
+                missing_offset);
+      }
+      fprintf(stderr,
+              _("Info: %llu bytes missing at offset %llu\n"),
+              missing_size,
+              missing_offset);
+      offset = missing_offset + missing_size;
+    }
+  }
+  checkpoint_coverage(transfer);
+}
+
+/* Set the size of the output file when the data is written at its position
+ * in the stream, and preallocate the space for the data */
+void set_output_size(dsss_transfer_t transfer, unsigned long long int size)
+{
+  int fd = fileno(transfer->file);
+  struct stat file_stat;
+
+  if((coverage_get_size(transfer->coverage) > 0) &&
+     (coverage_get_size(transfer->coverage) != size))
+  {
+    /* The map was made for another stream */
+    if(verbose)
+    {
+      fprintf(stderr,
+              _("Info: The stream size doesn't match '%s', ignoring it\n"),
+              transfer->map_file);
+    }
+    coverage_clear(transfer->coverage);
+  }
+  if(coverage_set_size(transfer->coverage, size) != 0)
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    transfer->stop = 1;
+    return;
+  }
+  if((fstat(fd, &file_stat) != 0) || !S_ISREG(file_stat.st_mode))
+  {
+    return;
+  }
+  if(file_stat.st_size < (off_t) size)
+  {
+    if((posix_fallocate(fd, 0, size) != 0) && (ftruncate(fd, size) != 0))
+    {
+      fprintf(stderr, _("Error: Failed to preallocate the output file\n"));
+    }
+  }
+  else if(file_stat.st_size > (off_t) size)
+  {
+    /* Remove what remains of a longer file */
+    if(ftruncate(fd, size) != 0)
+    {
+      fprintf(stderr, _("Error: Failed to truncate the output file\n"));
+    }
+  }
+}
+
+/* Write some data at its position in the output file, except the parts that
+ * have already been received */
+void write_data_at(dsss_transfer_t transfer,
+                   unsigned long long int offset,
+                   unsigned char *payload,
+                   unsigned int payload_size)
+{
+  int fd = fileno(transfer->file);
+  unsigned long long int done = 0;
+  unsigned long long int n;
+  ssize_t r;
+
+  while(done < payload_size)
+  {
+    done += coverage_get_run(transfer->coverage,
+                             offset + done,
+                             payload_size - done,
+                             1);
+    n = coverage_get_run(transfer->coverage,
+                         offset + done,
+                         payload_size - done,
+                         0);
+    while(n > 0)
+    {
+      r = pwrite(fd, payload + done, n, offset + done);
+      if(r <= 0)
+      {
+        fprintf(stderr, _("Error: Failed to write to the output file\n"));
+        transfer->stop = 1;
+        return;
+      }
+      done += r;
+      n -= r;
+    }
+  }
+  coverage_add(transfer->coverage, offset, payload_size);
+  if(time(NULL) >= transfer->checkpoint_time + CHECKPOINT_INTERVAL)
+  {
+    checkpoint_coverage(transfer);
+  }
+}
+
+/* Get the percentage of the stream received in the output file */
+float get_completion(dsss_transfer_t transfer)
+{
+  unsigned long long int size = coverage_get_size(transfer->coverage);
+
+  if(size == 0)
+  {
+    return(transfer->stream_size_known ? 100 : 0);
+  }
+  return((100.0 * (size - coverage_get_missing_bytes(transfer->coverage))) /
+         size);
+}
+
+/* Give the data of a frame using the extended header to the callback, at the
+ * right position in the output file if it is seekable */
+void extended_frame_received(dsss_transfer_t transfer,
+                             unsigned char *header,
+                             unsigned char *payload,
+                             unsigned int payload_size)
+{
+  unsigned char flags = header[9];
+  unsigned long long int offset = get_uint64(&header[10]);
+  unsigned long long int skip;
+  unsigned char carousel = transfer->coverage &&
+    (flags & EXTENDED_FLAG_CAROUSEL);
+
+  if(carousel && (offset < transfer->stream_offset))
+  {
+    /* Beginning of a new repetition of the stream, the data already
+     * received is skipped by write_data_at() */
+    transfer->stream_offset = offset;
+  }
+
+  if(flags & EXTENDED_FLAG_SIZE)
+  {
+    if(transfer->coverage && !transfer->stream_size_known)
+    {
+      set_output_size(transfer, get_uint64(&header[18]));
+    }
+    transfer->stream_size = get_uint64(&header[18]);
+    transfer->stream_size_known = 1;
+  }
+
+  if(!(flags & EXTENDED_FLAG_EMPTY) &&
+     (offset + payload_size > transfer->stream_offset))
+  {
+    if(offset > transfer->stream_offset)
+    {
+      if(verbose)
+      {
+        fprintf(stderr,
+                _("Info: %llu bytes missing at offset %llu\n"),
+                offset - transfer->stream_offset,
+                transfer->stream_offset);
+      }
+      transfer->bytes_missing += offset - transfer->stream_offset;
+      if(transfer->file && !transfer->coverage)
+      {
+        /* Leave a hole in the output file if possible to keep the data
+         * that follows at its position */
+        fflush(transfer->file);
+        fseeko(transfer->file, offset, SEEK_SET);
+      }
+      transfer->stream_offset = offset;
+    }
+    /* Don't give again data that has already been received */
+    skip = transfer->stream_offset - offset;
+    if(transfer->coverage)
+    {
+      write_data_at(transfer, offset + skip, payload + skip, payload_size - skip);
+    }
+    else
+    {
+      transfer->data_callback(transfer->callback_context,
+                              payload + skip,
+                              payload_size - skip);
+    }
+    transfer->stream_offset += payload_size - skip;
+  }
+
+  if(transfer->coverage && (flags & EXTENDED_FLAG_EOF) &&
+     !transfer->stream_size_known)
+  {
+    /* The size of the stream is known only at the end */
+    set_output_size(transfer,
+                    offset + ((flags & EXTENDED_FLAG_EMPTY) ? 0 : payload_size));
+    transfer->stream_size = coverage_get_size(transfer->coverage);
+    transfer->stream_size_known = 1;
+  }
+
+  if(carousel && (flags & EXTENDED_FLAG_EOF) && verbose)
+  {
+    fprintf(stderr,
+            _("Info: End of a repetition of the stream, %.1f%% received\n"),
+            get_completion(transfer));
+  }
+
+  if((!carousel &&
+      ((flags & EXTENDED_FLAG_EOF) ||
+       (transfer->stream_size_known &&
+        (transfer->stream_offset >= transfer->stream_size)))) ||
+     (transfer->coverage && transfer->stream_size_known &&
+      coverage_is_complete(transfer->coverage)))
+  {
+    /* All the data has been sent, no need to wait for the timeout */
+    transfer->stream_end = 1;
+    transfer->stop = 1;
+  }
+}
+
+/* Signal an event to the application polling the event pipe */
+void notify(dsss_transfer_t transfer, unsigned int event)
+{
+  unsigned char byte = 0;
+
+  /* A byte is written only for the first occurrence of an event since the
+   * last call to dsss_transfer_get_events(), so the pipe never fills up */
+  if(transfer->event_fds_open &&
+     !(atomic_fetch_or(&transfer->events, event) & event))
+  {
+    if(write(transfer->event_fds[1], &byte, 1) != 1)
+    {
+      fprintf(stderr, _("Error: Failed to signal an event\n"));
+    }
+  }
+}
+
+/* Give the data of a valid frame to the layer using it */
+void process_frame(dsss_transfer_t transfer,
+                   unsigned char *header,
+                   unsigned char *payload,
+                   unsigned int payload_size)
+{
+  if(transfer->arq)
+  {
+    arq_frame_received(transfer->arq,
+                       header,
+                       payload,
+                       payload_size,
+                       transfer->data_callback,
+                       transfer->callback_context);
+  }
+  else if(transfer->extended_header)
+  {
+    if(check_extended_header(header))
+    {
+      extended_frame_received(transfer, header, payload, payload_size);
+    }
+    else if(verbose)
+    {
+      fprintf(stderr,
+              _("Frame %u for '%s': invalid extended header\n"),
+              get_counter(header),
+              transfer->id);
+      fflush(stderr);
+    }
+  }
+  else if(transfer->erasure)
+  {
+    erasure_frame_received(transfer->erasure,
+                           header,
+                           payload,
+                           payload_size,
+                           transfer->data_callback,
+                           transfer->callback_context);
+  }
+  else
+  {
+    transfer->data_callback(transfer->callback_context, payload, payload_size);
+  }
+  notify(transfer, DSSS_TRANSFER_EVENT_DATA);
+}
+
+/* Callback of the selection combiner of a diversity reception */
+void diversity_frame_selected(void *context,
+                              unsigned char *header,
+                              unsigned char *payload,
+                              unsigned int payload_size)
+{
+  dsss_transfer_t transfer = (dsss_transfer_t) context;
+
+  transfer->timeout_start = time(NULL);
+  process_frame(transfer, header, payload, payload_size);
+}
+
+int frame_received(unsigned char *header,
+                   int header_valid,
+                   unsigned char *payload,
+                   unsigned int payload_size,
+                   int payload_valid,
+                   framesyncstats_s stats,
+                   void *user_data)
+{
+  dsss_transfer_t transfer = (dsss_transfer_t) user_data;
+  diversity_t diversity = transfer->diversity_main ?
+    transfer->diversity_main->diversity :
+    transfer->diversity;
+  char id[5];
+  unsigned int counter;
+
+  transfer->timeout_start = time(NULL);
+  memcpy(id, header, 4);
+  id[4] = '\0';
+  counter = get_counter(header);
+
+  if(transfer->hopping && header_valid && (memcmp(id, transfer->id, 4) == 0))
+  {
+    /* Follow the pattern from the channel of this frame */
+    hopping_frame_received(transfer->hopping, counter, transfer->hop_time);
+    transfer->hop_retune = 1;
+  }
+
+  if(!header_valid || !payload_valid)
+  {
+    if(verbose)
+    {
+      if(!header_valid)
+      {
+        fprintf(stderr, _("Frame %u for '%s': corrupted header\n"), counter, id);
+      }
+      if(!payload_valid)
+      {
+        fprintf(stderr, _("Frame %u for '%s': corrupted payload\n"), counter, id);
+      }
+      fflush(stderr);
+    }
+  }
+  else if(memcmp(id, transfer->id, 4) != 0)
+  {
+    if(verbose)
+    {
+      fprintf(stderr, _("Frame %u for '%s': ignored\n"), counter, id);
+      fflush(stderr);
+    }
+  }
+  else
+  {
+    if(transfer->frames_received == 0)
+    {
+      transfer->first_counter = counter;
+    }
+    transfer->last_counter = counter;
+    transfer->frames_received++;
+    if(transfer->auto_ppm)
+    {
+      update_clock_error(transfer, stats.cfo);
+    }
+    if(diversity)
+    {
+      /* Keep only the first copy of the frame decoded by the radios */
+      diversity_frame_received(diversity,
+                               counter,
+                               header,
+                               get_header_size(transfer),
+                               payload,
+                               payload_size);
+    }
+    else
+    {
+      process_frame(transfer, header, payload, payload_size);
+    }
+  }
+  return(0);
+}
+
+/* Report the data received by the layers above the frames */
+void finish_stream(dsss_transfer_t transfer)
+{
+  unsigned long int blocks_decoded;
+  unsigned long int blocks_lost;
+  unsigned long int messages_received;
+  unsigned long int messages_dropped;
+
+  if(transfer->coverage && verbose)
+  {
+    fprintf(stderr,
+            _("Stream: %.1f%% of the data received in the output file\n"),
+            get_completion(transfer));
+  }
+  else if(transfer->extended_header && verbose)
+  {
+    fprintf(stderr,
+            _("Stream: %llu bytes received, %llu bytes missing%s\n"),
+            transfer->stream_offset - transfer->bytes_missing,
+            transfer->bytes_missing,
+            transfer->stream_end ? "" : _(", end not received"));
+  }
+  if(transfer->coverage)
+  {
+    save_coverage(transfer);
+  }
+  if(transfer->datagram && verbose)
+  {
+    datagram_get_statistics(transfer->datagram,
+                            &messages_received,
+                            &messages_dropped);
+    fprintf(stderr,
+            _("Messages: %lu messages received, %lu messages dropped\n"),
+            messages_received,
+            messages_dropped);
+  }
+  if(transfer->erasure && verbose)
+  {
+    erasure_get_statistics(transfer->erasure, &blocks_decoded, &blocks_lost);
+    fprintf(stderr,
+            _("Erasure coding: %lu blocks decoded, %lu blocks lost\n"),
+            blocks_decoded,
+            blocks_lost);
+  }
+}
+
+void receive_frames(dsss_transfer_t transfer)
+{
+  double setup_start = get_time();
+  unsigned int samples_per_symbol = 2;
+  float samples_per_bit = transfer->spreading_factor * samples_per_symbol;
+  dsssframegenprops_s header_properties;
+  dsss_framesync frame_synchronizer;
+  float sample_rate = get_corrected_sample_rate(transfer);
+  float resampling_ratio = (transfer->bit_rate * samples_per_bit) / sample_rate;
+  float resampler_clock_error = transfer->clock_error;
+  msresamp_crcf resampler = get_resampler(&transfer->rx_resampler,
+                                          &transfer->rx_resampling_ratio,
+                                          resampling_ratio);
+  unsigned int delay = ceilf(msresamp_crcf_get_delay(resampler) +
+                             (transfer->auto_ppm ?
+                              CLOCK_RESAMPLER_DELAY / resampling_ratio :
+                              0));
+  unsigned int header_size = get_header_size(transfer);
+  unsigned int n;
+  unsigned int i;
+  /* Process data by blocks of 50 ms */
+  unsigned int frame_samples_size = ceilf((transfer->bit_rate *
+                                           samples_per_bit) / 20.0);
+  unsigned int samples_size = floorf(frame_samples_size / resampling_ratio);
+  nco_crcf oscillator = nco_crcf_create(LIQUID_NCO);
+  acquisition_t acquisition = NULL;
+  wdelaycf acquisition_delay = NULL;
+  excision_t excision = NULL;
+  unsigned int acquisition_delay_size = 0;
+  float carrier_offset;
+  unsigned long int samples_received = 0;
+  unsigned int frames_expected;
+  framedatastats_s frame_statistics;
+  unsigned char combining_mask[MAX_HEADER_SIZE];
+  complex float *frame_samples = malloc((frame_samples_size + delay) *
+                                        sizeof(complex float));
+  complex float *samples = malloc((samples_size + delay) *
+                                  sizeof(complex float));
+
+  if((frame_samples == NULL) || (samples == NULL))
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    exit(EXIT_FAILURE);
+  }
+
+  if(transfer->auto_ppm)
+  {
+    /* The main resampler keeps the clock error known at the start of the
+     * transfer, the rate of this one only compensates for the changes of
+     * the estimate, and stays close to 1 */
+    transfer->rx_clock_resampler = resamp_crcf_create(1,
+                                                      CLOCK_RESAMPLER_DELAY,
+                                                      0.45,
+                                                      60,
+                                                      64);
+    transfer->rx_clock_samples = malloc(2 * (frame_samples_size + delay) *
+                                        sizeof(complex float));
+    if((transfer->rx_clock_resampler == NULL) ||
+       (transfer->rx_clock_samples == NULL))
+    {
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  transfer->carrier_correction = get_clock_frequency_shift(transfer);
+  transfer->clock_update = 0;
+  nco_crcf_set_phase(oscillator, 0);
+  nco_crcf_set_frequency(oscillator,
+                         TAU * ((get_signal_frequency(transfer) +
+                                 transfer->carrier_correction) / sample_rate));
+
+  if(transfer->acquisition_range > 0)
+  {
+    acquisition = acquisition_create(transfer->sample_rate,
+                                     transfer->bit_rate * transfer->spreading_factor,
+                                     transfer->frequency_offset,
+                                     transfer->acquisition_range,
+                                     transfer->preamble_size);
+    if(acquisition == NULL)
+    {
+      fprintf(stderr, _("Error: Failed to initialize acquisition stage\n"));
+      exit(EXIT_FAILURE);
+    }
+    /* Delay the samples going to the synchronizer to be able to correct the
+     * carrier frequency offset before the beginning of a detected preamble
+     * reaches the synchronizer */
+    acquisition_delay_size = samples_size + acquisition_get_delay(acquisition);
+    acquisition_delay = wdelaycf_create(acquisition_delay_size);
+  }
+
+  if(transfer->excision)
+  {
+    excision = excision_create(samples_per_symbol);
+    if(excision == NULL)
+    {
+      fprintf(stderr, _("Error: Failed to initialize excision stage\n"));
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if(transfer->rx_frame_synchronizer)
+  {
+    /* Keep the frame synchronizer of the previous transfers */
+    frame_synchronizer = transfer->rx_frame_synchronizer;
+    dsss_framesync_reset(frame_synchronizer);
+    dsss_framesync_reset_framedatastats(frame_synchronizer);
+  }
+  else
+  {
+    frame_synchronizer = cache_get_frame_synchronizer(transfer->spreading_factor,
+                                                      transfer->preamble_size,
+                                                      frame_received,
+                                                      transfer);
+    transfer->rx_frame_synchronizer = frame_synchronizer;
+  }
+  /* The settings may have changed since the previous transfers (setters or
+   * dsss_transfer_reconfigure()), apply them also to a kept synchronizer */
+  header_properties.check = transfer->header_crc;
+  header_properties.fec0 = transfer->header_inner_fec;
+  header_properties.fec1 = transfer->header_outer_fec;
+  dsss_framesync_set_header_props(frame_synchronizer, &header_properties);
+  dsss_framesync_set_header_len(frame_synchronizer, header_size);
+  dsss_framesync_set_preamble_len(frame_synchronizer, transfer->preamble_size);
+  dsss_framesync_set_tracking(frame_synchronizer, transfer->tracking);
+  if(transfer->combining > 0)
+  {
+    /* The copies of a frame have the same id, and the same counter (or the
+     * same offset in the stream when using the extended header) */
+    bzero(combining_mask, sizeof(combining_mask));
+    memset(combining_mask, 0xff, 4);
+    if((transfer->diversity_main ?
+        transfer->diversity_main :
+        transfer)->extended_header)
+    {
+      memset(&combining_mask[10], 0xff, 8);
+    }
+    else
+    {
+      memset(&combining_mask[4], 0xff, 4);
+    }
+    if(dsss_framesync_set_combining(frame_synchronizer,
+                                    transfer->combining,
+                                    combining_mask) != 0)
+    {
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      exit(EXIT_FAILURE);
+    }
+  }
+  else
+  {
+    dsss_framesync_set_combining(frame_synchronizer, 0, NULL);
+  }
+  dsss_framesync_set_threshold(frame_synchronizer, transfer->detector_threshold);
+  if(verbose)
+  {
+    fprintf(stderr,
+            _("Info: Setup time %.3f ms\n"),
+            (get_time() - setup_start) * 1000);
+  }
+
+  while((!stop) && (!transfer->stop))
+  {
+    n = receive_from_radio(transfer, samples, samples_size);
+    if((n == 0) && (transfer->radio_type != SOAPYSDR))
+    {
+      break;
+    }
+    if((transfer->timeout > 0) &&
+       (time(NULL) > transfer->timeout_start + transfer->timeout))
+    {
+      if(verbose)
+      {
+        fprintf(stderr, _("Timeout: %d s without frames\n"), transfer->timeout);
+      }
+      break;
+    }
+    if(transfer->dump)
+    {
+      dump_samples(transfer, samples, n);
+    }
+    samples_received += n;
+    if(acquisition)
+    {
+      /* When the synchronizer is tracking frames, it already has a better
+       * estimate of the carrier frequency offset than the acquisition stage */
+      if(acquisition_execute(acquisition, samples, n, &carrier_offset) &&
+         !(transfer->tracking &&
+           dsss_framesync_is_frame_open(frame_synchronizer)))
+      {
+        transfer->carrier_correction = carrier_offset;
+        nco_crcf_set_frequency(oscillator,
+                               TAU * ((transfer->frequency_offset + carrier_offset) /
+                                      sample_rate));
+        if(verbose)
+        {
+          fprintf(stderr,
+                  _("Preamble detected with a carrier frequency offset of %.0f Hz\n"),
+                  carrier_offset);
+        }
+      }
+      for(i = 0; i < n; i++)
+      {
+        wdelaycf_push(acquisition_delay, samples[i]);
+        wdelaycf_read(acquisition_delay, &samples[i]);
+      }
+    }
+    if(transfer->hopping)
+    {
+      receive_hopping_samples(transfer,
+                              oscillator,
+                              resampler,
+                              excision,
+                              frame_synchronizer,
+                              samples,
+                              n,
+                              frame_samples,
+                              sample_rate);
+    }
+    else
+    {
+      if((transfer->frequency_offset != 0) || acquisition || transfer->auto_ppm)
+      {
+        nco_crcf_mix_block_down(oscillator, samples, samples, n);
+      }
+      synchronize_samples(transfer,
+                          resampler,
+                          excision,
+                          frame_synchronizer,
+                          samples,
+                          n,
+                          frame_samples);
+    }
+
+    flush_batch(transfer);
+
+    if(transfer->clock_update)
+    {
+      /* A frame has just ended (when tracking frames, the next one may
+       * already be open), apply the new estimate of the clock error */
+      transfer->clock_update = 0;
+      sample_rate = get_corrected_sample_rate(transfer);
+      transfer->carrier_correction = get_clock_frequency_shift(transfer);
+      nco_crcf_set_frequency(oscillator,
+                             TAU * ((get_signal_frequency(transfer) +
+                                     transfer->carrier_correction) / sample_rate));
+      resamp_crcf_set_rate(transfer->rx_clock_resampler,
+                           (1 + (resampler_clock_error / 1000000.0)) /
+                           (1 + (transfer->clock_error / 1000000.0)));
+    }
+  }
+
+  if(acquisition)
+  {
+    /* Get the samples remaining in the delay line */
+    while(acquisition_delay_size > 0)
+    {
+      n = MIN(acquisition_delay_size, samples_size);
+      for(i = 0; i < n; i++)
+      {
+        wdelaycf_push(acquisition_delay, 0);
+        wdelaycf_read(acquisition_delay, &samples[i]);
+      }
+      acquisition_delay_size -= n;
+      nco_crcf_mix_block_down(oscillator, samples, samples, n);
+      synchronize_samples(transfer,
+                          resampler,
+                          excision,
+                          frame_synchronizer,
+                          samples,
+                          n,
+                          frame_samples);
+    }
+  }
+
+  for(n = 0; n < delay; n++)
+  {
+    samples[n] = 0;
+  }
+  synchronize_samples(transfer,
+                      resampler,
+                      excision,
+                      frame_synchronizer,
+                      samples,
+                      delay,
+                      frame_samples);
+  while(dsss_framesync_is_frame_open(frame_synchronizer))
+  {
+    dsss_framesync_execute(frame_synchronizer, samples, 1);
+  }
+  dsss_framesync_flush(frame_synchronizer);
+  flush_batch(transfer);
+
+  if(transfer->auto_ppm && (transfer->clock_estimates > 0))
+  {
+    save_clock_error(transfer);
+  }
+  /* Detections without a valid header are false alarms (or frames too
+   * corrupted to be used), and the frames missed are found using the
+   * counters of the frames received */
+  frame_statistics = dsss_framesync_get_framedatastats(frame_synchronizer);
+  transfer->false_alarms = frame_statistics.num_frames_detected -
+    frame_statistics.num_headers_valid;
+  frames_expected = ((transfer->frames_received > 0) &&
+                     (transfer->last_counter >= transfer->first_counter)) ?
+    transfer->last_counter - transfer->first_counter + 1 :
+    transfer->frames_received;
+  transfer->frames_missed = (frames_expected > transfer->frames_received) ?
+    frames_expected - transfer->frames_received :
+    0;
+  if(verbose)
+  {
+    fprintf(stderr,
+            _("Detector: %u preambles detected, %u false alarms, %u frames missed\n"),
+            frame_statistics.num_frames_detected,
+            transfer->false_alarms,
+            transfer->frames_missed);
+  }
+  if(transfer->branches_count == 0)
+  {
+    /* With diversity reception, the other radios may still be giving
+     * frames */
+    finish_stream(transfer);
+  }
+  if(transfer->tracking && verbose)
+  {
+    fprintf(stderr,
+            _("Tracking: %u frames found by tracking, %u tracking losses\n"),
+            dsss_framesync_get_frames_tracked(frame_synchronizer),
+            dsss_framesync_get_tracking_losses(frame_synchronizer));
+  }
+  if((transfer->combining > 0) && verbose)
+  {
+    fprintf(stderr,
+            _("Combining: %u frames decoded by combining several copies\n"),
+            dsss_framesync_get_frames_combined(frame_synchronizer));
+  }
+  if(acquisition)
+  {
+    if(verbose)
+    {
+      /* Compare the number of frames received with the number of frames
+       * sent (according to their counters) and the processing time with
+       * the duration of the received signal */
+      fprintf(stderr,
+              _("Acquisition: %lu preambles detected, %u/%u frames received, %.3f s of processing time for %.3f s of signal\n"),
+              acquisition_get_detections(acquisition),
+              transfer->frames_received,
+              frames_expected,
+              acquisition_get_cpu_time(acquisition),
+              (double) samples_received / sample_rate);
+    }
+    wdelaycf_destroy(acquisition_delay);
+    acquisition_free(acquisition);
+  }
+  if(excision)
+  {
+    if(verbose)
+    {
+      fprintf(stderr,
+              _("Excision: %.1f dB of interference removed, %.3f s of processing time for %.3f s of signal\n"),
+              excision_get_suppression(excision),
+              excision_get_cpu_time(excision),
+              (double) samples_received / sample_rate);
+    }
+    excision_free(excision);
+  }
+  if(transfer->rx_clock_resampler)
+  {
+    resamp_crcf_destroy(transfer->rx_clock_resampler);
+    transfer->rx_clock_resampler = NULL;
+    free(transfer->rx_clock_samples);
+    transfer->rx_clock_samples = NULL;
+  }
+  free(samples);
+  free(frame_samples);
+  nco_crcf_destroy(oscillator);
+}
+
+/* Reset the flags of a transfer before starting it */
+void reset_flags(dsss_transfer_t transfer)
+{
+  stop = 0;
+  transfer->stop = 0;
+  if(transfer->radio_type == EXTERNAL)
+  {
+    pthread_mutex_lock(&transfer->external_lock);
+    transfer->external_end = 0;
+    transfer->external_finished = 0;
+    pthread_mutex_unlock(&transfer->external_lock);
+  }
+}
+
+void run_transfer(dsss_transfer_t transfer);
+
+/* Thread receiving the frames with one of the other radios of a diversity
+ * reception */
+void * receive_branch(void *arg)
+{
+  run_transfer((dsss_transfer_t) arg);
+  return(NULL);
+}
+
+/* Receive the frames with all the radios of a diversity reception at the
+ * same time */
+void receive_diversity(dsss_transfer_t transfer)
+{
+  pthread_t threads[DIVERSITY_MAX_BRANCHES];
+  dsss_transfer_t branch;
+  unsigned long int frames_selected;
+  unsigned long int duplicates;
+  unsigned long int frames_lost;
+  unsigned int i;
+
+  diversity_reset(transfer->diversity);
+  for(i = 0; i < transfer->branches_count; i++)
+  {
+    reset_flags(transfer->branches[i]);
+    if(pthread_create(&threads[i],
+                      NULL,
+                      receive_branch,
+                      transfer->branches[i]) != 0)
+    {
+      fprintf(stderr, _("Error: Failed to start a reception thread\n"));
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  receive_frames(transfer);
+
+  for(i = 0; i < transfer->branches_count; i++)
+  {
+    branch = transfer->branches[i];
+    /* Pseudo-radios stop by themselves at the end of their samples, unless
+     * the main transfer has been stopped */
+    if(stop || transfer->stop ||
+       ((branch->radio_type != IO) && (branch->radio_type != FILENAME)))
+    {
+      branch->stop = 1;
+    }
+    pthread_join(threads[i], NULL);
+  }
+  diversity_flush(transfer->diversity);
+  finish_stream(transfer);
+
+  if(verbose)
+  {
+    diversity_get_statistics(transfer->diversity,
+                             &frames_selected,
+                             &duplicates,
+                             &frames_lost);
+    fprintf(stderr,
+            _("Diversity: %lu frames selected, %lu copies dropped, %lu frames lost\n"),
+            frames_selected,
+            duplicates,
+            frames_lost);
+    fprintf(stderr,
+            _("Diversity: radio 0 received %u frames\n"),
+            transfer->frames_received);
+    for(i = 0; i < transfer->branches_count; i++)
+    {
+      fprintf(stderr,
+              _("Diversity: radio %u received %u frames\n"),
+              i + 1,
+              transfer->branches[i]->frames_received);
+    }
+  }
+}
+
+dsss_transfer_t dsss_transfer_create_callback(char *radio_driver,
+                                              unsigned char emit,
+                                              int (*data_callback)(void *,
+                                                                   unsigned char *,
+                                                                   unsigned int),
+                                              void *callback_context,
+                                              unsigned long int sample_rate,
+                                              unsigned int bit_rate,
+                                              unsigned long int frequency,
+                                              long int frequency_offset,
+                                              char *gain,
+                                              float ppm,
+                                              unsigned int spreading_factor,
+                                              char *inner_fec,
+                                              char *outer_fec,
+                                              char *id,
+                                              char *dump,
+                                              unsigned int timeout,
+                                              unsigned char audio)
+{
+  int direction;
+  int gain_value;
+  dsss_transfer_t transfer = malloc(sizeof(struct dsss_transfer_s));
+
+  if(transfer == NULL)
+  {
+    fprintf(stderr, _("Error: Memory allocation failed\n"));
+    return(NULL);
+  }
+  bzero(transfer, sizeof(struct dsss_transfer_s));
+
+  if(strcasecmp(radio_driver, "io") == 0)
+  {
+    transfer->radio_type = IO;
+  }
+  else if(strncasecmp(radio_driver, "file=", 5) == 0)
+  {
+    transfer->radio_type = FILENAME;
+  }
+  else if(strcasecmp(radio_driver, "external") == 0)
+  {
+    transfer->radio_type = EXTERNAL;
+  }
+  else
+  {
+    transfer->radio_type = SOAPYSDR;
+  }
+
+  transfer->stop = 0;
+  transfer->emit = emit;
+  transfer->file = NULL;
+  transfer->data_callback = data_callback;
+  transfer->callback_context = callback_context;
+
+  transfer->ppm = ppm;
+  transfer->superframe = 1;
+  transfer->passes = 1;
+  transfer->interleaving = 1;
+  transfer->preamble_size = 64;
+  transfer->detector_threshold = 0.5;
+  if(sample_rate != 0)
+  {
+    transfer->sample_rate = sample_rate * ((1000000.0 - ppm) / 1000000.0);
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Invalid sample rate\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  if(frequency != 0)
+  {
+    transfer->frequency = frequency * ((1000000.0 - ppm) / 1000000.0);
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Invalid frequency\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  transfer->frequency_offset = frequency_offset;
+
+  if(audio)
+  {
+    if((transfer->radio_type == IO) || (transfer->radio_type == FILENAME))
+    {
+      transfer->audio_converter = firhilbf_create(25, 60);
+      /* The rate of audio samples is twice the rate of IQ samples */
+      transfer->sample_rate = transfer->sample_rate / 2;
+      /* -(sample_rate / 2) Hz IQ <=> 0 Hz audio
+       * (sample_rate / 2) Hz IQ <=> (sample_rate * 2) Hz audio */
+      transfer->frequency_offset = transfer->frequency - (transfer->sample_rate / 2);
+      transfer->frequency = 0;
+      gain_value = strtol(gain, NULL, 10);
+      transfer->audio_gain = powf(10, gain_value / 20.0);
+    }
+    else
+    {
+      fprintf(stderr, _("Error: This radio type only supports IQ samples\n"));
+      free(transfer);
+      return(NULL);
+    }
+  }
+  else
+  {
+    transfer->audio_converter = NULL;
+    transfer->audio_gain = 0;
+  }
+
+  if(bit_rate != 0)
+  {
+    transfer->bit_rate = bit_rate;
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Invalid bit rate\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  if(spreading_factor >= 2)
+  {
+    transfer->spreading_factor = spreading_factor;
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Invalid spreading factor\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  transfer->crc = LIQUID_CRC_32;
+
+  transfer->inner_fec = liquid_getopt_str2fec(inner_fec);
+  if(transfer->inner_fec == LIQUID_FEC_UNKNOWN)
+  {
+    fprintf(stderr, _("Error: Invalid inner FEC\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  transfer->outer_fec = liquid_getopt_str2fec(outer_fec);
+  if(transfer->outer_fec == LIQUID_FEC_UNKNOWN)
+  {
+    fprintf(stderr, _("Error: Invalid outer FEC\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  /* Unless other codes are chosen, the headers are protected like the
+   * payloads, as in the original frame format */
+  transfer->header_crc = transfer->crc;
+  transfer->header_inner_fec = transfer->inner_fec;
+  transfer->header_outer_fec = transfer->outer_fec;
+
+  if(strlen(id) <= 4)
+  {
+    strcpy(transfer->id, id);
+  }
+  else
+  {
+    fprintf(stderr, _("Error: Id must be at most 4 bytes long\n"));
+    free(transfer);
+    return(NULL);
+  }
+
+  if(dump)
+  {
+    transfer->dump = fopen(dump, "wb");
     if(transfer->dump == NULL)
     {
-      fprintf(stderr, _("Error: Failed to open '%s'\n"), dump);
-      free(transfer);
-      return(NULL);
+      fprintf(stderr, _("Error: Failed to open '%s'\n"), dump);
+      free(transfer);
+      return(NULL);
+    }
+  }
+  else
+  {
+    transfer->dump = NULL;
+  }
+
+  transfer->timeout = timeout;
+
+  switch(transfer->radio_type)
+  {
+  case IO:
+    break;
+
+  case FILENAME:
+    if(emit)
+    {
+      transfer->radio_device.file = fopen(radio_driver + 5, "wb");
+    }
+    else
+    {
+      transfer->radio_device.file = fopen(radio_driver + 5, "rb");
+    }
+    if(transfer->radio_device.file == NULL)
+    {
+      fprintf(stderr, _("Error: Failed to open '%s'\n"), radio_driver + 5);
+      free(transfer);
+      return(NULL);
+    }
+    transfer->radio_file = strdup(radio_driver + 5);
+    break;
+
+  case SOAPYSDR:
+    transfer->radio_device.soapysdr = SoapySDRDevice_makeStrArgs(radio_driver);
+    if(transfer->radio_device.soapysdr == NULL)
+    {
+      fprintf(stderr, _("Error: %s\n"), SoapySDRDevice_lastError());
+      free(transfer);
+      return(NULL);
+    }
+    set_radio_serial(transfer, radio_driver);
+    direction = emit ? SOAPY_SDR_TX : SOAPY_SDR_RX;
+    transfer->radio_stream.soapysdr = setup_radio_stream(transfer,
+                                                         direction,
+                                                         gain);
+    if(transfer->radio_stream.soapysdr == NULL)
+    {
+      SoapySDRDevice_unmake(transfer->radio_device.soapysdr);
+      free(transfer);
+      return(NULL);
+    }
+    transfer->radio_gain = strdup(gain);
+    break;
+
+  case EXTERNAL:
+    pthread_mutex_init(&transfer->external_lock, NULL);
+    pthread_cond_init(&transfer->external_cond, NULL);
+    break;
+
+  default:
+    fprintf(stderr, _("Error: Unknown radio type\n"));
+    free(transfer);
+    return(NULL);
+    break;
+  }
+
+  return(transfer);
+}
+
+dsss_transfer_t dsss_transfer_create(char *radio_driver,
+                                     unsigned char emit,
+                                     char *file,
+                                     unsigned long int sample_rate,
+                                     unsigned int bit_rate,
+                                     unsigned long int frequency,
+                                     long int frequency_offset,
+                                     char *gain,
+                                     float ppm,
+                                     unsigned int spreading_factor,
+                                     char *inner_fec,
+                                     char *outer_fec,
+                                     char *id,
+                                     char *dump,
+                                     unsigned int timeout,
+                                     unsigned char audio)
+{
+  int flags;
+  int fd;
+  dsss_transfer_t transfer;
+
+  transfer = dsss_transfer_create_callback(radio_driver,
+                                           emit,
+                                           emit ? read_data : write_data,
+                                           NULL,
+                                           sample_rate,
+                                           bit_rate,
+                                           frequency,
+                                           frequency_offset,
+                                           gain,
+                                           ppm,
+                                           spreading_factor,
+                                           inner_fec,
+                                           outer_fec,
+                                           id,
+                                           dump,
+                                           timeout,
+                                           audio);
+  if(transfer == NULL)
+  {
+    return(NULL);
+  }
+
+  transfer->callback_context = transfer;
+  if(file)
+  {
+    if(emit)
+    {
+      transfer->file = fopen(file, "rb");
+    }
+    else
+    {
+      /* The file is truncated when the transfer starts, unless the data is
+       * written at its position in the stream */
+      fd = open(file, O_WRONLY | O_CREAT, 0666);
+      transfer->file = (fd < 0) ? NULL : fdopen(fd, "wb");
+      transfer->truncate_file = 1;
+      transfer->map_file = malloc(strlen(file) + 5);
+      if(transfer->map_file)
+      {
+        sprintf(transfer->map_file, "%s.map", file);
+      }
+    }
+    if(transfer->file == NULL)
+    {
+      fprintf(stderr, _("Error: Failed to open '%s'\n"), file);
+      free(transfer->map_file);
+      free(transfer);
+      return(NULL);
+    }
+  }
+  else
+  {
+    if(emit)
+    {
+      transfer->file = stdin;
+      flags = fcntl(STDIN_FILENO, F_GETFL);
+      fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
+    }
+    else
+    {
+      transfer->file = stdout;
+    }
+  }
+
+  return(transfer);
+}
+
+/* Give the signal processing objects kept between runs to the cache, so that
+ * the next transfers can use them */
+void free_dsp(dsss_transfer_t transfer)
+{
+  cache_release_resampler(transfer->tx_resampler,
+                          transfer->tx_resampling_ratio);
+  transfer->tx_resampler = NULL;
+  cache_release_frame_generator(transfer->tx_frame_generator,
+                                transfer->spreading_factor);
+  transfer->tx_frame_generator = NULL;
+  cache_release_resampler(transfer->rx_resampler,
+                          transfer->rx_resampling_ratio);
+  transfer->rx_resampler = NULL;
+  cache_release_frame_synchronizer(transfer->rx_frame_synchronizer,
+                                   transfer->spreading_factor,
+                                   transfer->preamble_size);
+  transfer->rx_frame_synchronizer = NULL;
+}
+
+void dsss_transfer_free(dsss_transfer_t transfer)
+{
+  if(transfer)
+  {
+    if(transfer->thread_started)
+    {
+      transfer->stop = 1;
+      dsss_transfer_wait(transfer);
+    }
+    if(transfer->event_fds_open)
+    {
+      close(transfer->event_fds[0]);
+      close(transfer->event_fds[1]);
+    }
+    if(transfer->file)
+    {
+      fclose(transfer->file);
+    }
+    if(transfer->dump)
+    {
+      fclose(transfer->dump);
+    }
+    if(transfer->audio_converter)
+    {
+      firhilbf_destroy(transfer->audio_converter);
+    }
+    arq_free(transfer->arq);
+    erasure_free(transfer->erasure);
+    coverage_free(transfer->coverage);
+    free(transfer->map_file);
+    datagram_free(transfer->datagram);
+    free(transfer->batch_data);
+    hopping_free(transfer->hopping);
+    diversity_free(transfer->diversity);
+    free_dsp(transfer);
+    switch(transfer->radio_type)
+    {
+    case IO:
+      break;
+
+    case FILENAME:
+      fclose(transfer->radio_device.file);
+      free(transfer->radio_file);
+      break;
+
+    case SOAPYSDR:
+      SoapySDRDevice_deactivateStream(transfer->radio_device.soapysdr,
+                                      transfer->radio_stream.soapysdr,
+                                      0,
+                                      0);
+      SoapySDRDevice_closeStream(transfer->radio_device.soapysdr,
+                                 transfer->radio_stream.soapysdr);
+      if(transfer->other_stream.soapysdr)
+      {
+        SoapySDRDevice_closeStream(transfer->radio_device.soapysdr,
+                                   transfer->other_stream.soapysdr);
+      }
+      free(transfer->radio_gain);
+      SoapySDRDevice_unmake(transfer->radio_device.soapysdr);
+      break;
+
+    case EXTERNAL:
+      pthread_cond_destroy(&transfer->external_cond);
+      pthread_mutex_destroy(&transfer->external_lock);
+      break;
+
+    default:
+      break;
+    }
+    free(transfer);
+  }
+}
+
+/* Start the radio and process the samples */
+void process_transfer(dsss_transfer_t transfer)
+{
+  transfer->frames_received = 0;
+  transfer->false_alarms = 0;
+  transfer->frames_missed = 0;
+  transfer->clock_error = 0;
+  transfer->clock_estimates = 0;
+  transfer->stream_offset = 0;
+  transfer->stream_end = 0;
+  transfer->bytes_missing = 0;
+  transfer->pass = 0;
+  transfer->hop_counter = 0;
+  transfer->hop_retune = 0;
+  transfer->hop_time = 0;
+  transfer->batch_count = 0;
+  transfer->batch_index = 0;
+  transfer->batch_offset = 0;
+  transfer->batch_end = 0;
+  transfer->batch_data_used = 0;
+  if(transfer->hopping)
+  {
+    hopping_reset(transfer->hopping);
+  }
+  if(transfer->emit)
+  {
+    set_stream_size(transfer);
+    if(transfer->start_offset > 0)
+    {
+      /* Resume an interrupted transfer */
+      if(fseeko(transfer->file,
+                transfer->stream_start + transfer->start_offset,
+                SEEK_SET) != 0)
+      {
+        fprintf(stderr, _("Error: Failed to seek in the input file\n"));
+        return;
+      }
+      transfer->stream_offset = transfer->start_offset;
+    }
+  }
+  else
+  {
+    transfer->stream_size = 0;
+    transfer->stream_size_known = 0;
+    if(transfer->truncate_file)
+    {
+      if(!transfer->coverage && (ftruncate(fileno(transfer->file), 0) != 0))
+      {
+        fprintf(stderr, _("Error: Failed to truncate the output file\n"));
+      }
+      transfer->truncate_file = 0;
+    }
+    if(transfer->coverage)
+    {
+      load_coverage(transfer);
+      transfer->checkpoint_time = time(NULL);
+    }
+  }
+  if(transfer->auto_ppm)
+  {
+    load_clock_error(transfer);
+  }
+  /* Start the radio only once the input is ready, there is nothing to
+   * clean up if the preparation fails */
+  switch(transfer->radio_type)
+  {
+  case IO:
+    if(verbose)
+    {
+      fprintf(stderr, _("Info: Using IO pseudo-radio\n"));
+    }
+    break;
+
+  case EXTERNAL:
+    if(verbose)
+    {
+      fprintf(stderr, _("Info: Using EXTERNAL pseudo-radio\n"));
+    }
+    break;
+
+  case FILENAME:
+    if(verbose)
+    {
+      fprintf(stderr, _("Info: Using FILENAME pseudo-radio\n"));
+    }
+    break;
+
+  case SOAPYSDR:
+    SoapySDRDevice_activateStream(transfer->radio_device.soapysdr,
+                                  transfer->radio_stream.soapysdr,
+                                  0,
+                                  0,
+                                  0);
+    break;
+
+  default:
+    return;
+  }
+
+  transfer->timeout_start = time(NULL);
+  if(transfer->emit)
+  {
+    send_frames(transfer);
+  }
+  else if(transfer->branches_count > 0)
+  {
+    receive_diversity(transfer);
+  }
+  else
+  {
+    receive_frames(transfer);
+  }
+}
+
+/* Run a transfer until it is finished or stopped */
+void run_transfer(dsss_transfer_t transfer)
+{
+  process_transfer(transfer);
+  if(transfer->radio_type == EXTERNAL)
+  {
+    /* Give the last buffer back to the application */
+    pthread_mutex_lock(&transfer->external_lock);
+    transfer->external_finished = 1;
+    pthread_cond_broadcast(&transfer->external_cond);
+    pthread_mutex_unlock(&transfer->external_lock);
+  }
+}
+
+void dsss_transfer_start(dsss_transfer_t transfer)
+{
+  reset_flags(transfer);
+  run_transfer(transfer);
+}
+
+/* Create the pipe used to signal the events of a transfer */
+int open_event_pipe(dsss_transfer_t transfer)
+{
+  if(!transfer->event_fds_open)
+  {
+    if(pipe(transfer->event_fds) != 0)
+    {
+      fprintf(stderr, _("Error: Failed to create the event pipe\n"));
+      return(-1);
+    }
+    fcntl(transfer->event_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(transfer->event_fds[1], F_SETFL, O_NONBLOCK);
+    transfer->event_fds_open = 1;
+  }
+  return(0);
+}
+
+/* Thread running a transfer started with dsss_transfer_start_async() */
+void * transfer_thread(void *arg)
+{
+  dsss_transfer_t transfer = (dsss_transfer_t) arg;
+
+  run_transfer(transfer);
+  notify(transfer, DSSS_TRANSFER_EVENT_DONE);
+  return(NULL);
+}
+
+int dsss_transfer_start_async(dsss_transfer_t transfer)
+{
+  if(transfer->thread_started)
+  {
+    fprintf(stderr, _("Error: The transfer is already running\n"));
+    return(-1);
+  }
+  if(open_event_pipe(transfer) != 0)
+  {
+    return(-1);
+  }
+  /* The flags are reset before returning, so that the transfer can be
+   * stopped as soon as this function returns */
+  reset_flags(transfer);
+  if(pthread_create(&transfer->thread, NULL, transfer_thread, transfer) != 0)
+  {
+    fprintf(stderr, _("Error: Failed to start the transfer thread\n"));
+    return(-1);
+  }
+  transfer->thread_started = 1;
+  return(0);
+}
+
+void dsss_transfer_wait(dsss_transfer_t transfer)
+{
+  if(transfer->thread_started)
+  {
+    pthread_join(transfer->thread, NULL);
+    transfer->thread_started = 0;
+  }
+}
+
+int dsss_transfer_get_event_fd(dsss_transfer_t transfer)
+{
+  if(open_event_pipe(transfer) != 0)
+  {
+    return(-1);
+  }
+  return(transfer->event_fds[0]);
+}
+
+unsigned int dsss_transfer_get_events(dsss_transfer_t transfer)
+{
+  unsigned char buffer[16];
+
+  if(transfer->event_fds_open)
+  {
+    /* Empty the pipe before taking the events, so that an event signaled
+     * in between leaves a byte to read */
+    while(read(transfer->event_fds[0], buffer, sizeof(buffer)) > 0)
+    {
+    }
+  }
+  return(atomic_exchange(&transfer->events, 0));
+}
+
+void dsss_transfer_set_acquisition_range(dsss_transfer_t transfer,
+                                         unsigned int range)
+{
+  if((range > 0) && transfer->hopping)
+  {
+    fprintf(stderr,
+            _("Error: The acquisition stage can't be used with frequency hopping\n"));
+    return;
+  }
+  transfer->acquisition_range = range;
+}
+
+void dsss_transfer_set_auto_ppm(dsss_transfer_t transfer,
+                                unsigned char auto_ppm)
+{
+  if(auto_ppm && transfer->audio_converter)
+  {
+    fprintf(stderr,
+            _("Error: Automatic clock correction is not available with audio samples\n"));
+    return;
+  }
+  transfer->auto_ppm = auto_ppm;
+}
+
+void dsss_transfer_set_combining(dsss_transfer_t transfer,
+                                 unsigned int frames)
+{
+  transfer->combining = frames;
+}
+
+void dsss_transfer_set_excision(dsss_transfer_t transfer,
+                                unsigned char excision)
+{
+  transfer->excision = excision;
+}
+
+void dsss_transfer_set_tracking(dsss_transfer_t transfer,
+                                unsigned char tracking)
+{
+  if(tracking && transfer->hopping)
+  {
+    fprintf(stderr, _("Error: Tracking can't be used with frequency hopping\n"));
+    return;
+  }
+  transfer->tracking = tracking;
+}
+
+void dsss_transfer_set_superframe(dsss_transfer_t transfer,
+                                  unsigned int frames)
+{
+  if(frames == 0)
+  {
+    fprintf(stderr, _("Error: Invalid number of frames per superframe\n"));
+    return;
+  }
+  if((frames > 1) && transfer->hopping)
+  {
+    fprintf(stderr,
+            _("Error: Superframes can't be used with frequency hopping\n"));
+    return;
+  }
+  transfer->superframe = frames;
+}
+
+void dsss_transfer_set_extended_header(dsss_transfer_t transfer,
+                                       unsigned char extended_header)
+{
+  if(extended_header && (transfer->arq || transfer->erasure))
+  {
+    fprintf(stderr,
+            _("Error: The extended header can't be used with ARQ or erasure coding\n"));
+    return;
+  }
+  if(!extended_header && (transfer->coverage || (transfer->passes != 1)))
+  {
+    fprintf(stderr,
+            _("Error: The extended header is needed by random access output and by the carousel mode\n"));
+    return;
+  }
+  transfer->extended_header = extended_header;
+}
+
+void dsss_transfer_set_random_access(dsss_transfer_t transfer,
+                                     unsigned char random_access)
+{
+  if(!random_access)
+  {
+    coverage_free(transfer->coverage);
+    transfer->coverage = NULL;
+    return;
+  }
+  if(transfer->emit || (transfer->map_file == NULL))
+  {
+    fprintf(stderr,
+            _("Error: Random access output is only available when receiving to a file\n"));
+    return;
+  }
+  if(transfer->arq || transfer->erasure)
+  {
+    fprintf(stderr,
+            _("Error: Random access output can't be used with ARQ or erasure coding\n"));
+    return;
+  }
+  if(transfer->coverage == NULL)
+  {
+    transfer->coverage = coverage_create(COVERAGE_BLOCK_SIZE);
+    if(transfer->coverage == NULL)
+    {
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      return;
+    }
+  }
+  /* The position of the data in the stream is given by the extended header */
+  transfer->extended_header = 1;
+}
+
+void dsss_transfer_set_carousel(dsss_transfer_t transfer,
+                                unsigned int passes)
+{
+  struct stat file_stat;
+
+  if(passes == 1)
+  {
+    transfer->passes = 1;
+    return;
+  }
+  if(!transfer->emit ||
+     (transfer->file == NULL) ||
+     (fstat(fileno(transfer->file), &file_stat) != 0) ||
+     !S_ISREG(file_stat.st_mode))
+  {
+    fprintf(stderr,
+            _("Error: The carousel mode is only available when sending a file\n"));
+    return;
+  }
+  if(transfer->arq || transfer->erasure)
+  {
+    fprintf(stderr,
+            _("Error: The carousel mode can't be used with ARQ or erasure coding\n"));
+    return;
+  }
+  transfer->passes = passes;
+  /* The position of the data in the stream is given by the extended header */
+  transfer->extended_header = 1;
+}
+
+void dsss_transfer_set_start_offset(dsss_transfer_t transfer,
+                                    unsigned long long int offset)
+{
+  struct stat file_stat;
+
+  if(offset == 0)
+  {
+    transfer->start_offset = 0;
+    return;
+  }
+  if(!transfer->emit ||
+     (transfer->file == NULL) ||
+     (fstat(fileno(transfer->file), &file_stat) != 0) ||
+     !S_ISREG(file_stat.st_mode))
+  {
+    fprintf(stderr,
+            _("Error: The start offset is only available when sending a file\n"));
+    return;
+  }
+  transfer->start_offset = offset;
+  /* The position of the data in the stream is given by the extended header */
+  transfer->extended_header = 1;
+}
+
+void dsss_transfer_set_header_fec(dsss_transfer_t transfer,
+                                  char *inner_fec,
+                                  char *outer_fec,
+                                  char *crc)
+{
+  fec_scheme header_inner_fec = liquid_getopt_str2fec(inner_fec);
+  fec_scheme header_outer_fec = liquid_getopt_str2fec(outer_fec);
+  crc_scheme header_crc = liquid_getopt_str2crc(crc);
+
+  if(header_inner_fec == LIQUID_FEC_UNKNOWN)
+  {
+    fprintf(stderr, _("Error: Invalid header inner FEC\n"));
+    return;
+  }
+  if(header_outer_fec == LIQUID_FEC_UNKNOWN)
+  {
+    fprintf(stderr, _("Error: Invalid header outer FEC\n"));
+    return;
+  }
+  if((header_crc == LIQUID_CRC_UNKNOWN) || (header_crc == LIQUID_CRC_NONE))
+  {
+    fprintf(stderr, _("Error: Invalid header CRC\n"));
+    return;
+  }
+  transfer->header_inner_fec = header_inner_fec;
+  transfer->header_outer_fec = header_outer_fec;
+  transfer->header_crc = header_crc;
+  transfer->header_fec_set = 1;
+}
+
+void dsss_transfer_set_interleaving(dsss_transfer_t transfer,
+                                    unsigned int depth)
+{
+  if((depth == 0) || (depth > DSSSFRAME_INTERLEAVER_DEPTH_MAX))
+  {
+    fprintf(stderr, _("Error: Invalid interleaving depth\n"));
+    return;
+  }
+  if((depth > 1) && transfer->hopping)
+  {
+    fprintf(stderr,
+            _("Error: Interleaving can't be used with frequency hopping\n"));
+    return;
+  }
+  transfer->interleaving = depth;
+}
+
+void dsss_transfer_set_preamble_size(dsss_transfer_t transfer,
+                                     unsigned int size)
+{
+  if((size < 16) || (size > 1024))
+  {
+    fprintf(stderr, _("Error: Invalid preamble size\n"));
+    return;
+  }
+  transfer->preamble_size = size;
+}
+
+void dsss_transfer_set_detector_threshold(dsss_transfer_t transfer,
+                                          float threshold)
+{
+  if((threshold <= 0) || (threshold >= 1))
+  {
+    fprintf(stderr, _("Error: Invalid detector threshold\n"));
+    return;
+  }
+  transfer->detector_threshold = threshold;
+}
+
+void dsss_transfer_get_detector_statistics(dsss_transfer_t transfer,
+                                           unsigned int *false_alarms,
+                                           unsigned int *frames_missed)
+{
+  *false_alarms = transfer->false_alarms;
+  *frames_missed = transfer->frames_missed;
+}
+
+void dsss_transfer_set_arq(dsss_transfer_t receiver,
+                           dsss_transfer_t sender,
+                           unsigned int window)
+{
+  arq_t arq;
+
+  if(receiver->emit || !sender->emit)
+  {
+    fprintf(stderr,
+            _("Error: ARQ needs a receiving transfer and a sending transfer\n"));
+    return;
+  }
+  if(receiver->erasure || sender->erasure)
+  {
+    fprintf(stderr, _("Error: ARQ can't be used with erasure coding\n"));
+    return;
+  }
+  if(receiver->extended_header || sender->extended_header)
+  {
+    fprintf(stderr, _("Error: ARQ can't be used with the extended header\n"));
+    return;
+  }
+  if(receiver->hopping || sender->hopping)
+  {
+    fprintf(stderr, _("Error: ARQ can't be used with frequency hopping\n"));
+    return;
+  }
+  if(receiver->branches_count > 0)
+  {
+    fprintf(stderr, _("Error: ARQ can't be used with diversity reception\n"));
+    return;
+  }
+  arq = arq_create(window);
+  if(arq == NULL)
+  {
+    fprintf(stderr, _("Error: Invalid ARQ window size\n"));
+    return;
+  }
+  arq_free(receiver->arq);
+  arq_free(sender->arq);
+  receiver->arq = arq;
+  sender->arq = arq_share(arq);
+}
+
+void dsss_transfer_set_adaptive_rate(dsss_transfer_t transfer,
+                                     unsigned char adaptive_rate)
+{
+  unsigned int rate = ADAPTIVE_RATE_DEFAULT;
+  unsigned int i;
+
+  if(adaptive_rate && (!transfer->emit || !transfer->arq))
+  {
+    fprintf(stderr,
+            _("Error: Adaptive rate needs a sending transfer using ARQ\n"));
+    return;
+  }
+  if(adaptive_rate)
+  {
+    /* Start with the FEC codes given when creating the transfer if they
+     * are in the list of rates */
+    for(i = 0; i < ADAPTIVE_RATES; i++)
+    {
+      if((adaptive_rates[i][0] == transfer->inner_fec) &&
+         (adaptive_rates[i][1] == transfer->outer_fec))
+      {
+        rate = i;
+        break;
+      }
+    }
+    arq_set_rates(transfer->arq, ADAPTIVE_RATES, rate);
+  }
+  else if(transfer->arq)
+  {
+    arq_set_rates(transfer->arq, 0, 0);
+  }
+  transfer->adaptive_rate = adaptive_rate;
+}
+
+void dsss_transfer_set_erasure_coding(dsss_transfer_t transfer,
+                                      unsigned int block_size,
+                                      unsigned int repair_frames)
+{
+  erasure_t erasure;
+
+  if(transfer->arq)
+  {
+    fprintf(stderr, _("Error: Erasure coding can't be used with ARQ\n"));
+    return;
+  }
+  if(transfer->extended_header)
+  {
+    fprintf(stderr,
+            _("Error: Erasure coding can't be used with the extended header\n"));
+    return;
+  }
+  if(transfer->hopping)
+  {
+    fprintf(stderr,
+            _("Error: Erasure coding can't be used with frequency hopping\n"));
+    return;
+  }
+  erasure = erasure_create(block_size, repair_frames);
+  if(erasure == NULL)
+  {
+    fprintf(stderr, _("Error: Invalid erasure coding parameters\n"));
+    return;
+  }
+  erasure_free(transfer->erasure);
+  transfer->erasure = erasure;
+}
+
+void dsss_transfer_set_hopping(dsss_transfer_t transfer,
+                               unsigned int channels,
+                               unsigned int spacing)
+{
+  hopping_t hopping;
+  float bandwidth = transfer->bit_rate * transfer->spreading_factor;
+
+  if(channels == 0)
+  {
+    hopping_free(transfer->hopping);
+    transfer->hopping = NULL;
+    return;
+  }
+  if(transfer->arq || transfer->erasure)
+  {
+    fprintf(stderr,
+            _("Error: Frequency hopping can't be used with ARQ or erasure coding\n"));
+    return;
+  }
+  if((transfer->interleaving > 1) || (transfer->superframe > 1) ||
+     transfer->tracking || (transfer->acquisition_range > 0))
+  {
+    fprintf(stderr,
+            _("Error: Frequency hopping can't be used with interleaving, superframes, tracking or the acquisition stage\n"));
+    return;
+  }
+  hopping = hopping_create(channels, spacing, transfer->id);
+  if(hopping == NULL)
+  {
+    fprintf(stderr, _("Error: Invalid frequency hopping parameters\n"));
+    return;
+  }
+  /* The receiver captures all the channels at once and selects the channel
+   * of each frame digitally, so they must all be in the band of the radio */
+  if(labs(transfer->frequency_offset) + hopping_get_max_offset(hopping) +
+     bandwidth > transfer->sample_rate / 2)
+  {
+    fprintf(stderr,
+            _("Error: The hopping channels don't fit in the band of the radio\n"));
+    hopping_free(hopping);
+    return;
+  }
+  hopping_free(transfer->hopping);
+  transfer->hopping = hopping;
+}
+
+void dsss_transfer_add_diversity_branch(dsss_transfer_t transfer,
+                                        dsss_transfer_t branch)
+{
+  if(transfer->emit || branch->emit)
+  {
+    fprintf(stderr, _("Error: Diversity reception needs receiving transfers\n"));
+    return;
+  }
+  if((branch == transfer) || transfer->diversity_main ||
+     branch->diversity_main || (branch->branches_count > 0))
+  {
+    fprintf(stderr, _("Error: Invalid diversity branch\n"));
+    return;
+  }
+  if(transfer->arq)
+  {
+    fprintf(stderr, _("Error: Diversity reception can't be used with ARQ\n"));
+    return;
+  }
+  if(transfer->batch_callback || branch->batch_callback)
+  {
+    fprintf(stderr,
+            _("Error: Diversity reception can't be used with batch callbacks\n"));
+    return;
+  }
+  if((branch->bit_rate != transfer->bit_rate) ||
+     (branch->spreading_factor != transfer->spreading_factor) ||
+     (strcmp(branch->id, transfer->id) != 0))
+  {
+    fprintf(stderr,
+            _("Error: The radios of a diversity reception must use the same bit rate, spreading factor and id\n"));
+    return;
+  }
+  if(transfer->branches_count >= DIVERSITY_MAX_BRANCHES)
+  {
+    fprintf(stderr,
+            _("Error: At most %u radios can be added for diversity reception\n"),
+            DIVERSITY_MAX_BRANCHES);
+    return;
+  }
+  if(transfer->diversity == NULL)
+  {
+    transfer->diversity = diversity_create(diversity_frame_selected, transfer);
+    if(transfer->diversity == NULL)
+    {
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      return;
+    }
+  }
+  branch->diversity_main = transfer;
+  transfer->branches[transfer->branches_count] = branch;
+  transfer->branches_count++;
+}
+
+void dsss_transfer_set_batch_callback(dsss_transfer_t transfer,
+                                      int (*batch_callback)(void *,
+                                                            struct iovec *,
+                                                            unsigned int),
+                                      void *callback_context)
+{
+  if(transfer->file)
+  {
+    fprintf(stderr,
+            _("Error: Batch callbacks are only available for transfers using a callback\n"));
+    return;
+  }
+  if(transfer->datagram)
+  {
+    fprintf(stderr,
+            _("Error: Batch callbacks can't be used with the message mode\n"));
+    return;
+  }
+  if(transfer->diversity_main || (transfer->branches_count > 0))
+  {
+    fprintf(stderr,
+            _("Error: Batch callbacks can't be used with diversity reception\n"));
+    return;
+  }
+  transfer->batch_callback = batch_callback;
+  transfer->batch_context = callback_context;
+  transfer->data_callback = transfer->emit ? read_batch : write_batch;
+  transfer->callback_context = transfer;
+}
+
+void dsss_transfer_set_message_mode(dsss_transfer_t transfer,
+                                    int (*message_callback)(void *,
+                                                            unsigned char *,
+                                                            unsigned int),
+                                    void *callback_context)
+{
+  if(transfer->file)
+  {
+    fprintf(stderr,
+            _("Error: Message mode is only available for transfers using a callback\n"));
+    return;
+  }
+  if(transfer->batch_callback)
+  {
+    fprintf(stderr,
+            _("Error: Message mode can't be used with batch callbacks\n"));
+    return;
+  }
+  if(transfer->datagram == NULL)
+  {
+    transfer->datagram = datagram_create();
+    if(transfer->datagram == NULL)
+    {
+      fprintf(stderr, _("Error: Memory allocation failed\n"));
+      return;
     }
   }
-  else
+  transfer->message_callback = message_callback;
+  transfer->message_context = callback_context;
+  transfer->data_callback = transfer->emit ? read_messages : write_messages;
+  transfer->callback_context = transfer;
+}
+
+int dsss_transfer_send_message(dsss_transfer_t transfer,
+                               unsigned char *message,
+                               unsigned int message_size)
+{
+  if((transfer->datagram == NULL) || !transfer->emit)
   {
-    transfer->dump = NULL;
+    fprintf(stderr, _("Error: The transfer is not a sending transfer in message mode\n"));
+    return(-1);
+  }
+  if(message_size > DATAGRAM_MAX_MESSAGE_SIZE)
+  {
+    fprintf(stderr,
+            _("Error: Messages can't be bigger than %u bytes\n"),
+            DATAGRAM_MAX_MESSAGE_SIZE);
+    return(-1);
   }
+  return(datagram_send(transfer->datagram, message, message_size));
+}
 
-  transfer->timeout = timeout;
+void dsss_transfer_set_direction(dsss_transfer_t transfer,
+                                 unsigned char emit,
+                                 char *gain)
+{
+  radio_stream_t stream;
+  int direction;
+  FILE *file;
+
+  if(transfer->file)
+  {
+    fprintf(stderr,
+            _("Error: The direction of a transfer using a file can't be changed\n"));
+    return;
+  }
+  if(transfer->arq || transfer->erasure)
+  {
+    fprintf(stderr,
+            _("Error: The direction of a transfer using ARQ or erasure coding can't be changed\n"));
+    return;
+  }
+  if(transfer->diversity_main || (transfer->branches_count > 0))
+  {
+    fprintf(stderr,
+            _("Error: The direction of a diversity reception can't be changed\n"));
+    return;
+  }
+  emit = emit ? 1 : 0;
+  direction = emit ? SOAPY_SDR_TX : SOAPY_SDR_RX;
+  if(gain == NULL)
+  {
+    gain = transfer->radio_gain;
+  }
 
   switch(transfer->radio_type)
   {
   case IO:
+    if(transfer->emit)
+    {
+      fflush(stdout);
+    }
     break;
 
   case FILENAME:
-    if(emit)
+    if(emit == transfer->emit)
     {
-      transfer->radio_device.file = fopen(radio_driver + 5, "wb");
-    }
-    else
-    {
-      transfer->radio_device.file = fopen(radio_driver + 5, "rb");
+      break;
     }
-    if(transfer->radio_device.file == NULL)
+    /* Make the samples written until now available to the reader */
+    fflush(transfer->radio_device.file);
+    file = fopen(transfer->radio_file, emit ? "wb" : "rb");
+    if(file == NULL)
     {
-      fprintf(stderr, _("Error: Failed to open '%s'\n"), radio_driver + 5);
-      free(transfer);
-      return(NULL);
+      fprintf(stderr, _("Error: Failed to open '%s'\n"), transfer->radio_file);
+      return;
     }
+    fclose(transfer->radio_device.file);
+    transfer->radio_device.file = file;
     break;
 
   case SOAPYSDR:
-    transfer->radio_device.soapysdr = SoapySDRDevice_makeStrArgs(radio_driver);
-    if(transfer->radio_device.soapysdr == NULL)
-    {
-      fprintf(stderr, _("Error: %s\n"), SoapySDRDevice_lastError());
-      free(transfer);
-      return(NULL);
-    }
-    direction = emit ? SOAPY_SDR_TX : SOAPY_SDR_RX;
-    SOAPYSDR_CHECK(SoapySDRDevice_setSampleRate(transfer->radio_device.soapysdr,
-                                                direction,
-                                                0,
-                                                transfer->sample_rate));
-    SOAPYSDR_CHECK(SoapySDRDevice_setFrequency(transfer->radio_device.soapysdr,
-                                               direction,
-                                               0,
-                                               transfer->frequency - transfer->frequency_offset,
-                                               NULL));
-    if(strchr(gain, '='))
+    if(emit != transfer->emit)
     {
-      kwargs = SoapySDRKwargs_fromString(gain);
-      for(n = 0; n < kwargs.size; n++)
+      /* Keep the stream of each direction configured, switching from one to
+       * the other only requires activating it */
+      SoapySDRDevice_deactivateStream(transfer->radio_device.soapysdr,
+                                      transfer->radio_stream.soapysdr,
+                                      0,
+                                      0);
+      if(transfer->other_stream.soapysdr == NULL)
       {
-        gain_name = kwargs.keys[n];
-        gain_value = strtoul(kwargs.vals[n], NULL, 10);
-        SOAPYSDR_CHECK(SoapySDRDevice_setGainElement(transfer->radio_device.soapysdr,
-                                                     direction,
-                                                     0,
-                                                     gain_name,
-                                                     gain_value));
+        transfer->other_stream.soapysdr = setup_radio_stream(transfer,
+                                                             direction,
+                                                             gain);
+        if(transfer->other_stream.soapysdr == NULL)
+        {
+          return;
+        }
       }
-      SoapySDRKwargs_clear(&kwargs);
-    }
-    else
-    {
-      gain_value = strtoul(gain, NULL, 10);
-      SOAPYSDR_CHECK(SoapySDRDevice_setGain(transfer->radio_device.soapysdr,
-                                            direction,
-                                            0,
-                                            gain_value));
-    }
-    transfer->radio_stream.soapysdr = SoapySDRDevice_setupStream(transfer->radio_device.soapysdr,
-                                                                 direction,
-                                                                 SOAPY_SDR_CF32,
-                                                                 NULL,
-                                                                 0,
-                                                                 NULL);
-    if(transfer->radio_stream.soapysdr == NULL)
-    {
-      fprintf(stderr, _("Error: %s\n"), SoapySDRDevice_lastError());
-      SoapySDRDevice_unmake(transfer->radio_device.soapysdr);
-      free(transfer);
-      return(NULL);
+      stream = transfer->radio_stream;
+      transfer->radio_stream = transfer->other_stream;
+      transfer->other_stream = stream;
     }
+    set_radio_gain(transfer, direction, gain);
     break;
 
-  default:
-    fprintf(stderr, _("Error: Unknown radio type\n"));
-    free(transfer);
-    return(NULL);
+  case EXTERNAL:
     break;
+
+  default:
+    return;
   }
 
-  return(transfer);
+  transfer->emit = emit;
+  if(transfer->datagram)
+  {
+    transfer->data_callback = emit ? read_messages : write_messages;
+  }
+  else if(transfer->batch_callback)
+  {
+    transfer->data_callback = emit ? read_batch : write_batch;
+  }
 }
 
-dsss_transfer_t dsss_transfer_create(char *radio_driver,
-                                     unsigned char emit,
-                                     char *file,
-                                     unsigned long int sample_rate,
-                                     unsigned int bit_rate,
-                                     unsigned long int frequency,
-                                     long int frequency_offset,
-                                     char *gain,
-                                     float ppm,
-                                     unsigned int spreading_factor,
-                                     char *inner_fec,
-                                     char *outer_fec,
-                                     char *id,
-                                     char *dump,
-                                     unsigned int timeout,
-                                     unsigned char audio)
+unsigned int dsss_transfer_push_samples(dsss_transfer_t transfer,
+                                        float *samples,
+                                        unsigned int samples_size)
 {
-  int flags;
-  dsss_transfer_t transfer;
-
-  transfer = dsss_transfer_create_callback(radio_driver,
-                                           emit,
-                                           emit ? read_data : write_data,
-                                           NULL,
-                                           sample_rate,
-                                           bit_rate,
-                                           frequency,
-                                           frequency_offset,
-                                           gain,
-                                           ppm,
-                                           spreading_factor,
-                                           inner_fec,
-                                           outer_fec,
-                                           id,
-                                           dump,
-                                           timeout,
-                                           audio);
-  if(transfer == NULL)
+  if((transfer->radio_type != EXTERNAL) || transfer->emit)
   {
-    return(NULL);
+    fprintf(stderr,
+            _("Error: Samples can only be pushed to a receiving transfer using the external radio\n"));
+    return(0);
   }
-
-  transfer->callback_context = transfer;
-  if(file)
+  if(samples == NULL)
   {
-    if(emit)
-    {
-      transfer->file = fopen(file, "rb");
-    }
-    else
-    {
-      transfer->file = fopen(file, "wb");
-    }
-    if(transfer->file == NULL)
-    {
-      fprintf(stderr, _("Error: Failed to open '%s'\n"), file);
-      free(transfer);
-      return(NULL);
-    }
+    /* End of the samples */
+    pthread_mutex_lock(&transfer->external_lock);
+    transfer->external_end = 1;
+    pthread_cond_broadcast(&transfer->external_cond);
+    pthread_mutex_unlock(&transfer->external_lock);
+    return(0);
   }
-  else
+  return(lend_external_buffer(transfer,
+                              (complex float *) samples,
+                              samples_size));
+}
+
+unsigned int dsss_transfer_pull_samples(dsss_transfer_t transfer,
+                                        float *samples,
+                                        unsigned int samples_size)
+{
+  if((transfer->radio_type != EXTERNAL) || !transfer->emit)
   {
-    if(emit)
-    {
-      transfer->file = stdin;
-      flags = fcntl(STDIN_FILENO, F_GETFL);
-      fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
-    }
-    else
-    {
-      transfer->file = stdout;
-    }
+    fprintf(stderr,
+            _("Error: Samples can only be pulled from a sending transfer using the external radio\n"));
+    return(0);
   }
-
-  return(transfer);
+  return(lend_external_buffer(transfer,
+                              (complex float *) samples,
+                              samples_size));
 }
 
-void dsss_transfer_free(dsss_transfer_t transfer)
+void dsss_transfer_set_frequency(dsss_transfer_t transfer,
+                                 unsigned long int frequency)
 {
-  if(transfer)
+  if(frequency == 0)
   {
-    if(transfer->file)
-    {
-      fclose(transfer->file);
-    }
-    if(transfer->dump)
-    {
-      fclose(transfer->dump);
-    }
-    if(transfer->audio_converter)
-    {
-      firhilbf_destroy(transfer->audio_converter);
-    }
-    switch(transfer->radio_type)
+    fprintf(stderr, _("Error: Invalid frequency\n"));
+    return;
+  }
+  if(transfer->audio_converter)
+  {
+    fprintf(stderr,
+            _("Error: The frequency can't be changed with audio samples\n"));
+    return;
+  }
+  transfer->frequency = frequency * ((1000000.0 - transfer->ppm) / 1000000.0);
+  if(transfer->radio_type == SOAPYSDR)
+  {
+    SOAPYSDR_CHECK(SoapySDRDevice_setFrequency(transfer->radio_device.soapysdr,
+                                               transfer->emit ? SOAPY_SDR_TX : SOAPY_SDR_RX,
+                                               0,
+                                               transfer->frequency - transfer->frequency_offset,
+                                               NULL));
+    if(transfer->other_stream.soapysdr)
     {
-    case IO:
-      break;
-
-    case FILENAME:
-      fclose(transfer->radio_device.file);
-      break;
-
-    case SOAPYSDR:
-      SoapySDRDevice_deactivateStream(transfer->radio_device.soapysdr,
-                                      transfer->radio_stream.soapysdr,
-                                      0,
-                                      0);
-      SoapySDRDevice_closeStream(transfer->radio_device.soapysdr,
-                                 transfer->radio_stream.soapysdr);
-      SoapySDRDevice_unmake(transfer->radio_device.soapysdr);
-      break;
-
-    default:
-      break;
+      SOAPYSDR_CHECK(SoapySDRDevice_setFrequency(transfer->radio_device.soapysdr,
+                                                 transfer->emit ? SOAPY_SDR_RX : SOAPY_SDR_TX,
+                                                 0,
+                                                 transfer->frequency - transfer->frequency_offset,
+                                                 NULL));
     }
-    free(transfer);
   }
 }
 
-void dsss_transfer_start(dsss_transfer_t transfer)
+void dsss_transfer_reconfigure(dsss_transfer_t transfer,
+                               unsigned int bit_rate,
+                               unsigned long int frequency,
+                               char *gain,
+                               char *inner_fec,
+                               char *outer_fec)
 {
-  stop = 0;
-  transfer->stop = 0;
+  fec_scheme inner = transfer->inner_fec;
+  fec_scheme outer = transfer->outer_fec;
+  int gain_value;
 
-  switch(transfer->radio_type)
+  /* Check all the parameters before changing anything */
+  if(inner_fec)
   {
-  case IO:
-    if(verbose)
+    inner = liquid_getopt_str2fec(inner_fec);
+    if(inner == LIQUID_FEC_UNKNOWN)
     {
-      fprintf(stderr, _("Info: Using IO pseudo-radio\n"));
+      fprintf(stderr, _("Error: Invalid inner FEC\n"));
+      return;
     }
-    break;
-
-  case FILENAME:
-    if(verbose)
+  }
+  if(outer_fec)
+  {
+    outer = liquid_getopt_str2fec(outer_fec);
+    if(outer == LIQUID_FEC_UNKNOWN)
     {
-      fprintf(stderr, _("Info: Using FILENAME pseudo-radio\n"));
+      fprintf(stderr, _("Error: Invalid outer FEC\n"));
+      return;
     }
-    break;
-
-  case SOAPYSDR:
-    SoapySDRDevice_activateStream(transfer->radio_device.soapysdr,
-                                  transfer->radio_stream.soapysdr,
-                                  0,
-                                  0,
-                                  0);
-    break;
-
-  default:
+  }
+  if((frequency != 0) && transfer->audio_converter)
+  {
+    fprintf(stderr,
+            _("Error: The frequency can't be changed with audio samples\n"));
     return;
   }
 
-  transfer->timeout_start = time(NULL);
-  if(transfer->emit)
+  /* The resamplers are redesigned by the next run if the bit rate changed,
+   * the other signal processing objects are kept */
+  if(bit_rate != 0)
   {
-    send_frames(transfer);
+    transfer->bit_rate = bit_rate;
   }
-  else
+  if(frequency != 0)
   {
-    receive_frames(transfer);
+    dsss_transfer_set_frequency(transfer, frequency);
+  }
+  if(gain)
+  {
+    if(transfer->audio_converter)
+    {
+      gain_value = strtol(gain, NULL, 10);
+      transfer->audio_gain = powf(10, gain_value / 20.0);
+    }
+    else if(transfer->radio_type == SOAPYSDR)
+    {
+      set_radio_gain(transfer,
+                     transfer->emit ? SOAPY_SDR_TX : SOAPY_SDR_RX,
+                     gain);
+    }
+  }
+  transfer->inner_fec = inner;
+  transfer->outer_fec = outer;
+  if(!transfer->header_fec_set)
+  {
+    transfer->header_inner_fec = inner;
+    transfer->header_outer_fec = outer;
   }
 }
 
+float dsss_transfer_get_ppm(dsss_transfer_t transfer)
+{
+  return(transfer->ppm + transfer->clock_error);
+}
+
 void dsss_transfer_stop(dsss_transfer_t transfer)
 {
   transfer->stop = 1;
@@ -21,8 +21,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef DSSS_TRANSFER_H
 #define DSSS_TRANSFER_H
 
+#include <sys/uio.h>
+
 typedef struct dsss_transfer_s *dsss_transfer_t;
 
+/* Events signaled by dsss_transfer_get_events() */
+#define DSSS_TRANSFER_EVENT_DATA 0x01
+#define DSSS_TRANSFER_EVENT_DONE 0x02
+
+/* Maximum number of buffers given to or by a batch callback */
+#define DSSS_TRANSFER_MAX_BATCH 64
+
 /* Set the verbosity level
  *  - v: if not 0, print some debug messages to stderr
  */
@@ -32,7 +41,7 @@ void dsss_transfer_set_verbose(unsigned char v);
 unsigned char dsss_transfer_is_verbose();
 
 /* Initialize a new transfer
- *  - radio_driver: radio to use (e.g. "io" or "driver=hackrf")
+ *  - radio_driver: radio to use (e.g. "io", "external" or "driver=hackrf")
  *  - emit: 1 for transmit mode; 0 for receive mode
  *  - file: in transmit mode, read data from this file
  *          in receive mode, write data to this file
@@ -114,13 +123,406 @@ dsss_transfer_t dsss_transfer_create_callback(char *radio_driver,
                                               unsigned int timeout,
                                               unsigned char audio);
 
+/* Enable the wideband acquisition stage
+ *  - range: when receiving, search for frame preambles with a carrier
+ *    frequency offset of up to +/- 'range' Hz, and correct the offset before
+ *    the synchronizer; 0 disables the acquisition stage
+ *
+ * This is useful with radios whose clock error is not corrected.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_acquisition_range(dsss_transfer_t transfer,
+                                         unsigned int range);
+
+/* Enable the automatic correction of the radio clock
+ *  - auto_ppm: if not 0, estimate the clock error of the radio from the
+ *    carrier frequency offset of the received frames, and correct the
+ *    frequency and the sample rate continuously during the reception
+ *
+ * The estimate is relative to the clock of the transmitter. When the serial
+ * number of the radio is known, the estimate is saved at the end of the
+ * reception and it is used as initial correction by the next transfers
+ * using the same radio (in receive and in transmit mode).
+ * The automatic correction is added to the 'ppm' correction given when
+ * creating the transfer.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_auto_ppm(dsss_transfer_t transfer,
+                                unsigned char auto_ppm);
+
+/* Remove narrowband interference when receiving.
+ * An adaptive linear predictor placed between the resampler and the
+ * synchronizer estimates the carriers and other narrowband signals present
+ * in the band of the transfer and subtracts them, so that strong
+ * interferers don't prevent the despreading. It slightly degrades the
+ * reception when there is no interference, and uses some processor time
+ * (reported in verbose mode).
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_excision(dsss_transfer_t transfer,
+                                unsigned char excision);
+
+/* Track the carrier and the timing across frames when receiving.
+ * When a frame has been received, the synchronizer looks for the next frame
+ * only right after it, reusing the carrier frequency, phase, timing and gain
+ * estimates instead of searching again with the preamble detector. If the
+ * next frame is not found there, the normal search is used.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_tracking(dsss_transfer_t transfer,
+                                unsigned char tracking);
+
+/* When receiving, keep the soft symbols of the last 'frames' frames whose
+ * payload could not be decoded, and combine them with the next copies of the
+ * same frames (same id and counter, or same offset with the extended header)
+ * before decoding them again. This helps frames retransmitted by ARQ or
+ * repeated by a carousel to get through a marginal link. 0 disables the
+ * combining (default).
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_combining(dsss_transfer_t transfer,
+                                 unsigned int frames);
+
+/* Use an extended header in the frames, giving the position of the data of
+ * each frame in the stream, the total size of the stream when it is known
+ * (when sending a regular file), and a flag marking the end of the stream.
+ * The receiver detects the data lost precisely, writes the data at its
+ * position in the output file when it is seekable (leaving holes for the
+ * missing data), and stops as soon as the end of the stream has been
+ * received. The sender and the receiver must both use it. The extended
+ * header can't be used with ARQ or erasure coding.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_extended_header(dsss_transfer_t transfer,
+                                       unsigned char extended_header);
+
+/* When receiving to a file, write the data of each frame at its position in
+ * the file with pwrite(), instead of appending it in the order of arrival.
+ * The file is preallocated when the size of the stream is known, and a bitmap
+ * of the parts received is saved beside it ('file.map'). When the transfer
+ * is started again, the map is loaded and only the missing parts are
+ * written, so repeated transfers can fill the holes. The map is removed
+ * once the file is complete. This enables the extended header.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_random_access(dsss_transfer_t transfer,
+                                     unsigned char random_access);
+
+/* When sending a file, send it 'passes' times in a row (0 for no limit),
+ * like a carousel. The default is 1. The frames of each repetition carry
+ * the same offsets in their extended header, so a receiver using random
+ * access output merges the repetitions, stops as soon as it has all the data,
+ * and doesn't need to wait for the end of a repetition. This enables the
+ * extended header.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_carousel(dsss_transfer_t transfer,
+                                unsigned int passes);
+
+/* When sending a file, start at 'offset' bytes in the file instead of at the
+ * beginning, to resume an interrupted transfer. With the extended header, the
+ * frames give their position in the whole file, so a receiver using random
+ * access output completes the file it has already partly received (it saves
+ * the map of the data received regularly, and reports the offset to resume
+ * from in verbose mode).
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_start_offset(dsss_transfer_t transfer,
+                                    unsigned long long int offset);
+
+/* Set the FEC codes and the CRC protecting the headers of the frames,
+ * independently of the ones used for the payloads. By default, the headers
+ * use the FEC codes of the payloads and "crc32". The sender and the receiver
+ * must use the same values. The CRC can't be "none", because it is used to
+ * detect false alarms.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_header_fec(dsss_transfer_t transfer,
+                                  char *inner_fec,
+                                  char *outer_fec,
+                                  char *crc);
+
+/* Spread the payload of each frame over 'depth' consecutive frames when
+ * transmitting (at most 16). A burst of interference or a fade destroying
+ * a whole frame then only destroys a part of several payloads, which the
+ * FEC can correct. The frames are sent by blocks of 'depth' frames, which
+ * adds some latency. The receiver detects the interleaving automatically.
+ * The default is 1 (no interleaving).
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_interleaving(dsss_transfer_t transfer,
+                                    unsigned int depth);
+
+/* Send up to 'frames' frames after a single preamble when transmitting.
+ * When the data for the next frame is already available, it is sent right
+ * after the current frame, without preamble, and the receiver stays locked
+ * from one frame to the next. This reduces the overhead for bulk transfers.
+ * The default is 1 (one preamble per frame).
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_superframe(dsss_transfer_t transfer,
+                                  unsigned int frames);
+
+/* Set the number of symbols of the preamble of the frames (between 16 and
+ * 1024, default 64). The sender and the receiver must use the same size.
+ * A short preamble reduces the overhead on links with a good signal to noise
+ * ratio, a long one makes the detection more reliable on noisy links.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_preamble_size(dsss_transfer_t transfer,
+                                     unsigned int size);
+
+/* Set the threshold of the preamble detector when receiving (between 0 and 1,
+ * default 0.5). A lower threshold can detect weaker frames, but it gives
+ * more false alarms.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_detector_threshold(dsss_transfer_t transfer,
+                                          float threshold);
+
+/* Get the statistics of the preamble detector after a reception.
+ * 'false_alarms' is set to the number of detections that didn't give
+ * a valid header, and 'frames_missed' to the number of frames that were
+ * not received between the first and the last frames received.
+ */
+void dsss_transfer_get_detector_statistics(dsss_transfer_t transfer,
+                                           unsigned int *false_alarms,
+                                           unsigned int *frames_missed);
+
+/* Link a receiving transfer and a sending transfer to make a reliable
+ * full-duplex link using a selective-repeat ARQ. The frames that are not
+ * acknowledged by the peer are sent again, and the data is given to the
+ * callback of the receiving transfer in order and without duplicates.
+ * 'window' is the maximum number of frames waiting for an acknowledgement
+ * (at most 32). The peer must also use ARQ.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_arq(dsss_transfer_t receiver,
+                           dsss_transfer_t sender,
+                           unsigned int window);
+
+/* Adapt the FEC codes of the frames sent to the quality of the link.
+ * The transfer must be a sending transfer using ARQ (see
+ * dsss_transfer_set_arq()). The acknowledgements from the peer are used to
+ * choose the FEC codes giving the best throughput: faster codes are tried
+ * when the frames are received without retransmission, and more robust
+ * codes are used when frames are lost. The FEC codes used for each frame
+ * are given in its header, so the receiver doesn't need to be configured.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_adaptive_rate(dsss_transfer_t transfer,
+                                     unsigned char adaptive_rate);
+
+/* Enable erasure coding for one-way transfers.
+ * When sending, 'repair_frames' repair frames are sent after each block of
+ * 'block_size' source frames (at most 255), and a receiver can rebuild the
+ * block from any 'block_size' frames of the block (sometimes a few more).
+ * When receiving, the parameters are not used, the size of the blocks is
+ * given by the sender. Erasure coding can't be used with ARQ.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_erasure_coding(dsss_transfer_t transfer,
+                                      unsigned int block_size,
+                                      unsigned int repair_frames);
+
+/* Enable frequency hopping to avoid narrowband interferers.
+ * Each frame is sent on one of 'channels' channels (at most 256) separated
+ * by 'spacing' Hz and centered on the frequency of the transfer, following
+ * a pseudo-random pattern derived from the transfer id and using every
+ * channel once per 'channels' frames. A short silence is left between
+ * the frames.
+ * The radio stays on the same frequency, the channels must fit in the band
+ * given by the sample rate. The receiver follows the pattern by retuning its
+ * digital oscillator after each frame received; when it has not received
+ * any frame yet, or has missed too many frames, it waits on a channel until
+ * the pattern comes back to it.
+ * Frequency hopping can't be used with ARQ, erasure coding, interleaving,
+ * superframes, tracking or the acquisition stage. 0 channels disables
+ * frequency hopping. The sender and the receiver must use the same
+ * parameters and the same id.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_hopping(dsss_transfer_t transfer,
+                               unsigned int channels,
+                               unsigned int spacing);
+
+/* Receive the same transfer with several radios (diversity reception).
+ * 'branch' is a receiving transfer created with
+ * dsss_transfer_create_callback() for another radio, with the same bit rate,
+ * spreading factor and id as 'transfer', and with the same reception settings
+ * (header FEC, preamble size, etc.). Its data callback is not used.
+ * When 'transfer' is started, each radio receives and decodes the frames in
+ * its own thread, and the first copy of each frame decoded by any of the
+ * radios is given to 'transfer' (selection combining), in the order of the
+ * frame counters and without duplicates. At most 7 branches can be added.
+ * Diversity reception can't be used with ARQ. The branches must not be
+ * started or freed before 'transfer'.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_add_diversity_branch(dsss_transfer_t transfer,
+                                        dsss_transfer_t branch);
+
+/* Exchange the data with the application by batches of buffers instead of
+ * one frame at a time.
+ * The transfer must have been created with dsss_transfer_create_callback(),
+ * whose data callback is then not used anymore.
+ * When sending, 'batch_callback' is called with an array of
+ * DSSS_TRANSFER_MAX_BATCH buffers to describe. It must set the address and
+ * size of up to that many buffers of data to send, and return the number of
+ * buffers set (0 if there is no data for now, -1 when there is no more
+ * data). The data is encoded directly from the buffers, without copy, and
+ * each frame takes its payload from a single buffer, so the buffers should
+ * be bigger than a frame. The buffers belong to the transfer until the next
+ * call to 'batch_callback', or until the end of the transfer.
+ * When receiving, 'batch_callback' is called after each block of samples
+ * (about 50 ms of signal) with the payloads of the frames received in the
+ * block, which are only valid during the call. Its return value is ignored.
+ * Batch callbacks can't be used with the message mode or with diversity
+ * reception.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_batch_callback(dsss_transfer_t transfer,
+                                      int (*batch_callback)(void *,
+                                                            struct iovec *,
+                                                            unsigned int),
+                                      void *callback_context);
+
+/* Send and receive messages instead of a byte stream.
+ * The transfer must have been created with dsss_transfer_create_callback(),
+ * whose data callback is then not used anymore.
+ * When sending, the messages given to dsss_transfer_send_message() are
+ * packed together into the frames, and the messages too big for a frame
+ * are fragmented.
+ * When receiving, 'message_callback' is called with each complete message
+ * received, with the same arguments and return value as the data callback
+ * of dsss_transfer_create_callback(). The messages whose fragments have not
+ * all been received are dropped.
+ * This function must be called before dsss_transfer_start().
+ */
+void dsss_transfer_set_message_mode(dsss_transfer_t transfer,
+                                    int (*message_callback)(void *,
+                                                            unsigned char *,
+                                                            unsigned int),
+                                    void *callback_context);
+
+/* Queue a message to send (at most 65535 bytes) in a sending transfer in
+ * message mode. The message is copied. This function can be called before
+ * dsss_transfer_start(), or from another thread while the transfer is
+ * running; the transfer waits for new messages when the queue is empty.
+ * If 'message' is NULL, the transfer stops once the queued messages have
+ * been sent, and the next messages will be sent by the next call to
+ * dsss_transfer_start().
+ * The function returns 0 on success, and -1 otherwise.
+ */
+int dsss_transfer_send_message(dsss_transfer_t transfer,
+                               unsigned char *message,
+                               unsigned int message_size);
+
+/* Switch a transfer to sending ('emit' = 1) or receiving ('emit' = 0),
+ * keeping the radio and the signal processing objects ready, so that
+ * a program exchanging data in both directions doesn't have to create
+ * a new transfer each time. With SoapySDR radios, the streams of both
+ * directions stay configured and switching only takes a few milliseconds.
+ * If 'gain' is NULL, the gain given when creating the transfer is used.
+ * The transfer must have been created with dsss_transfer_create_callback(),
+ * and must not use ARQ or erasure coding.
+ * This function must be called between two calls to dsss_transfer_start().
+ */
+void dsss_transfer_set_direction(dsss_transfer_t transfer,
+                                 unsigned char emit,
+                                 char *gain);
+
+/* Change the frequency of the radio (in Hz) without creating a new transfer.
+ * This function must be called between two calls to dsss_transfer_start().
+ */
+void dsss_transfer_set_frequency(dsss_transfer_t transfer,
+                                 unsigned long int frequency);
+
+/* Change the parameters of a transfer without creating a new one.
+ * The radio stays open, and only the signal processing objects depending on
+ * the changed parameters are rebuilt (the resamplers when the bit rate
+ * changes). The parameters equal to 0 or NULL are not changed.
+ * When receiving, the FEC codes are given by the sender and the parameters
+ * 'inner_fec' and 'outer_fec' are not used.
+ * This function must be called between two calls to dsss_transfer_start().
+ */
+void dsss_transfer_reconfigure(dsss_transfer_t transfer,
+                               unsigned int bit_rate,
+                               unsigned long int frequency,
+                               char *gain,
+                               char *inner_fec,
+                               char *outer_fec);
+
+/* Get the total correction for the radio clock (in ppm) */
+float dsss_transfer_get_ppm(dsss_transfer_t transfer);
+
 /* Cleanup after a finished transfer */
 void dsss_transfer_free(dsss_transfer_t transfer);
 
 /* Start a transfer and return when finished */
 void dsss_transfer_start(dsss_transfer_t transfer);
 
-/* Interrupt a transfer */
+/* Start a transfer in a thread of the library and return immediately.
+ * The callbacks of the transfer are called from this thread. When the
+ * transfer is finished, the DSSS_TRANSFER_EVENT_DONE event is signaled
+ * (see dsss_transfer_get_event_fd()), and dsss_transfer_wait() must be called
+ * before starting the transfer again or changing its settings.
+ * If the thread can't be started, the function returns -1. Otherwise it
+ * returns 0.
+ */
+int dsss_transfer_start_async(dsss_transfer_t transfer);
+
+/* Wait until a transfer started with dsss_transfer_start_async() is
+ * finished */
+void dsss_transfer_wait(dsss_transfer_t transfer);
+
+/* Get a file descriptor that becomes readable when an event has been
+ * signaled by a transfer started with dsss_transfer_start_async(), to be
+ * used with poll() or select() in an event loop. It must not be read or
+ * closed by the caller.
+ * If the descriptor can't be created, the function returns -1.
+ */
+int dsss_transfer_get_event_fd(dsss_transfer_t transfer);
+
+/* Get the events signaled since the last call and clear them. The result is
+ * a combination of:
+ *  - DSSS_TRANSFER_EVENT_DATA: frames have been received and their data has
+ *    been given to the callback
+ *  - DSSS_TRANSFER_EVENT_DONE: the transfer is finished
+ * The result can be 0 if the events have already been taken by a previous
+ * call.
+ */
+unsigned int dsss_transfer_get_events(dsss_transfer_t transfer);
+
+/* Give received samples to a transfer using the "external" radio, to embed
+ * the modem in another signal processing chain. 'samples' contains
+ * 'samples_size' IQ samples (I and Q interleaved, as 'complex float'), at
+ * the sample rate and center frequency of the transfer.
+ * The transfer must be running in another thread (see
+ * dsss_transfer_start_async()). The function waits until the transfer has
+ * taken all the samples, copying them once from 'samples' into its own
+ * buffer, and returns the number of samples taken, which is smaller than 'samples_size' only if the transfer
+ * has been stopped or is finished.
+ * Calling the function with NULL samples signals the end of the samples, the
+ * transfer then finishes once it has processed the previous ones.
+ */
+unsigned int dsss_transfer_push_samples(dsss_transfer_t transfer,
+                                        float *samples,
+                                        unsigned int samples_size);
+
+/* Get samples to send from a transfer using the "external" radio.
+ * The transfer must be running in another thread (see
+ * dsss_transfer_start_async()). The function waits until the transfer has
+ * written 'samples_size' IQ samples (I and Q interleaved, as
+ * 'complex float') in 'samples', copying them once from its own buffer, and
+ * returns the number of samples written. When the transfer is finished, the function returns fewer
+ * samples (or 0).
+ */
+unsigned int dsss_transfer_pull_samples(dsss_transfer_t transfer,
+                                        float *samples,
+                                        unsigned int samples_size);
+
+/* Interrupt a transfer. This function can be called from any thread. */
 void dsss_transfer_stop(dsss_transfer_t transfer);
 
 /* Interrupt all transfers */
@@ -23,18 +23,182 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <liquid/liquid.h>
 
+#define DSSSFRAME_PROTOCOL 102
+#define DSSSFRAME_H_USER_DEFAULT 8
+#define DSSSFRAME_H_DEC 5
+#define DSSSFRAME_H_CRC LIQUID_CRC_32
+#define DSSSFRAME_H_FEC0 LIQUID_FEC_GOLAY2412
+#define DSSSFRAME_H_FEC1 LIQUID_FEC_NONE
+#define DSSSFRAME_PREAMBLE_LEN 64
+#define DSSSFRAME_PREAMBLE_LEN_MIN 16
+#define DSSSFRAME_PREAMBLE_LEN_MAX 1024
+
+// flag in the header indicating that the frame is immediately followed by
+// another frame without preamble
+#define DSSSFRAME_CONTINUED 0x80
+
+// maximum number of frames over which the payloads can be interleaved
+#define DSSSFRAME_INTERLEAVER_DEPTH_MAX 16
+
+// the frames of an interleaver block have their own protocol number and two
+// more bytes in the header (block depth and frame index, block number); the
+// other frames keep the original header
+#define DSSSFRAME_PROTOCOL_INTERLEAVED 103
+#define DSSSFRAME_H_DEC_INTERLEAVED 7
+
+// create the m-sequence of the preamble; the degree of the sequence grows
+// with the preamble length so that long preambles are not periodic
+//  _len        :   preamble length
+msequence dsssframe_create_preamble_msequence(unsigned int _len);
+
+// generate the preamble p/n sequence
+//  _preamble   :   preamble symbols [size: _len x 1]
+//  _len        :   preamble length
+int dsssframe_generate_preamble(float complex * _preamble, unsigned int _len);
+
+// generate the spreading code
+//  _pn     :   chips [size: _len x 1]
+//  _len    :   spreading factor
+int dsssframe_generate_pn(float complex * _pn, unsigned int _len);
+
+//
+// DSSS frame generator
+//
+
+typedef struct dsss_framegen_s * dsss_framegen;
+
 // create DSSS frame generator with specific parameter
 //  _n       :   spreading factor
 //  _props   :   frame properties (FEC, etc.)
-dsssframegen dsssframegen_create_set(unsigned int _n,
-                                     dsssframegenprops_s * _props);
+dsss_framegen dsss_framegen_create(unsigned int _n,
+                                   dsssframegenprops_s * _props);
+
+int dsss_framegen_destroy(dsss_framegen _q);
+int dsss_framegen_reset(dsss_framegen _q);
+int dsss_framegen_is_assembled(dsss_framegen _q);
+int dsss_framegen_setprops(dsss_framegen _q, dsssframegenprops_s * _props);
+int dsss_framegen_set_header_props(dsss_framegen _q, dsssframegenprops_s * _props);
+int dsss_framegen_set_header_len(dsss_framegen _q, unsigned int _len);
+
+// set the number of symbols of the preamble
+int dsss_framegen_set_preamble_len(dsss_framegen _q, unsigned int _len);
+
+// set whether the next frames assembled will be immediately followed by
+// another frame; the frame following a continued frame is sent without
+// preamble, and the synchronizer stays locked from one frame to the next
+int dsss_framegen_set_continued(dsss_framegen _q, int _continued);
+
+// set the number of consecutive frames over which the payloads are
+// interleaved, so that a burst of errors destroying a whole frame only
+// destroys a part of the payloads of several frames; the FEC of the payloads
+// is then able to correct the missing parts, which are marked as erasures by
+// the synchronizer
+//  _depth           :   number of frames in an interleaver block (1: none)
+//  _payload_len_max :   maximum payload length (the payloads are padded)
+int dsss_framegen_set_interleaving(dsss_framegen _q,
+                                   unsigned int  _depth,
+                                   unsigned int  _payload_len_max);
+
+// when interleaving, start writing the frames of the current interleaver
+// block even if it is not full
+int dsss_framegen_flush(dsss_framegen _q);
+
+// assemble a frame from an array of data; when interleaving, the frames are
+// available only when the interleaver block is full (or flushed)
+//  _header         :   frame header
+//  _payload        :   payload data [size: _payload_len x 1]
+//  _payload_len    :   payload data length
+int dsss_framegen_assemble(dsss_framegen          _q,
+                           const unsigned char *  _header,
+                           const unsigned char *  _payload,
+                           unsigned int           _payload_len);
+
+// write samples of assembled frame; returns 1 when the frame is complete
+//  _buffer     :   output buffer [size: _buffer_len x 1]
+//  _buffer_len :   output buffer length
+int dsss_framegen_write_samples(dsss_framegen   _q,
+                                float complex * _buffer,
+                                unsigned int    _buffer_len);
+
+// get the number of samples belonging to the frame in the buffer written by
+// the call to dsss_framegen_write_samples() that completed the frame
+unsigned int dsss_framegen_get_frame_end(dsss_framegen _q);
+
+//
+// DSSS frame synchronizer
+//
+
+typedef struct dsss_framesync_s * dsss_framesync;
 
 // create DSSS frame synchronizer
 //  _n          :   spreading factor
 //  _callback   :   callback function
 //  _userdata   :   user data pointer passed to callback function
-dsssframesync dsssframesync_create_set(unsigned int _n,
-                                       framesync_callback _callback,
-                                       void * _userdata);
+dsss_framesync dsss_framesync_create(unsigned int _n,
+                                     framesync_callback _callback,
+                                     void * _userdata);
+
+int dsss_framesync_destroy(dsss_framesync _q);
+int dsss_framesync_reset(dsss_framesync _q);
+int dsss_framesync_is_frame_open(dsss_framesync _q);
+
+// set the callback function and its user data, to be able to reuse the
+// synchronizer (and its filter and detector designs) for another receiver
+int dsss_framesync_set_callback(dsss_framesync     _q,
+                                framesync_callback _callback,
+                                void *             _userdata);
+
+int dsss_framesync_set_header_props(dsss_framesync _q, dsssframegenprops_s * _props);
+int dsss_framesync_set_header_len(dsss_framesync _q, unsigned int _len);
+
+// set the number of symbols of the preamble (must be the same as the one used
+// by the frame generator)
+int dsss_framesync_set_preamble_len(dsss_framesync _q, unsigned int _len);
+
+// set the threshold of the preamble detector (between 0 and 1); a lower
+// threshold detects weaker frames, but gives more false alarms
+int dsss_framesync_set_threshold(dsss_framesync _q, float _threshold);
+
+// enable/disable the tracking of the carrier and timing across frames; when
+// enabled, the preamble of the next frame is searched only around the
+// position where it is expected, and the carrier frequency, phase, timing
+// and gain estimates of the previous frame are reused
+int dsss_framesync_set_tracking(dsss_framesync _q, int _tracking);
+
+// get the number of frames found by tracking the previous frame
+unsigned int dsss_framesync_get_frames_tracked(dsss_framesync _q);
+
+// get the number of times the next frame was not found by tracking and the
+// synchronizer had to search for it with the preamble detector
+unsigned int dsss_framesync_get_tracking_losses(dsss_framesync _q);
+
+// enable the soft combining of the copies of the frames: the symbols of the
+// payloads that could not be decoded are kept for the _len last such frames,
+// and averaged with the symbols of the next copies of the same frames before
+// decoding them again; a frame is identified by the bytes of its user header
+// selected by _mask [size: header_len x 1] (must be called after
+// dsss_framesync_set_header_len()); _len = 0 disables the combining
+int dsss_framesync_set_combining(dsss_framesync        _q,
+                                 unsigned int          _len,
+                                 const unsigned char * _mask);
+
+// get the number of payloads decoded by combining several copies of a frame
+unsigned int dsss_framesync_get_frames_combined(dsss_framesync _q);
+
+// execute frame synchronizer
+//  _x  :   input sample array [size: _n x 1]
+//  _n  :   number of input samples
+int dsss_framesync_execute(dsss_framesync _q,
+                           float complex * _x,
+                           unsigned int _n);
+
+// decode the payloads of the current interleaver block even if some of its
+// frames have not been received yet
+int dsss_framesync_flush(dsss_framesync _q);
+
+// reset the frame data statistics, and the numbers of frames tracked and
+// combined
+int dsss_framesync_reset_framedatastats(dsss_framesync _q);
+framedatastats_s dsss_framesync_get_framedatastats(dsss_framesync _q);
 
 #endif
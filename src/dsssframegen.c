@@ -19,7 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 This file includes a variation of the code from the liquid-dsp library to
-create a dsssframegen object. The original code has the following license:
+generate DSSS frames. The original code has the following license:
 
 Copyright (c) 2007 - 2020 Joseph Gaeddert
 
@@ -47,9 +47,9 @@ THE SOFTWARE.
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define DSSSFRAME_H_USER_DEFAULT 8
-#define DSSSFRAME_H_DEC 5
+#include "dsssframe.h"
 
 enum state {
     STATE_PREAMBLE = 0, // write preamble p/n sequence
@@ -58,7 +58,7 @@ enum state {
     STATE_TAIL,         // tail symbols
 };
 
-struct dsssframegen_s {
+struct dsss_framegen_s {
     // interpolator
     unsigned int        k;             // interp samples/symbol (fixed at 2)
     unsigned int        m;             // interp filter delay (symbols)
@@ -68,11 +68,15 @@ struct dsssframegen_s {
 
     dsssframegenprops_s props;        // payload properties
     dsssframegenprops_s header_props; // header properties
+    dsssframegenprops_s frame_props;  // payload properties of current frame
 
     // preamble
-    float complex *     preamble_pn; // p/n sequence
-    synth_crcf          header_synth;
-    synth_crcf          payload_synth;
+    float complex *     preamble_pn;  // p/n sequence
+    unsigned int        preamble_len; // p/n sequence length
+
+    // spreading code
+    float complex *     pn;     // chips of the spreading code
+    unsigned int        pn_len; // spreading factor
 
     // header
     unsigned char *     header;          // header data
@@ -80,6 +84,9 @@ struct dsssframegen_s {
     unsigned int        header_dec_len;  // header length (decoded)
     qpacketmodem        header_encoder;  // header encoder/modulator
     unsigned int        header_mod_len;  // header length
+    qpacketmodem        header_il_encoder; // header encoder/modulator (interleaved frames)
+    unsigned int        header_il_mod_len; // header length (interleaved frames)
+    unsigned int        frame_header_mod_len; // header length of current frame
     float complex *     header_mod;
 
     // payload
@@ -88,27 +95,57 @@ struct dsssframegen_s {
     unsigned int        payload_mod_len;
     float complex *     payload_mod;
 
+    // interleaving of the payloads across frames
+    unsigned int        il_depth;        // frames per interleaver block
+    unsigned int        il_payload_len;  // maximum payload length
+    unsigned int        il_count;        // codewords in the current block
+    unsigned int        il_index;        // next frame of the block to write
+    unsigned int        il_block;        // block number
+    dsssframegenprops_s il_props;        // payload properties of the block
+    int                 il_writing;      // frames of the block being written
+    unsigned char *     il_headers;      // user headers of the codewords
+    int *               il_continued;    // continued flags of the codewords
+    unsigned char *     il_codeword;     // header, length and padded payload
+    float complex *     il_mod;          // modulated codewords [il_depth x payload_mod_len]
+    unsigned int        frame_il_depth;  // frames in the block of current frame
+    unsigned int        frame_il_index;  // index of current frame in its block
+
     // counters/states
-    unsigned int        symbol_counter; // output symbol number
-    unsigned int        sample_counter; // output sample number
-    unsigned int        bit_counter;    // output bit number
-    int                 bit_high;       // current bit is 1
-    float complex       sym;
+    unsigned int        symbol_counter;  // output symbol number
+    unsigned int        chip_counter;    // output chip number
+    unsigned int        sample_counter;  // output sample number
     int                 frame_assembled; // frame assembled flag
     int                 frame_complete;  // frame completed flag
+    int                 tail_complete;   // last tail symbol generated flag
+    int                 continued;       // next frame assembled will be continued
+    int                 frame_continued; // current frame is followed by another frame
+    unsigned int        frame_end;       // number of frame samples in last buffer
     enum state          state;           // write state
 };
 
-dsssframegen dsssframegen_create_set(unsigned int _n,
-                                     dsssframegenprops_s * _fgprops)
+static dsssframegenprops_s dsss_framegenprops_default = {
+    LIQUID_CRC_16,
+    LIQUID_FEC_NONE,
+    LIQUID_FEC_NONE,
+};
+
+static dsssframegenprops_s dsss_framegenprops_header_default = {
+    DSSSFRAME_H_CRC,
+    DSSSFRAME_H_FEC0,
+    DSSSFRAME_H_FEC1,
+};
+
+dsss_framegen dsss_framegen_create(unsigned int _n,
+                                   dsssframegenprops_s * _fgprops)
 {
     if ((_n < 2) || (_n > 64)) {
-        fprintf(stderr, "dsssframegen_create_set(), spreading factor must be between 2 and 64");
+        fprintf(stderr, "dsss_framegen_create(), spreading factor must be between 2 and 64\n");
         return NULL;
     }
 
-    dsssframegen q = (dsssframegen)calloc(1, sizeof(struct dsssframegen_s));
-    unsigned int i;
+    dsss_framegen q = (dsss_framegen)calloc(1, sizeof(struct dsss_framegen_s));
+    if (q == NULL)
+        return NULL;
 
     // create pulse-shaping filter
     q->k      = 2;
@@ -116,42 +153,547 @@ dsssframegen dsssframegen_create_set(unsigned int _n,
     q->beta   = 0.25f;
     q->interp = firinterp_crcf_create_prototype(LIQUID_FIRFILT_ARKAISER, q->k, q->m, q->beta, 0);
 
-    // generate pn sequence
-    q->preamble_pn = (float complex *)malloc(64 * sizeof(float complex));
-    msequence ms   = msequence_create(7, 0x0089, 1);
-    for (i = 0; i < 64; i++) {
-        q->preamble_pn[i] = (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2);
-        q->preamble_pn[i] += (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2) * _Complex_I;
-    }
-    msequence_destroy(ms);
-
-    float complex * pn = (float complex *)malloc(_n * sizeof(float complex));
-    ms                        = msequence_create(7, 0x00cb, 0x53);
-    for (i = 0; i < _n; i++) {
-        pn[i] = (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2);
-        pn[i] += (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2) * _Complex_I;
-    }
-    q->header_synth  = synth_crcf_create(pn, _n);
-    q->payload_synth = synth_crcf_create(pn, _n);
-    free(pn);
-    msequence_destroy(ms);
-
-    dsssframegen_reset(q);
+    // generate pn sequences
+    q->pn_len = _n;
+    q->pn     = (float complex *)malloc(q->pn_len * sizeof(float complex));
+    dsssframe_generate_pn(q->pn, q->pn_len);
 
     q->header          = NULL;
     q->header_user_len = DSSSFRAME_H_USER_DEFAULT;
     q->header_dec_len  = DSSSFRAME_H_DEC + q->header_user_len;
     q->header_mod      = NULL;
     q->header_encoder  = qpacketmodem_create();
+    q->header_il_encoder = qpacketmodem_create();
 
     q->payload_encoder = qpacketmodem_create();
     q->payload_dec_len = 0;
     q->payload_mod_len = 0;
     q->payload_mod     = NULL;
 
-    dsssframegen_setprops(q, _fgprops);
-    dsssframegen_set_header_props(q, NULL);
-    dsssframegen_set_header_len(q, q->header_user_len);
+    q->il_depth       = 1;
+    q->frame_il_depth = 1;
+    q->il_continued   = (int *)calloc(DSSSFRAME_INTERLEAVER_DEPTH_MAX, sizeof(int));
+
+    dsss_framegen_reset(q);
+    dsss_framegen_set_preamble_len(q, DSSSFRAME_PREAMBLE_LEN);
+    dsss_framegen_setprops(q, _fgprops);
+    dsss_framegen_set_header_props(q, NULL);
+    dsss_framegen_set_header_len(q, q->header_user_len);
 
     return q;
 }
+
+int dsss_framegen_destroy(dsss_framegen _q)
+{
+    if (_q == NULL)
+        return 0;
+
+    firinterp_crcf_destroy(_q->interp);
+    qpacketmodem_destroy(_q->header_encoder);
+    qpacketmodem_destroy(_q->header_il_encoder);
+    qpacketmodem_destroy(_q->payload_encoder);
+    free(_q->preamble_pn);
+    free(_q->pn);
+    free(_q->header);
+    free(_q->header_mod);
+    free(_q->payload_mod);
+    free(_q->il_headers);
+    free(_q->il_continued);
+    free(_q->il_codeword);
+    free(_q->il_mod);
+    free(_q);
+    return 0;
+}
+
+int dsss_framegen_reset(dsss_framegen _q)
+{
+    _q->symbol_counter  = 0;
+    _q->chip_counter    = 0;
+    _q->sample_counter  = 0;
+    _q->frame_assembled = 0;
+    _q->frame_complete  = 0;
+    _q->tail_complete   = 0;
+    _q->frame_continued = 0;
+    _q->frame_end       = 0;
+    _q->state           = STATE_PREAMBLE;
+    return 0;
+}
+
+int dsss_framegen_is_assembled(dsss_framegen _q)
+{
+    return _q->frame_assembled;
+}
+
+int dsss_framegen_setprops(dsss_framegen _q, dsssframegenprops_s * _props)
+{
+    if (_q->frame_assembled) {
+        fprintf(stderr, "dsss_framegen_setprops(), frame is already assembled; must reset() first\n");
+        return -1;
+    }
+
+    if (_props == NULL)
+        _props = &dsss_framegenprops_default;
+
+    if ((_props->check == LIQUID_CRC_UNKNOWN) || (_props->check >= LIQUID_CRC_NUM_SCHEMES)) {
+        fprintf(stderr, "dsss_framegen_setprops(), invalid/unsupported CRC scheme\n");
+        return -1;
+    }
+    if ((_props->fec0 == LIQUID_FEC_UNKNOWN) || (_props->fec1 == LIQUID_FEC_UNKNOWN)) {
+        fprintf(stderr, "dsss_framegen_setprops(), invalid/unsupported FEC scheme\n");
+        return -1;
+    }
+
+    memmove(&_q->props, _props, sizeof(dsssframegenprops_s));
+    return 0;
+}
+
+int dsss_framegen_set_header_props(dsss_framegen _q, dsssframegenprops_s * _props)
+{
+    if (_q->frame_assembled) {
+        fprintf(stderr, "dsss_framegen_set_header_props(), frame is already assembled; must reset() first\n");
+        return -1;
+    }
+
+    if (_props == NULL)
+        _props = &dsss_framegenprops_header_default;
+
+    if ((_props->check == LIQUID_CRC_UNKNOWN) || (_props->check >= LIQUID_CRC_NUM_SCHEMES)) {
+        fprintf(stderr, "dsss_framegen_set_header_props(), invalid/unsupported CRC scheme\n");
+        return -1;
+    }
+    if ((_props->fec0 == LIQUID_FEC_UNKNOWN) || (_props->fec1 == LIQUID_FEC_UNKNOWN)) {
+        fprintf(stderr, "dsss_framegen_set_header_props(), invalid/unsupported FEC scheme\n");
+        return -1;
+    }
+
+    memmove(&_q->header_props, _props, sizeof(dsssframegenprops_s));
+    return dsss_framegen_set_header_len(_q, _q->header_user_len);
+}
+
+int dsss_framegen_set_preamble_len(dsss_framegen _q, unsigned int _len)
+{
+    if (_q->frame_assembled) {
+        fprintf(stderr, "dsss_framegen_set_preamble_len(), frame is already assembled; must reset() first\n");
+        return -1;
+    }
+    if ((_len < DSSSFRAME_PREAMBLE_LEN_MIN) || (_len > DSSSFRAME_PREAMBLE_LEN_MAX)) {
+        fprintf(stderr, "dsss_framegen_set_preamble_len(), preamble length must be between %u and %u\n",
+                DSSSFRAME_PREAMBLE_LEN_MIN, DSSSFRAME_PREAMBLE_LEN_MAX);
+        return -1;
+    }
+
+    _q->preamble_len = _len;
+    _q->preamble_pn = (float complex *)realloc(_q->preamble_pn, _q->preamble_len * sizeof(float complex));
+    return dsssframe_generate_preamble(_q->preamble_pn, _q->preamble_len);
+}
+
+int dsss_framegen_set_continued(dsss_framegen _q, int _continued)
+{
+    _q->continued = _continued;
+    return 0;
+}
+
+int dsss_framegen_set_header_len(dsss_framegen _q, unsigned int _len)
+{
+    if (_q->frame_assembled) {
+        fprintf(stderr, "dsss_framegen_set_header_len(), frame is already assembled; must reset() first\n");
+        return -1;
+    }
+
+    _q->header_user_len = _len;
+    _q->header_dec_len  = DSSSFRAME_H_DEC + _q->header_user_len;
+    _q->header = (unsigned char *)realloc(_q->header,
+                                          (DSSSFRAME_H_DEC_INTERLEAVED + _q->header_user_len) * sizeof(unsigned char));
+
+    qpacketmodem_configure(_q->header_encoder,
+                           _q->header_dec_len,
+                           _q->header_props.check,
+                           _q->header_props.fec0,
+                           _q->header_props.fec1,
+                           LIQUID_MODEM_BPSK);
+    _q->header_mod_len = qpacketmodem_get_frame_len(_q->header_encoder);
+    qpacketmodem_configure(_q->header_il_encoder,
+                           DSSSFRAME_H_DEC_INTERLEAVED + _q->header_user_len,
+                           _q->header_props.check,
+                           _q->header_props.fec0,
+                           _q->header_props.fec1,
+                           LIQUID_MODEM_BPSK);
+    _q->header_il_mod_len = qpacketmodem_get_frame_len(_q->header_il_encoder);
+    _q->header_mod = (float complex *)realloc(_q->header_mod, _q->header_il_mod_len * sizeof(float complex));
+    return 0;
+}
+
+// encode header: user section followed by the frame description
+static void dsss_framegen_encode_header(dsss_framegen _q, const unsigned char * _header)
+{
+    unsigned int n = _q->header_user_len;
+
+    if (_header == NULL)
+        memset(_q->header, 0x00, n);
+    else
+        memmove(_q->header, _header, n);
+
+    _q->header[n + 0] = DSSSFRAME_PROTOCOL;
+    _q->header[n + 1] = (_q->payload_dec_len >> 8) & 0xff;
+    _q->header[n + 2] = (_q->payload_dec_len) & 0xff;
+    _q->header[n + 3] = (_q->frame_props.check & 0x07) << 5;
+    _q->header[n + 3] |= (_q->frame_props.fec0) & 0x1f;
+    _q->header[n + 4] = (_q->frame_props.fec1) & 0x1f;
+    if (_q->frame_continued)
+        _q->header[n + 4] |= DSSSFRAME_CONTINUED;
+
+    if (_q->frame_il_depth == 1) {
+        _q->frame_header_mod_len = _q->header_mod_len;
+        qpacketmodem_encode(_q->header_encoder, _q->header, _q->header_mod);
+        return;
+    }
+
+    // frame of an interleaver block
+    _q->header[n + 0] = DSSSFRAME_PROTOCOL_INTERLEAVED;
+    _q->header[n + 5] = ((_q->frame_il_depth - 1) << 4) | _q->frame_il_index;
+    _q->header[n + 6] = _q->il_block & 0xff;
+    _q->frame_header_mod_len = _q->header_il_mod_len;
+    qpacketmodem_encode(_q->header_il_encoder, _q->header, _q->header_mod);
+}
+
+// assemble a frame without interleaving
+static int dsss_framegen_assemble_frame(dsss_framegen          _q,
+                                        const unsigned char *  _header,
+                                        const unsigned char *  _payload,
+                                        unsigned int           _payload_len,
+                                        dsssframegenprops_s *  _props,
+                                        int                    _continued)
+{
+    // a frame following a continued frame doesn't have a preamble
+    int follows = _q->frame_continued;
+
+    dsss_framegen_reset(_q);
+    _q->frame_il_depth  = 1;
+    _q->frame_il_index  = 0;
+    _q->frame_continued = _continued;
+    if (follows)
+        _q->state = STATE_HEADER;
+
+    memmove(&_q->frame_props, _props, sizeof(dsssframegenprops_s));
+    _q->payload_dec_len = _payload_len;
+    qpacketmodem_configure(_q->payload_encoder,
+                           _q->payload_dec_len,
+                           _q->frame_props.check,
+                           _q->frame_props.fec0,
+                           _q->frame_props.fec1,
+                           LIQUID_MODEM_BPSK);
+    _q->payload_mod_len = qpacketmodem_get_frame_len(_q->payload_encoder);
+    _q->payload_mod = (float complex *)realloc(_q->payload_mod, _q->payload_mod_len * sizeof(float complex));
+
+    dsss_framegen_encode_header(_q, _header);
+    qpacketmodem_encode(_q->payload_encoder, _payload, _q->payload_mod);
+
+    _q->frame_assembled = 1;
+    return 0;
+}
+
+int dsss_framegen_set_interleaving(dsss_framegen _q,
+                                   unsigned int  _depth,
+                                   unsigned int  _payload_len_max)
+{
+    if (_q->frame_assembled || (_q->il_count > 0)) {
+        fprintf(stderr, "dsss_framegen_set_interleaving(), frame is already assembled; must reset() first\n");
+        return -1;
+    }
+    if ((_depth < 1) || (_depth > DSSSFRAME_INTERLEAVER_DEPTH_MAX)) {
+        fprintf(stderr, "dsss_framegen_set_interleaving(), depth must be between 1 and %u\n",
+                DSSSFRAME_INTERLEAVER_DEPTH_MAX);
+        return -1;
+    }
+    if ((_payload_len_max == 0) || (_payload_len_max > 0xffff)) {
+        fprintf(stderr, "dsss_framegen_set_interleaving(), invalid payload length\n");
+        return -1;
+    }
+
+    _q->il_depth       = _depth;
+    _q->il_payload_len = _payload_len_max;
+    return 0;
+}
+
+// prepare the next frame of the interleaver block; the symbol i of the frame
+// f is the symbol i of the codeword (f + i) mod n, so the symbols of each
+// codeword are spread evenly over the n frames of the block
+static void dsss_framegen_assemble_block_frame(dsss_framegen _q)
+{
+    unsigned int f        = _q->il_index;
+    unsigned int n        = _q->il_count;
+    unsigned int len      = _q->payload_mod_len;
+    unsigned int end      = _q->frame_end;
+    int          follows  = _q->frame_continued;
+    unsigned int i;
+
+    dsss_framegen_reset(_q);
+    _q->frame_end = end;
+    // the last frame of a block can't be continued because the next block is
+    // not ready yet
+    _q->frame_continued = _q->il_continued[f] && (f + 1 < n);
+    if (follows)
+        _q->state = STATE_HEADER;
+
+    for (i = 0; i < len; i++)
+        _q->payload_mod[i] = _q->il_mod[(((f + i) % n) * len) + i];
+
+    memmove(&_q->frame_props, &_q->il_props, sizeof(dsssframegenprops_s));
+    _q->payload_dec_len = _q->il_payload_len;
+    _q->frame_il_depth  = n;
+    _q->frame_il_index  = f;
+    dsss_framegen_encode_header(_q, &_q->il_headers[f * _q->header_user_len]);
+    _q->frame_assembled = 1;
+    _q->il_index++;
+}
+
+int dsss_framegen_flush(dsss_framegen _q)
+{
+    unsigned int n = _q->header_user_len;
+
+    if ((_q->il_count == 0) || _q->il_writing)
+        return 0;
+
+    if (_q->il_count == 1) {
+        // a single frame is sent without interleaving (its codeword is still
+        // in the codeword buffer)
+        _q->il_count = 0;
+        return dsss_framegen_assemble_frame(_q,
+                                            _q->il_codeword,
+                                            &_q->il_codeword[n + 2],
+                                            (_q->il_codeword[n] << 8) | _q->il_codeword[n + 1],
+                                            &_q->il_props,
+                                            0);
+    }
+
+    _q->il_writing = 1;
+    _q->il_index   = 0;
+    dsss_framegen_assemble_block_frame(_q);
+    return 0;
+}
+
+// add a codeword to the interleaver block
+static int dsss_framegen_queue(dsss_framegen          _q,
+                               const unsigned char *  _header,
+                               const unsigned char *  _payload,
+                               unsigned int           _payload_len)
+{
+    unsigned int n = _q->header_user_len;
+    unsigned int codeword_len = n + 2 + _q->il_payload_len;
+
+    if (_q->il_writing) {
+        fprintf(stderr, "dsss_framegen_assemble(), interleaver block is being written\n");
+        return -1;
+    }
+    if (_payload_len > _q->il_payload_len) {
+        fprintf(stderr, "dsss_framegen_assemble(), payload is too long for the interleaver\n");
+        return -1;
+    }
+
+    if (_q->il_count == 0) {
+        // the properties can change between blocks, but not inside a block
+        memmove(&_q->il_props, &_q->props, sizeof(dsssframegenprops_s));
+        qpacketmodem_configure(_q->payload_encoder,
+                               codeword_len,
+                               _q->props.check,
+                               _q->props.fec0,
+                               _q->props.fec1,
+                               LIQUID_MODEM_BPSK);
+        _q->payload_mod_len = qpacketmodem_get_frame_len(_q->payload_encoder);
+        _q->payload_mod = (float complex *)realloc(_q->payload_mod, _q->payload_mod_len * sizeof(float complex));
+        _q->il_mod = (float complex *)realloc(_q->il_mod, _q->il_depth * _q->payload_mod_len * sizeof(float complex));
+        _q->il_headers = (unsigned char *)realloc(_q->il_headers, _q->il_depth * n);
+        _q->il_codeword = (unsigned char *)realloc(_q->il_codeword, codeword_len);
+    }
+
+    // the user header and the real length of the payload are sent in the
+    // codeword, so that they can be recovered even if the frame is lost
+    if (_header == NULL)
+        memset(_q->il_codeword, 0x00, n);
+    else
+        memmove(_q->il_codeword, _header, n);
+    memmove(&_q->il_headers[_q->il_count * n], _q->il_codeword, n);
+    _q->il_codeword[n + 0] = (_payload_len >> 8) & 0xff;
+    _q->il_codeword[n + 1] = _payload_len & 0xff;
+    memmove(&_q->il_codeword[n + 2], _payload, _payload_len);
+    memset(&_q->il_codeword[n + 2 + _payload_len], 0x00, _q->il_payload_len - _payload_len);
+    qpacketmodem_encode(_q->payload_encoder,
+                        _q->il_codeword,
+                        &_q->il_mod[_q->il_count * _q->payload_mod_len]);
+    _q->il_continued[_q->il_count] = _q->continued;
+    _q->il_count++;
+
+    if (_q->il_count == _q->il_depth)
+        dsss_framegen_flush(_q);
+    return 0;
+}
+
+int dsss_framegen_assemble(dsss_framegen          _q,
+                           const unsigned char *  _header,
+                           const unsigned char *  _payload,
+                           unsigned int           _payload_len)
+{
+    if (_q->il_depth > 1)
+        return dsss_framegen_queue(_q, _header, _payload, _payload_len);
+
+    return dsss_framegen_assemble_frame(_q, _header, _payload, _payload_len,
+                                        &_q->props, _q->continued);
+}
+
+// spread a modulated symbol with the current chip of the p/n sequence;
+// returns 1 when the last chip of the symbol has been generated
+static int dsss_framegen_spread(dsss_framegen _q, float complex _sym, float complex * _chip)
+{
+    *_chip = _sym * _q->pn[_q->chip_counter];
+    _q->chip_counter++;
+    if (_q->chip_counter < _q->pn_len)
+        return 0;
+
+    _q->chip_counter = 0;
+    return 1;
+}
+
+static float complex dsss_framegen_generate_symbol(dsss_framegen _q)
+{
+    float complex chip = 0.0f;
+
+    if (!_q->frame_assembled)
+        return 0.0f;
+
+    switch (_q->state) {
+    case STATE_PREAMBLE:
+        chip = _q->preamble_pn[_q->symbol_counter];
+        _q->symbol_counter++;
+        if (_q->symbol_counter == _q->preamble_len) {
+            _q->symbol_counter = 0;
+            _q->state          = STATE_HEADER;
+        }
+        break;
+
+    case STATE_HEADER:
+        if (dsss_framegen_spread(_q, _q->header_mod[_q->symbol_counter], &chip)) {
+            _q->symbol_counter++;
+            if (_q->symbol_counter == _q->frame_header_mod_len) {
+                _q->symbol_counter = 0;
+                _q->state          = STATE_PAYLOAD;
+            }
+        }
+        break;
+
+    case STATE_PAYLOAD:
+        if (dsss_framegen_spread(_q, _q->payload_mod[_q->symbol_counter], &chip)) {
+            _q->symbol_counter++;
+            if (_q->symbol_counter == _q->payload_mod_len) {
+                _q->symbol_counter = 0;
+                _q->state          = STATE_TAIL;
+                if (_q->frame_continued) {
+                    // the header of the next frame replaces the tail
+                    _q->tail_complete   = 1;
+                    _q->frame_assembled = 0;
+                }
+            }
+        }
+        break;
+
+    case STATE_TAIL:
+        // flush the interpolator
+        _q->symbol_counter++;
+        if (_q->symbol_counter == 2 * _q->m) {
+            _q->tail_complete   = 1;
+            _q->frame_assembled = 0;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return chip;
+}
+
+int dsss_framegen_write_samples(dsss_framegen   _q,
+                                float complex * _buffer,
+                                unsigned int    _buffer_len)
+{
+    unsigned int i;
+
+    _q->frame_complete = 0;
+    for (i = 0; i < _buffer_len; i++) {
+        if (_q->frame_complete) {
+            // keep the interpolator state for the next frame
+            _buffer[i] = 0.0f;
+            continue;
+        }
+
+        if (_q->sample_counter == 0)
+            firinterp_crcf_execute(_q->interp, dsss_framegen_generate_symbol(_q), _q->buf_interp);
+
+        _buffer[i] = _q->buf_interp[_q->sample_counter];
+        _q->sample_counter = (_q->sample_counter + 1) % _q->k;
+
+        if (_q->tail_complete && (_q->sample_counter == 0)) {
+            // all the samples of the last tail symbol have been written
+            _q->tail_complete  = 0;
+            _q->frame_complete = 1;
+            _q->frame_end      = i + 1;
+        }
+    }
+
+    if (_q->frame_complete && _q->il_writing) {
+        if (_q->il_index < _q->il_count) {
+            dsss_framegen_assemble_block_frame(_q);
+        } else {
+            _q->il_writing = 0;
+            _q->il_count   = 0;
+            _q->il_index   = 0;
+            _q->il_block++;
+        }
+    }
+
+    return _q->frame_complete;
+}
+
+unsigned int dsss_framegen_get_frame_end(dsss_framegen _q)
+{
+    return _q->frame_end;
+}
+
+msequence dsssframe_create_preamble_msequence(unsigned int _len)
+{
+    unsigned int m;
+
+    // keep the original sequence for the default preamble length
+    if (_len <= DSSSFRAME_PREAMBLE_LEN)
+        return msequence_create(7, 0x0089, 1);
+
+    // each symbol uses 2 bits, the period must be longer than the preamble
+    for (m = 8; ((1U << m) - 1) < (2 * _len); m++)
+        ;
+    return msequence_create_default(m);
+}
+
+int dsssframe_generate_preamble(float complex * _preamble, unsigned int _len)
+{
+    unsigned int i;
+    msequence ms = dsssframe_create_preamble_msequence(_len);
+
+    for (i = 0; i < _len; i++) {
+        _preamble[i] = (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2);
+        _preamble[i] += (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2) * _Complex_I;
+    }
+    msequence_destroy(ms);
+    return 0;
+}
+
+int dsssframe_generate_pn(float complex * _pn, unsigned int _len)
+{
+    unsigned int i;
+    msequence ms = msequence_create(7, 0x00cb, 0x53);
+
+    for (i = 0; i < _len; i++) {
+        _pn[i] = (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2);
+        _pn[i] += (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2) * _Complex_I;
+    }
+    msequence_destroy(ms);
+    return 0;
+}
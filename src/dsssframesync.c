@@ -19,7 +19,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 This file includes a variation of the code from the liquid-dsp library to
-create a dsssframesync object. The original code has the following license:
+synchronize and decode DSSS frames. The original code has the following
+license:
 
 Copyright (c) 2007 - 2020 Joseph Gaeddert
 
@@ -47,17 +48,51 @@ THE SOFTWARE.
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-#define DSSSFRAME_H_USER_DEFAULT 8
+#include "dsssframe.h"
+
+// bandwidth of the carrier phase tracking loop (per despread symbol)
+#define DSSSFRAMESYNC_PLL_ALPHA 0.1f
+#define DSSSFRAMESYNC_PLL_BETA (0.25f * DSSSFRAMESYNC_PLL_ALPHA * DSSSFRAMESYNC_PLL_ALPHA)
+
+// maximum distance between the expected and the actual position of the
+// preamble of the next frame in tracking mode (chips)
+#define DSSSFRAMESYNC_TRACK_WINDOW 8
+
+// default threshold of the preamble detector
+#define DSSSFRAMESYNC_THRESHOLD_DEFAULT 0.5f
+
+// minimum normalized correlation of the preamble in tracking mode
+#define DSSSFRAMESYNC_TRACK_THRESHOLD 0.5f
+
+// slope of the raised-cosine pulse at +/- 1 chip
+#define DSSSFRAMESYNC_PULSE_SLOPE 0.94f
+
+// soft symbols of a frame whose payload could not be decoded, kept to be
+// combined with the next copies of the same frame
+typedef struct {
+    unsigned char * key;          // user header bytes identifying the frame
+    unsigned int    payload_len;
+    unsigned int    mod_len;
+    unsigned int    check;
+    unsigned int    fec0;
+    unsigned int    fec1;
+    unsigned int    copies;       // copies received (0: free slot)
+    unsigned long   last_use;
+    float complex * sum;          // sum of the symbols of the copies
+    unsigned int    sum_size;
+} dsss_framesync_copy_s;
 
 enum state {
     DSSSFRAMESYNC_STATE_DETECTFRAME = 0,
     DSSSFRAMESYNC_STATE_RXPREAMBLE,
     DSSSFRAMESYNC_STATE_RXHEADER,
     DSSSFRAMESYNC_STATE_RXPAYLOAD,
+    DSSSFRAMESYNC_STATE_TRACKFRAME,
 };
 
-struct dsssframesync_s {
+struct dsss_framesync_s {
     framesync_callback  callback;
     void *              userdata;
     framesyncstats_s    framesyncstats;
@@ -67,6 +102,7 @@ struct dsssframesync_s {
     unsigned int        m;
     float               beta;
     qdetector_cccf      detector;
+    float               threshold;
     float               tau_hat;
     float               dphi_hat;
     float               phi_hat;
@@ -81,94 +117,1054 @@ struct dsssframesync_s {
 
     float complex *     preamble_pn;
     float complex *     preamble_rx;
-    synth_crcf          header_synth;
-    synth_crcf          payload_synth;
+    unsigned int        preamble_len;
+
+    float complex *     pn;
+    unsigned int        pn_len;
+    float complex       despread;
+    unsigned int        chip_counter;
 
-    int                 header_soft;
-    flexframegenprops_s header_props;
-    float complex *     header_spread;
-    unsigned int        header_spread_len;
+    dsssframegenprops_s header_props;
     qpacketmodem        header_decoder;
+    qpacketmodem        header_il_decoder;  // header decoder of interleaved frames
     unsigned int        header_user_len;
     unsigned int        header_dec_len;
+    unsigned int        header_mod_len;
+    unsigned int        header_il_mod_len;  // header length of interleaved frames
+    float complex *     header_mod;
     unsigned char *     header_dec;
     int                 header_valid;
 
-    int                 payload_soft;
-    float complex *     payload_spread;
-    unsigned int        payload_spread_len;
     qpacketmodem        payload_decoder;
     unsigned int        payload_dec_len;
+    unsigned int        payload_mod_len;
+    float complex *     payload_mod;
     unsigned char *     payload_dec;
     int                 payload_valid;
+    int                 frame_continued;
+    unsigned int        frame_il_depth;   // frames in the interleaver block of the frame
+    unsigned int        frame_il_index;   // index of the frame in its block
+    unsigned int        frame_il_block;   // interleaver block number
+
+    // deinterleaving of the payloads across frames
+    qpacketmodem        il_decoder;
+    unsigned int        il_depth;         // frames in the current block (0: no block)
+    unsigned int        il_block;
+    unsigned int        il_payload_len;
+    unsigned int        il_mod_len;
+    unsigned int        il_check;
+    unsigned int        il_fec0;
+    unsigned int        il_fec1;
+    float complex *     il_mod;           // received frames [il_depth x il_mod_len]
+    float complex *     il_symbols;       // symbols of a codeword
+    unsigned char *     il_codeword;
+    unsigned char       il_received[DSSSFRAME_INTERLEAVER_DEPTH_MAX];
+
+    // soft combining of the copies of the frames
+    dsss_framesync_copy_s * copies;
+    unsigned int        copies_len;       // frames kept (0: no combining)
+    unsigned char *     copies_mask;      // mask of the user header bytes identifying a frame
+    unsigned char *     copies_key;
+    unsigned long       copies_clock;
+    unsigned int        frames_combined;
 
     unsigned int        preamble_counter;
     unsigned int        symbol_counter;
     enum state          state;
+
+    // tracking of the carrier and timing across frames
+    int                 tracking;
+    unsigned int        track_window;
+    float complex *     track_chips;      // chips received after the previous frame
+    unsigned int        track_chips_len;
+    unsigned int        track_chips_size;
+    float complex *     track_buf;        // input samples received after the previous frame
+    unsigned int        track_buf_len;
+    unsigned int        track_buf_size;
+    float complex *     replay;           // input samples to search again with the detector
+    unsigned int        replay_len;
+    unsigned int        replay_index;
+    unsigned int        frames_tracked;
+    unsigned int        tracking_losses;
+};
+
+static dsssframegenprops_s dsss_framesyncprops_header_default = {
+    DSSSFRAME_H_CRC,
+    DSSSFRAME_H_FEC0,
+    DSSSFRAME_H_FEC1,
 };
 
-dsssframesync dsssframesync_create_set(unsigned int _n,
-                                       framesync_callback _callback,
-                                       void * _userdata)
+static void dsss_framesync_execute_sample(dsss_framesync _q, float complex _x);
+
+dsss_framesync dsss_framesync_create(unsigned int _n,
+                                     framesync_callback _callback,
+                                     void * _userdata)
 {
     if ((_n < 2) || (_n > 64)) {
-        fprintf(stderr, "dsssframesync_create_set(), spreading factor must be between 2 and 64");
+        fprintf(stderr, "dsss_framesync_create(), spreading factor must be between 2 and 64\n");
         return NULL;
     }
 
-    dsssframesync q = (dsssframesync)calloc(1, sizeof(struct dsssframesync_s));
-    q->callback     = _callback;
-    q->userdata     = _userdata;
+    dsss_framesync q = (dsss_framesync)calloc(1, sizeof(struct dsss_framesync_s));
+    if (q == NULL)
+        return NULL;
+
+    q->callback = _callback;
+    q->userdata = _userdata;
 
     q->k    = 2;
     q->m    = 7;
     q->beta = 0.3f;
 
-    unsigned int i;
-    q->preamble_pn = (float complex *)calloc(64, sizeof(float complex));
-    q->preamble_rx = (float complex *)calloc(64, sizeof(float complex));
-    msequence ms   = msequence_create(7, 0x0089, 1);
-    for (i = 0; i < 64; i++) {
-        q->preamble_pn[i] = (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2);
-        q->preamble_pn[i] += (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2) * _Complex_I;
-    }
-    msequence_destroy(ms);
-
-    float complex * pn = (float complex *)calloc(_n, sizeof(float complex));
-    ms                        = msequence_create(7, 0x00cb, 0x53);
-    for (i = 0; i < _n; i++) {
-        pn[i] = (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2);
-        pn[i] += (msequence_advance(ms) ? M_SQRT1_2 : -M_SQRT1_2) * _Complex_I;
-    }
-    q->header_synth  = synth_crcf_create(pn, _n);
-    q->payload_synth = synth_crcf_create(pn, _n);
-    synth_crcf_pll_set_bandwidth(q->header_synth, 1e-4f);
-    synth_crcf_pll_set_bandwidth(q->payload_synth, 1e-4f);
-    free(pn);
-    msequence_destroy(ms);
-
-    q->detector = qdetector_cccf_create_linear(
-        q->preamble_pn, 64, LIQUID_FIRFILT_ARKAISER, q->k, q->m, q->beta);
-    qdetector_cccf_set_threshold(q->detector, 0.5f);
+    q->pn_len = _n;
+    q->pn     = (float complex *)calloc(q->pn_len, sizeof(float complex));
+    dsssframe_generate_pn(q->pn, q->pn_len);
 
     q->npfb = 32;
     q->mf   = firpfb_crcf_create_rnyquist(LIQUID_FIRFILT_ARKAISER, q->npfb, q->k, q->m, q->beta);
 
     q->mixer = nco_crcf_create(LIQUID_NCO);
     q->pll   = nco_crcf_create(LIQUID_NCO);
-    nco_crcf_pll_set_bandwidth(q->pll, 1e-4f); // very low bandwidth
 
     q->header_decoder  = qpacketmodem_create();
+    q->header_il_decoder = qpacketmodem_create();
     q->header_user_len = DSSSFRAME_H_USER_DEFAULT;
-    dsssframesync_set_header_props(q, NULL);
+    q->header_mod      = NULL;
+    q->header_dec      = NULL;
+    dsss_framesync_set_header_props(q, NULL);
+
+    q->payload_decoder = qpacketmodem_create();
+    q->payload_dec_len = 0;
+    q->payload_mod_len = 0;
+    q->payload_mod     = NULL;
+    q->payload_dec     = NULL;
+
+    q->il_decoder = qpacketmodem_create();
+    q->il_depth   = 0;
 
-    q->payload_decoder    = qpacketmodem_create();
-    q->payload_spread_len = _n;
-    q->payload_spread
-        = (float complex *)malloc(q->payload_spread_len * sizeof(float complex));
+    q->tracking        = 0;
+    q->track_window    = DSSSFRAMESYNC_TRACK_WINDOW;
+    q->frames_tracked  = 0;
+    q->tracking_losses = 0;
 
-    dsssframesync_reset_framedatastats(q);
-    dsssframesync_reset(q);
+    q->threshold = DSSSFRAMESYNC_THRESHOLD_DEFAULT;
+    dsss_framesync_set_preamble_len(q, DSSSFRAME_PREAMBLE_LEN);
+
+    dsss_framesync_reset_framedatastats(q);
 
     return q;
 }
+
+int dsss_framesync_destroy(dsss_framesync _q)
+{
+    if (_q == NULL)
+        return 0;
+
+    qdetector_cccf_destroy(_q->detector);
+    firpfb_crcf_destroy(_q->mf);
+    nco_crcf_destroy(_q->mixer);
+    nco_crcf_destroy(_q->pll);
+    qpacketmodem_destroy(_q->header_decoder);
+    qpacketmodem_destroy(_q->header_il_decoder);
+    qpacketmodem_destroy(_q->payload_decoder);
+    qpacketmodem_destroy(_q->il_decoder);
+    free(_q->il_mod);
+    free(_q->il_symbols);
+    free(_q->il_codeword);
+    dsss_framesync_set_combining(_q, 0, NULL);
+    free(_q->preamble_pn);
+    free(_q->preamble_rx);
+    free(_q->pn);
+    free(_q->header_mod);
+    free(_q->header_dec);
+    free(_q->payload_mod);
+    free(_q->payload_dec);
+    free(_q->track_chips);
+    free(_q->track_buf);
+    free(_q->replay);
+    free(_q);
+    return 0;
+}
+
+int dsss_framesync_reset(dsss_framesync _q)
+{
+    qdetector_cccf_reset(_q->detector);
+    nco_crcf_reset(_q->mixer);
+    nco_crcf_reset(_q->pll);
+    firpfb_crcf_reset(_q->mf);
+
+    _q->preamble_counter = 0;
+    _q->symbol_counter   = 0;
+    _q->chip_counter     = 0;
+    _q->despread         = 0.0f;
+    _q->track_chips_len  = 0;
+    _q->track_buf_len    = 0;
+    _q->state            = DSSSFRAMESYNC_STATE_DETECTFRAME;
+
+    framesyncstats_init_default(&_q->framesyncstats);
+    return 0;
+}
+
+int dsss_framesync_is_frame_open(dsss_framesync _q)
+{
+    return (_q->state == DSSSFRAMESYNC_STATE_DETECTFRAME) ? 0 : 1;
+}
+
+int dsss_framesync_set_callback(dsss_framesync     _q,
+                                framesync_callback _callback,
+                                void *             _userdata)
+{
+    _q->callback = _callback;
+    _q->userdata = _userdata;
+    return 0;
+}
+
+int dsss_framesync_set_header_props(dsss_framesync _q, dsssframegenprops_s * _props)
+{
+    if (_props == NULL)
+        _props = &dsss_framesyncprops_header_default;
+
+    if ((_props->check == LIQUID_CRC_UNKNOWN) || (_props->check >= LIQUID_CRC_NUM_SCHEMES)) {
+        fprintf(stderr, "dsss_framesync_set_header_props(), invalid/unsupported CRC scheme\n");
+        return -1;
+    }
+    if ((_props->fec0 == LIQUID_FEC_UNKNOWN) || (_props->fec1 == LIQUID_FEC_UNKNOWN)) {
+        fprintf(stderr, "dsss_framesync_set_header_props(), invalid/unsupported FEC scheme\n");
+        return -1;
+    }
+
+    memmove(&_q->header_props, _props, sizeof(dsssframegenprops_s));
+    return dsss_framesync_set_header_len(_q, _q->header_user_len);
+}
+
+int dsss_framesync_set_header_len(dsss_framesync _q, unsigned int _len)
+{
+    // the frames kept for soft combining are identified by the user header
+    if (_len != _q->header_user_len)
+        dsss_framesync_set_combining(_q, 0, NULL);
+
+    _q->header_user_len = _len;
+    _q->header_dec_len  = DSSSFRAME_H_DEC + _q->header_user_len;
+    _q->header_dec = (unsigned char *)realloc(_q->header_dec,
+                                              (DSSSFRAME_H_DEC_INTERLEAVED + _q->header_user_len) * sizeof(unsigned char));
+
+    qpacketmodem_configure(_q->header_decoder,
+                           _q->header_dec_len,
+                           _q->header_props.check,
+                           _q->header_props.fec0,
+                           _q->header_props.fec1,
+                           LIQUID_MODEM_BPSK);
+    _q->header_mod_len = qpacketmodem_get_frame_len(_q->header_decoder);
+    qpacketmodem_configure(_q->header_il_decoder,
+                           DSSSFRAME_H_DEC_INTERLEAVED + _q->header_user_len,
+                           _q->header_props.check,
+                           _q->header_props.fec0,
+                           _q->header_props.fec1,
+                           LIQUID_MODEM_BPSK);
+    _q->header_il_mod_len = qpacketmodem_get_frame_len(_q->header_il_decoder);
+    _q->header_mod = (float complex *)realloc(_q->header_mod, _q->header_il_mod_len * sizeof(float complex));
+    return 0;
+}
+
+int dsss_framesync_set_preamble_len(dsss_framesync _q, unsigned int _len)
+{
+    if ((_len < DSSSFRAME_PREAMBLE_LEN_MIN) || (_len > DSSSFRAME_PREAMBLE_LEN_MAX)) {
+        fprintf(stderr, "dsss_framesync_set_preamble_len(), preamble length must be between %u and %u\n",
+                DSSSFRAME_PREAMBLE_LEN_MIN, DSSSFRAME_PREAMBLE_LEN_MAX);
+        return -1;
+    }
+
+    // designing the detector is slow, keep it when the length doesn't change
+    if ((_q->detector != NULL) && (_len == _q->preamble_len))
+        return dsss_framesync_reset(_q);
+
+    _q->preamble_len = _len;
+    _q->preamble_pn = (float complex *)realloc(_q->preamble_pn, _q->preamble_len * sizeof(float complex));
+    _q->preamble_rx = (float complex *)realloc(_q->preamble_rx, _q->preamble_len * sizeof(float complex));
+    dsssframe_generate_preamble(_q->preamble_pn, _q->preamble_len);
+
+    if (_q->detector != NULL)
+        qdetector_cccf_destroy(_q->detector);
+    _q->detector = qdetector_cccf_create_linear(
+        _q->preamble_pn, _q->preamble_len, LIQUID_FIRFILT_ARKAISER, _q->k, _q->m, _q->beta);
+    qdetector_cccf_set_threshold(_q->detector, _q->threshold);
+
+    // the chips between the end of a frame and the end of the preamble of
+    // the next frame: filter tail, search window and preamble, plus one chip
+    // on each side for the timing estimation
+    _q->track_chips_size = 2 * _q->m + _q->track_window + _q->preamble_len + 1;
+    _q->track_chips = (float complex *)realloc(_q->track_chips, _q->track_chips_size * sizeof(float complex));
+    _q->track_buf_size = _q->k * (_q->track_chips_size + 1);
+    _q->track_buf = (float complex *)realloc(_q->track_buf, _q->track_buf_size * sizeof(float complex));
+    _q->replay = (float complex *)realloc(_q->replay, _q->track_buf_size * sizeof(float complex));
+    _q->replay_len   = 0;
+    _q->replay_index = 0;
+
+    return dsss_framesync_reset(_q);
+}
+
+int dsss_framesync_set_threshold(dsss_framesync _q, float _threshold)
+{
+    if ((_threshold <= 0.0f) || (_threshold >= 1.0f)) {
+        fprintf(stderr, "dsss_framesync_set_threshold(), threshold must be between 0 and 1\n");
+        return -1;
+    }
+
+    _q->threshold = _threshold;
+    return qdetector_cccf_set_threshold(_q->detector, _q->threshold);
+}
+
+int dsss_framesync_set_tracking(dsss_framesync _q, int _tracking)
+{
+    _q->tracking = _tracking;
+    return 0;
+}
+
+unsigned int dsss_framesync_get_frames_tracked(dsss_framesync _q)
+{
+    return _q->frames_tracked;
+}
+
+unsigned int dsss_framesync_get_tracking_losses(dsss_framesync _q)
+{
+    return _q->tracking_losses;
+}
+
+int dsss_framesync_set_combining(dsss_framesync        _q,
+                                 unsigned int          _len,
+                                 const unsigned char * _mask)
+{
+    unsigned int i;
+
+    for (i = 0; i < _q->copies_len; i++) {
+        free(_q->copies[i].key);
+        free(_q->copies[i].sum);
+    }
+    free(_q->copies);
+    free(_q->copies_mask);
+    free(_q->copies_key);
+    _q->copies      = NULL;
+    _q->copies_mask = NULL;
+    _q->copies_key  = NULL;
+    _q->copies_len  = 0;
+
+    if (_len == 0)
+        return 0;
+
+    _q->copies      = (dsss_framesync_copy_s *)calloc(_len, sizeof(dsss_framesync_copy_s));
+    _q->copies_mask = (unsigned char *)malloc(_q->header_user_len + 1);
+    _q->copies_key  = (unsigned char *)malloc(_q->header_user_len + 1);
+    if ((_q->copies == NULL) || (_q->copies_mask == NULL) || (_q->copies_key == NULL)) {
+        free(_q->copies);
+        free(_q->copies_mask);
+        free(_q->copies_key);
+        _q->copies      = NULL;
+        _q->copies_mask = NULL;
+        _q->copies_key  = NULL;
+        return -1;
+    }
+    for (i = 0; i < _len; i++) {
+        _q->copies[i].key = (unsigned char *)malloc(_q->header_user_len + 1);
+        if (_q->copies[i].key == NULL) {
+            _q->copies_len = i;
+            dsss_framesync_set_combining(_q, 0, NULL);
+            return -1;
+        }
+    }
+    memmove(_q->copies_mask, _mask, _q->header_user_len);
+    _q->copies_len = _len;
+    return 0;
+}
+
+unsigned int dsss_framesync_get_frames_combined(dsss_framesync _q)
+{
+    return _q->frames_combined;
+}
+
+int dsss_framesync_reset_framedatastats(dsss_framesync _q)
+{
+    _q->frames_tracked  = 0;
+    _q->tracking_losses = 0;
+    _q->frames_combined = 0;
+    return framedatastats_reset(&_q->framedatastats);
+}
+
+framedatastats_s dsss_framesync_get_framedatastats(dsss_framesync _q)
+{
+    return _q->framedatastats;
+}
+
+// carrier frequency offset at the input of the synchronizer (radians/sample)
+static float dsss_framesync_get_cfo(dsss_framesync _q)
+{
+    return nco_crcf_get_frequency(_q->mixer) + nco_crcf_get_frequency(_q->pll) / _q->k;
+}
+
+// shift the sampling instant of the matched filter by a number of samples
+static void dsss_framesync_adjust_timing(dsss_framesync _q, float _delta)
+{
+    int index = (int)_q->pfb_index + (int)roundf(_delta * _q->npfb);
+
+    while (index >= (int)_q->npfb) {
+        index -= _q->npfb;
+        _q->mf_counter--;
+    }
+    while (index < 0) {
+        index += _q->npfb;
+        _q->mf_counter++;
+    }
+    _q->pfb_index = index;
+}
+
+// push a sample through the mixer and the matched filter; returns 1 when
+// a chip is available
+static int dsss_framesync_step(dsss_framesync _q, float complex _x, float complex * _y)
+{
+    float complex v;
+
+    nco_crcf_mix_down(_q->mixer, _x, &v);
+    nco_crcf_step(_q->mixer);
+
+    firpfb_crcf_push(_q->mf, v);
+    firpfb_crcf_execute(_q->mf, _q->pfb_index, &v);
+
+    _q->mf_counter++;
+    if (_q->mf_counter < 1)
+        return 0;
+
+    *_y = v;
+    _q->mf_counter -= _q->k;
+    return 1;
+}
+
+// estimate the residual carrier phase (and frequency, unless the estimate of
+// the previous frame is reused) from the received preamble chips, and start
+// the phase-locked loop with them
+static void dsss_framesync_estimate_carrier(dsss_framesync        _q,
+                                            const float complex * _rx,
+                                            int                   _reuse_frequency)
+{
+    float complex r;
+    float complex r_prev = 0.0f;
+    float complex dsum   = 0.0f;
+    float complex psum   = 0.0f;
+    float dphi;
+    unsigned int i;
+
+    if (_reuse_frequency) {
+        dphi = nco_crcf_get_frequency(_q->pll);
+    } else {
+        for (i = 0; i < _q->preamble_len; i++) {
+            r = _rx[i] * conjf(_q->preamble_pn[i]);
+            if (i > 0)
+                dsum += r * conjf(r_prev);
+            r_prev = r;
+        }
+        dphi = cargf(dsum);
+    }
+
+    for (i = 0; i < _q->preamble_len; i++)
+        psum += _rx[i] * conjf(_q->preamble_pn[i]) * cexpf(-_Complex_I * dphi * i);
+
+    nco_crcf_set_frequency(_q->pll, dphi);
+    nco_crcf_set_phase(_q->pll, cargf(psum) + dphi * _q->preamble_len);
+}
+
+// despread a chip; returns 1 when a symbol is available
+static int dsss_framesync_despread(dsss_framesync _q, float complex _chip, float complex * _sym)
+{
+    float complex v;
+    float phase_error;
+
+    nco_crcf_mix_down(_q->pll, _chip, &v);
+    nco_crcf_step(_q->pll);
+
+    _q->despread += v * conjf(_q->pn[_q->chip_counter]);
+    _q->chip_counter++;
+    if (_q->chip_counter < _q->pn_len)
+        return 0;
+
+    *_sym            = _q->despread / _q->pn_len;
+    _q->despread     = 0.0f;
+    _q->chip_counter = 0;
+
+    // decision-directed phase error of the BPSK symbol
+    phase_error = cargf(*_sym * ((crealf(*_sym) < 0) ? -1.0f : 1.0f));
+    nco_crcf_adjust_phase(_q->pll, DSSSFRAMESYNC_PLL_ALPHA * phase_error);
+    nco_crcf_adjust_frequency(_q->pll, DSSSFRAMESYNC_PLL_BETA * phase_error / _q->pn_len);
+    return 1;
+}
+
+static void dsss_framesync_start_header(dsss_framesync _q)
+{
+    _q->symbol_counter = 0;
+    _q->chip_counter   = 0;
+    _q->despread       = 0.0f;
+    _q->state          = DSSSFRAMESYNC_STATE_RXHEADER;
+}
+
+static void dsss_framesync_execute_seekpn(dsss_framesync _q, float complex _x)
+{
+    float complex * v = (float complex *)qdetector_cccf_execute(_q->detector, _x);
+    unsigned int buf_len;
+    unsigned int i;
+
+    if (v == NULL)
+        return;
+
+    _q->tau_hat   = qdetector_cccf_get_tau(_q->detector);
+    _q->gamma_hat = qdetector_cccf_get_gamma(_q->detector);
+    _q->dphi_hat  = qdetector_cccf_get_dphi(_q->detector);
+    _q->phi_hat   = qdetector_cccf_get_phi(_q->detector);
+
+    if (_q->tau_hat > 0) {
+        _q->pfb_index  = (unsigned int)(_q->tau_hat * _q->npfb) % _q->npfb;
+        _q->mf_counter = 0;
+    } else {
+        _q->pfb_index  = (unsigned int)((1.0f + _q->tau_hat) * _q->npfb) % _q->npfb;
+        _q->mf_counter = 1;
+    }
+
+    firpfb_crcf_set_scale(_q->mf, 0.5f / _q->gamma_hat);
+    nco_crcf_set_frequency(_q->mixer, _q->dphi_hat);
+    nco_crcf_set_phase(_q->mixer, _q->phi_hat);
+
+    _q->preamble_counter = 0;
+    _q->state            = DSSSFRAMESYNC_STATE_RXPREAMBLE;
+    _q->framedatastats.num_frames_detected++;
+
+    // run the buffered samples through the synchronizer
+    buf_len = qdetector_cccf_get_buf_len(_q->detector);
+    for (i = 0; i < buf_len; i++)
+        dsss_framesync_execute_sample(_q, v[i]);
+}
+
+static void dsss_framesync_execute_rxpreamble(dsss_framesync _q, float complex _x)
+{
+    float complex mf_out;
+    unsigned int delay = 2 * _q->m; // delay from system filters
+
+    if (!dsss_framesync_step(_q, _x, &mf_out))
+        return;
+
+    if (_q->preamble_counter >= delay)
+        _q->preamble_rx[_q->preamble_counter - delay] = mf_out;
+
+    _q->preamble_counter++;
+    if (_q->preamble_counter == _q->preamble_len + delay) {
+        dsss_framesync_estimate_carrier(_q, _q->preamble_rx, 0);
+        dsss_framesync_start_header(_q);
+    }
+}
+
+// decode the header received so far, either as the header of a regular
+// frame or as the longer header of a frame of an interleaver block
+static void dsss_framesync_decode_header(dsss_framesync _q, int _interleaved)
+{
+    unsigned int n = _q->header_user_len;
+    unsigned int check;
+    unsigned int fec0;
+    unsigned int fec1;
+
+    _q->header_valid = qpacketmodem_decode_soft(_interleaved ? _q->header_il_decoder : _q->header_decoder,
+                                                _q->header_mod, _q->header_dec);
+    if (!_q->header_valid)
+        return;
+
+    if (_q->header_dec[n + 0] != (_interleaved ? DSSSFRAME_PROTOCOL_INTERLEAVED : DSSSFRAME_PROTOCOL)) {
+        _q->header_valid = 0;
+        return;
+    }
+
+    _q->payload_dec_len = (_q->header_dec[n + 1] << 8) | _q->header_dec[n + 2];
+    check = (_q->header_dec[n + 3] >> 5) & 0x07;
+    fec0  = _q->header_dec[n + 3] & 0x1f;
+    fec1  = _q->header_dec[n + 4] & 0x1f;
+    _q->frame_continued = (_q->header_dec[n + 4] & DSSSFRAME_CONTINUED) ? 1 : 0;
+    if (_interleaved) {
+        _q->frame_il_depth = (_q->header_dec[n + 5] >> 4) + 1;
+        _q->frame_il_index = _q->header_dec[n + 5] & 0x0f;
+        _q->frame_il_block = _q->header_dec[n + 6];
+    } else {
+        _q->frame_il_depth = 1;
+        _q->frame_il_index = 0;
+        _q->frame_il_block = 0;
+    }
+
+    if ((_q->payload_dec_len == 0) ||
+        (check == LIQUID_CRC_UNKNOWN) || (check >= LIQUID_CRC_NUM_SCHEMES) ||
+        (fec0 == LIQUID_FEC_UNKNOWN) || (fec0 >= LIQUID_FEC_NUM_SCHEMES) ||
+        (fec1 == LIQUID_FEC_UNKNOWN) || (fec1 >= LIQUID_FEC_NUM_SCHEMES) ||
+        (_q->frame_il_index >= _q->frame_il_depth)) {
+        _q->header_valid = 0;
+        return;
+    }
+
+    _q->framesyncstats.check = check;
+    _q->framesyncstats.fec0  = fec0;
+    _q->framesyncstats.fec1  = fec1;
+    _q->framedatastats.num_headers_valid++;
+
+    // the payload of an interleaved frame is a part of several codewords made
+    // of the user header, the payload length and the padded payload
+    qpacketmodem_configure(_q->payload_decoder,
+                           (_q->frame_il_depth > 1) ?
+                           _q->header_user_len + 2 + _q->payload_dec_len :
+                           _q->payload_dec_len,
+                           check, fec0, fec1, LIQUID_MODEM_BPSK);
+    _q->payload_mod_len = qpacketmodem_get_frame_len(_q->payload_decoder);
+    _q->payload_mod = (float complex *)realloc(_q->payload_mod, _q->payload_mod_len * sizeof(float complex));
+    _q->payload_dec = (unsigned char *)realloc(_q->payload_dec, _q->payload_dec_len * sizeof(unsigned char));
+}
+
+static void dsss_framesync_start_tracking(dsss_framesync _q)
+{
+    _q->track_chips_len = 0;
+    _q->track_buf_len   = 0;
+    _q->state           = DSSSFRAMESYNC_STATE_TRACKFRAME;
+}
+
+static void dsss_framesync_rxheader_chip(dsss_framesync _q, float complex _chip)
+{
+    float complex sym;
+
+    if (!dsss_framesync_despread(_q, _chip, &sym))
+        return;
+
+    _q->header_mod[_q->symbol_counter] = sym;
+    _q->symbol_counter++;
+    if (_q->symbol_counter < _q->header_mod_len)
+        return;
+
+    // the header of a regular frame is tried first; if it is not valid, the
+    // frame may be part of an interleaver block, whose header is longer
+    if (_q->symbol_counter == _q->header_mod_len) {
+        dsss_framesync_decode_header(_q, 0);
+        if (!_q->header_valid)
+            return;
+    } else if (_q->symbol_counter < _q->header_il_mod_len) {
+        return;
+    } else {
+        dsss_framesync_decode_header(_q, 1);
+    }
+
+    if (_q->header_valid) {
+        _q->symbol_counter = 0;
+        _q->state          = DSSSFRAMESYNC_STATE_RXPAYLOAD;
+        return;
+    }
+
+    if (_q->callback != NULL) {
+        _q->framesyncstats.evm           = 0.0f;
+        _q->framesyncstats.rssi          = 20 * log10f(_q->gamma_hat);
+        _q->framesyncstats.cfo           = dsss_framesync_get_cfo(_q);
+        _q->framesyncstats.framesyms     = NULL;
+        _q->framesyncstats.num_framesyms = 0;
+        _q->framesyncstats.mod_scheme    = LIQUID_MODEM_UNKNOWN;
+        _q->framesyncstats.mod_bps       = 0;
+        _q->framesyncstats.check         = LIQUID_CRC_UNKNOWN;
+        _q->framesyncstats.fec0          = LIQUID_FEC_UNKNOWN;
+        _q->framesyncstats.fec1          = LIQUID_FEC_UNKNOWN;
+
+        _q->callback(_q->header_dec, _q->header_valid, NULL, 0, 0,
+                     _q->framesyncstats, _q->userdata);
+    }
+    dsss_framesync_reset(_q);
+}
+
+// go to the next state after the payload of a frame
+static void dsss_framesync_end_payload(dsss_framesync _q)
+{
+    if (_q->frame_continued) {
+        // the next frame starts immediately, without preamble
+        _q->framedatastats.num_frames_detected++;
+        dsss_framesync_start_header(_q);
+    } else if (_q->tracking) {
+        dsss_framesync_start_tracking(_q);
+    } else {
+        dsss_framesync_reset(_q);
+    }
+}
+
+int dsss_framesync_flush(dsss_framesync _q)
+{
+    unsigned int n   = _q->il_depth;
+    unsigned int len = _q->il_mod_len;
+    unsigned int h   = _q->header_user_len;
+    unsigned int c;
+    unsigned int f;
+    unsigned int i;
+    unsigned int payload_len;
+    int          valid;
+
+    if (n == 0)
+        return 0;
+    _q->il_depth = 0;
+
+    for (c = 0; c < n; c++) {
+        // the symbol i of the codeword c is in the frame (c - i) mod n;
+        // the symbols of the frames not received are erasures
+        for (i = 0; i < len; i++) {
+            f = (c + n - (i % n)) % n;
+            _q->il_symbols[i] = _q->il_received[f] ? _q->il_mod[(f * len) + i] : 0.0f;
+        }
+        valid = qpacketmodem_decode_soft(_q->il_decoder, _q->il_symbols, _q->il_codeword);
+        payload_len = (_q->il_codeword[h] << 8) | _q->il_codeword[h + 1];
+        if (payload_len > _q->il_payload_len) {
+            payload_len = _q->il_payload_len;
+            valid       = 0;
+        }
+        if (valid) {
+            _q->framedatastats.num_payloads_valid++;
+            _q->framedatastats.num_bytes_received += payload_len;
+        }
+
+        if (_q->callback != NULL) {
+            _q->framesyncstats.evm           = qpacketmodem_get_demodulator_evm(_q->il_decoder);
+            _q->framesyncstats.framesyms     = NULL;
+            _q->framesyncstats.num_framesyms = 0;
+            _q->framesyncstats.mod_scheme    = LIQUID_MODEM_BPSK;
+            _q->framesyncstats.mod_bps       = 1;
+            _q->framesyncstats.check         = _q->il_check;
+            _q->framesyncstats.fec0          = _q->il_fec0;
+            _q->framesyncstats.fec1          = _q->il_fec1;
+
+            _q->callback(_q->il_codeword, valid, &_q->il_codeword[h + 2], payload_len,
+                         valid, _q->framesyncstats, _q->userdata);
+        }
+    }
+    return 0;
+}
+
+// store the payload of an interleaved frame in its block, and decode the block
+// when its last frame has been received
+static void dsss_framesync_deinterleave(dsss_framesync _q)
+{
+    unsigned int n = _q->frame_il_depth;
+
+    if ((_q->il_depth > 0) &&
+        ((_q->frame_il_block != _q->il_block) ||
+         (n != _q->il_depth) ||
+         (_q->payload_dec_len != _q->il_payload_len) ||
+         (_q->framesyncstats.check != _q->il_check) ||
+         (_q->framesyncstats.fec0 != _q->il_fec0) ||
+         (_q->framesyncstats.fec1 != _q->il_fec1) ||
+         _q->il_received[_q->frame_il_index])) {
+        // the end of the previous block was lost
+        dsss_framesync_flush(_q);
+    }
+
+    if (_q->il_depth == 0) {
+        _q->il_depth       = n;
+        _q->il_block       = _q->frame_il_block;
+        _q->il_payload_len = _q->payload_dec_len;
+        _q->il_mod_len     = _q->payload_mod_len;
+        _q->il_check       = _q->framesyncstats.check;
+        _q->il_fec0        = _q->framesyncstats.fec0;
+        _q->il_fec1        = _q->framesyncstats.fec1;
+        qpacketmodem_configure(_q->il_decoder,
+                               _q->header_user_len + 2 + _q->il_payload_len,
+                               _q->il_check, _q->il_fec0, _q->il_fec1,
+                               LIQUID_MODEM_BPSK);
+        _q->il_mod = (float complex *)realloc(_q->il_mod, n * _q->il_mod_len * sizeof(float complex));
+        _q->il_symbols = (float complex *)realloc(_q->il_symbols, _q->il_mod_len * sizeof(float complex));
+        _q->il_codeword = (unsigned char *)realloc(_q->il_codeword, _q->header_user_len + 2 + _q->il_payload_len);
+        memset(_q->il_received, 0, sizeof(_q->il_received));
+    }
+
+    memmove(&_q->il_mod[_q->frame_il_index * _q->il_mod_len], _q->payload_mod,
+            _q->il_mod_len * sizeof(float complex));
+    _q->il_received[_q->frame_il_index] = 1;
+
+    _q->framesyncstats.rssi = 20 * log10f(_q->gamma_hat);
+    _q->framesyncstats.cfo  = dsss_framesync_get_cfo(_q);
+    if (_q->frame_il_index == n - 1)
+        dsss_framesync_flush(_q);
+}
+
+// average the symbols of a payload that could not be decoded with the ones of
+// the previous copies of the same frame (Chase combining) and try to decode
+// them again; the copies of the frames are forgotten once decoded
+static void dsss_framesync_combine(dsss_framesync _q)
+{
+    unsigned int           len   = _q->payload_mod_len;
+    dsss_framesync_copy_s *copy  = NULL;
+    dsss_framesync_copy_s *slot  = &_q->copies[0];
+    unsigned int           i;
+    float complex *        sum;
+
+    for (i = 0; i < _q->header_user_len; i++)
+        _q->copies_key[i] = _q->header_dec[i] & _q->copies_mask[i];
+
+    for (i = 0; i < _q->copies_len; i++) {
+        if ((_q->copies[i].copies > 0) &&
+            (_q->copies[i].payload_len == _q->payload_dec_len) &&
+            (_q->copies[i].mod_len == len) &&
+            (_q->copies[i].check == _q->framesyncstats.check) &&
+            (_q->copies[i].fec0 == _q->framesyncstats.fec0) &&
+            (_q->copies[i].fec1 == _q->framesyncstats.fec1) &&
+            (memcmp(_q->copies[i].key, _q->copies_key, _q->header_user_len) == 0)) {
+            copy = &_q->copies[i];
+            break;
+        }
+        // free slot, or else least recently used one
+        if ((slot->copies > 0) &&
+            ((_q->copies[i].copies == 0) || (_q->copies[i].last_use < slot->last_use)))
+            slot = &_q->copies[i];
+    }
+
+    if (_q->payload_valid) {
+        if (copy != NULL)
+            copy->copies = 0;
+        return;
+    }
+
+    _q->copies_clock++;
+    if (copy == NULL) {
+        // first copy of the frame
+        if (slot->sum_size < len) {
+            sum = (float complex *)realloc(slot->sum, len * sizeof(float complex));
+            if (sum == NULL)
+                return;
+            slot->sum      = sum;
+            slot->sum_size = len;
+        }
+        memmove(slot->key, _q->copies_key, _q->header_user_len);
+        memmove(slot->sum, _q->payload_mod, len * sizeof(float complex));
+        slot->payload_len = _q->payload_dec_len;
+        slot->mod_len     = len;
+        slot->check       = _q->framesyncstats.check;
+        slot->fec0        = _q->framesyncstats.fec0;
+        slot->fec1        = _q->framesyncstats.fec1;
+        slot->copies      = 1;
+        slot->last_use    = _q->copies_clock;
+        return;
+    }
+
+    copy->copies++;
+    copy->last_use = _q->copies_clock;
+    for (i = 0; i < len; i++) {
+        copy->sum[i]       += _q->payload_mod[i];
+        _q->payload_mod[i]  = copy->sum[i] / (float)copy->copies;
+    }
+    _q->payload_valid = qpacketmodem_decode_soft(_q->payload_decoder, _q->payload_mod, _q->payload_dec);
+    if (_q->payload_valid) {
+        copy->copies = 0;
+        _q->frames_combined++;
+    }
+}
+
+static void dsss_framesync_rxpayload_chip(dsss_framesync _q, float complex _chip)
+{
+    float complex sym;
+
+    if (!dsss_framesync_despread(_q, _chip, &sym))
+        return;
+
+    _q->payload_mod[_q->symbol_counter] = sym;
+    _q->symbol_counter++;
+    if (_q->symbol_counter < _q->payload_mod_len)
+        return;
+
+    if (_q->frame_il_depth > 1) {
+        dsss_framesync_deinterleave(_q);
+        dsss_framesync_end_payload(_q);
+        return;
+    }
+
+    _q->payload_valid = qpacketmodem_decode_soft(_q->payload_decoder, _q->payload_mod, _q->payload_dec);
+    if (_q->copies_len > 0)
+        dsss_framesync_combine(_q);
+    if (_q->payload_valid) {
+        _q->framedatastats.num_payloads_valid++;
+        _q->framedatastats.num_bytes_received += _q->payload_dec_len;
+    }
+
+    if (_q->callback != NULL) {
+        _q->framesyncstats.evm           = qpacketmodem_get_demodulator_evm(_q->payload_decoder);
+        _q->framesyncstats.rssi          = 20 * log10f(_q->gamma_hat);
+        _q->framesyncstats.cfo           = dsss_framesync_get_cfo(_q);
+        _q->framesyncstats.framesyms     = _q->payload_mod;
+        _q->framesyncstats.num_framesyms = _q->payload_mod_len;
+        _q->framesyncstats.mod_scheme    = LIQUID_MODEM_BPSK;
+        _q->framesyncstats.mod_bps       = 1;
+
+        _q->callback(_q->header_dec, _q->header_valid, _q->payload_dec, _q->payload_dec_len,
+                     _q->payload_valid, _q->framesyncstats, _q->userdata);
+    }
+
+    dsss_framesync_end_payload(_q);
+}
+
+static void dsss_framesync_execute_rxheader(dsss_framesync _q, float complex _x)
+{
+    float complex mf_out;
+
+    if (dsss_framesync_step(_q, _x, &mf_out))
+        dsss_framesync_rxheader_chip(_q, mf_out);
+}
+
+static void dsss_framesync_execute_rxpayload(dsss_framesync _q, float complex _x)
+{
+    float complex mf_out;
+
+    if (dsss_framesync_step(_q, _x, &mf_out))
+        dsss_framesync_rxpayload_chip(_q, mf_out);
+}
+
+// the next frame was not where it was expected: go back to the preamble
+// detector, and search again in the samples received since the end of the
+// previous frame
+static void dsss_framesync_track_lost(dsss_framesync _q)
+{
+    unsigned int remaining = _q->replay_len - _q->replay_index;
+
+    memmove(&_q->replay[_q->track_buf_len], &_q->replay[_q->replay_index],
+            remaining * sizeof(float complex));
+    memmove(_q->replay, _q->track_buf, _q->track_buf_len * sizeof(float complex));
+    _q->replay_len   = _q->track_buf_len + remaining;
+    _q->replay_index = 0;
+
+    _q->tracking_losses++;
+    dsss_framesync_reset(_q);
+}
+
+// correlate the chips received after the previous frame with the preamble
+static float complex dsss_framesync_track_correlate(dsss_framesync _q,
+                                                    unsigned int   _offset,
+                                                    float *        _energy)
+{
+    float complex rxy = 0.0f;
+    float complex chip;
+    unsigned int i;
+
+    *_energy = 0.0f;
+    for (i = 0; i < _q->preamble_len; i++) {
+        chip = _q->track_chips[_offset + i];
+        rxy += chip * conjf(_q->preamble_pn[i]);
+        *_energy += crealf(chip * conjf(chip));
+    }
+    return rxy;
+}
+
+// search the preamble of the next frame around its expected position, right
+// after the tail of the previous frame
+static void dsss_framesync_track_preamble(dsss_framesync _q)
+{
+    unsigned int expected = 2 * _q->m;
+    unsigned int start = (expected > _q->track_window) ? expected - _q->track_window : 1;
+    unsigned int end = expected + _q->track_window;
+    unsigned int offset = 0;
+    unsigned int i;
+    float complex rxy;
+    float complex rxy_max = 0.0f;
+    float complex early;
+    float complex late;
+    float energy;
+    float metric;
+    float metric_max = 0.0f;
+    float delta;
+
+    for (i = start; i <= end; i++) {
+        rxy    = dsss_framesync_track_correlate(_q, i, &energy);
+        metric = cabsf(rxy) / sqrtf(energy * _q->preamble_len + 1e-12f);
+        if (metric > metric_max) {
+            metric_max = metric;
+            rxy_max    = rxy;
+            offset     = i;
+        }
+    }
+
+    if (metric_max < DSSSFRAMESYNC_TRACK_THRESHOLD) {
+        dsss_framesync_track_lost(_q);
+        return;
+    }
+
+    // near the optimal sampling instant, the correlations with the previous
+    // and next chips change linearly with the timing error
+    early = dsss_framesync_track_correlate(_q, offset - 1, &energy);
+    late  = dsss_framesync_track_correlate(_q, offset + 1, &energy);
+    delta = crealf((late - early) * conjf(rxy_max)) /
+            (2 * DSSSFRAMESYNC_PULSE_SLOPE * crealf(rxy_max * conjf(rxy_max)));
+    delta = fmaxf(-0.5f, fminf(0.5f, delta));
+    dsss_framesync_adjust_timing(_q, delta * _q->k);
+
+    _q->frames_tracked++;
+    _q->framedatastats.num_frames_detected++;
+    framesyncstats_init_default(&_q->framesyncstats);
+
+    dsss_framesync_estimate_carrier(_q, &_q->track_chips[offset], 1);
+    dsss_framesync_start_header(_q);
+
+    // the chips after the preamble are the beginning of the header
+    for (i = offset + _q->preamble_len; i < _q->track_chips_len; i++) {
+        if (_q->state != DSSSFRAMESYNC_STATE_RXHEADER)
+            break;
+        dsss_framesync_rxheader_chip(_q, _q->track_chips[i]);
+    }
+
+    _q->track_chips_len = 0;
+    _q->track_buf_len   = 0;
+}
+
+static void dsss_framesync_execute_trackframe(dsss_framesync _q, float complex _x)
+{
+    float complex mf_out;
+
+    _q->track_buf[_q->track_buf_len] = _x;
+    _q->track_buf_len++;
+
+    if (dsss_framesync_step(_q, _x, &mf_out)) {
+        _q->track_chips[_q->track_chips_len] = mf_out;
+        _q->track_chips_len++;
+    }
+
+    if (_q->track_chips_len == _q->track_chips_size)
+        dsss_framesync_track_preamble(_q);
+    else if (_q->track_buf_len == _q->track_buf_size)
+        dsss_framesync_track_lost(_q);
+}
+
+static void dsss_framesync_execute_sample(dsss_framesync _q, float complex _x)
+{
+    switch (_q->state) {
+    case DSSSFRAMESYNC_STATE_DETECTFRAME:
+        dsss_framesync_execute_seekpn(_q, _x);
+        break;
+    case DSSSFRAMESYNC_STATE_RXPREAMBLE:
+        dsss_framesync_execute_rxpreamble(_q, _x);
+        break;
+    case DSSSFRAMESYNC_STATE_RXHEADER:
+        dsss_framesync_execute_rxheader(_q, _x);
+        break;
+    case DSSSFRAMESYNC_STATE_RXPAYLOAD:
+        dsss_framesync_execute_rxpayload(_q, _x);
+        break;
+    case DSSSFRAMESYNC_STATE_TRACKFRAME:
+        dsss_framesync_execute_trackframe(_q, _x);
+        break;
+    default:
+        break;
+    }
+}
+
+int dsss_framesync_execute(dsss_framesync _q,
+                           float complex * _x,
+                           unsigned int _n)
+{
+    unsigned int i;
+
+    for (i = 0; i < _n; i++) {
+        dsss_framesync_execute_sample(_q, _x[i]);
+
+        // search again in the samples received while tracking a lost frame
+        while (_q->replay_index < _q->replay_len) {
+            _q->replay_index++;
+            dsss_framesync_execute_sample(_q, _q->replay[_q->replay_index - 1]);
+        }
+        _q->replay_len   = 0;
+        _q->replay_index = 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,499 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "erasure.h"
+
+/* Size of the length of the data at the beginning of a source symbol */
+#define LENGTH_SIZE 2
+
+/* The data is cut in blocks of source frames. The sender transmits the source
+ * frames of a block followed by repair frames, which are random linear
+ * combinations of the source frames over GF(256). The coefficients of
+ * a repair frame are derived from its block number and index, so the receiver
+ * can reconstruct the block from any set of frames giving enough independent
+ * combinations (usually as many frames as source frames), whichever they are.
+ * Only one block is kept in memory on each side. */
+struct erasure_s
+{
+  unsigned char gf_exp[512];
+  unsigned char gf_log[256];
+  unsigned int block_size;
+  unsigned int repair_frames;
+
+  /* Sender */
+  unsigned char *tx_symbols;
+  unsigned int tx_symbol_size;
+  unsigned int tx_k;
+  unsigned int tx_index;
+  unsigned char tx_emitting;
+  unsigned char tx_end;
+  uint32_t tx_block;
+  uint32_t tx_counter;
+
+  /* Receiver */
+  unsigned char *rx_rows;
+  unsigned char *rx_row;
+  unsigned char rx_pivots[ERASURE_MAX_BLOCK_SIZE];
+  unsigned int rx_rows_size;
+  unsigned int rx_row_size;
+  unsigned int rx_symbol_size;
+  unsigned int rx_k;
+  unsigned int rx_rank;
+  unsigned char rx_started;
+  unsigned char rx_done;
+  uint32_t rx_block;
+  unsigned long int blocks_decoded;
+  unsigned long int blocks_lost;
+};
+
+static void put_uint32(unsigned char *buffer, uint32_t x)
+{
+  buffer[0] = (x >> 24) & 255;
+  buffer[1] = (x >> 16) & 255;
+  buffer[2] = (x >> 8) & 255;
+  buffer[3] = x & 255;
+}
+
+static uint32_t get_uint32(unsigned char *buffer)
+{
+  return(((uint32_t) buffer[0] << 24) |
+         ((uint32_t) buffer[1] << 16) |
+         ((uint32_t) buffer[2] << 8) |
+         (uint32_t) buffer[3]);
+}
+
+static void gf_init(erasure_t erasure)
+{
+  unsigned int i;
+  unsigned int x = 1;
+
+  for(i = 0; i < 255; i++)
+  {
+    erasure->gf_exp[i] = x;
+    erasure->gf_exp[i + 255] = x;
+    erasure->gf_log[x] = i;
+    x <<= 1;
+    if(x & 0x100)
+    {
+      x ^= 0x11d;
+    }
+  }
+  erasure->gf_exp[510] = erasure->gf_exp[0];
+  erasure->gf_exp[511] = erasure->gf_exp[1];
+  erasure->gf_log[0] = 0;
+}
+
+static unsigned char gf_inverse(erasure_t erasure, unsigned char a)
+{
+  return(erasure->gf_exp[255 - erasure->gf_log[a]]);
+}
+
+/* dst = dst + c * src */
+static void gf_add_scaled(erasure_t erasure,
+                          unsigned char *dst,
+                          unsigned char *src,
+                          unsigned char c,
+                          unsigned int size)
+{
+  unsigned int i;
+  unsigned int log_c;
+
+  if(c == 0)
+  {
+    return;
+  }
+  log_c = erasure->gf_log[c];
+  for(i = 0; i < size; i++)
+  {
+    if(src[i] != 0)
+    {
+      dst[i] ^= erasure->gf_exp[log_c + erasure->gf_log[src[i]]];
+    }
+  }
+}
+
+/* dst = c * dst */
+static void gf_scale(erasure_t erasure,
+                     unsigned char *dst,
+                     unsigned char c,
+                     unsigned int size)
+{
+  unsigned int i;
+  unsigned int log_c = erasure->gf_log[c];
+
+  for(i = 0; i < size; i++)
+  {
+    if(dst[i] != 0)
+    {
+      dst[i] = erasure->gf_exp[log_c + erasure->gf_log[dst[i]]];
+    }
+  }
+}
+
+/* Get the coefficients of a frame. The source frames use the identity,
+ * the repair frames use non-zero pseudo-random coefficients. */
+static void get_coefficients(uint32_t block,
+                             unsigned int index,
+                             unsigned int k,
+                             unsigned char *coefficients)
+{
+  unsigned int i;
+  uint32_t x;
+
+  if(index < k)
+  {
+    memset(coefficients, 0, k);
+    coefficients[index] = 1;
+    return;
+  }
+
+  x = (block * 2654435761u) ^ (index * 40503u) ^ 0x9e3779b9u;
+  for(i = 0; i < k; i++)
+  {
+    /* xorshift32 */
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    coefficients[i] = 1 + (x % 255);
+  }
+}
+
+erasure_t erasure_create(unsigned int block_size, unsigned int repair_frames)
+{
+  erasure_t erasure;
+
+  if((block_size == 0) || (block_size > ERASURE_MAX_BLOCK_SIZE) ||
+     (repair_frames > ERASURE_MAX_REPAIR_FRAMES))
+  {
+    return(NULL);
+  }
+  erasure = calloc(1, sizeof(struct erasure_s));
+  if(erasure == NULL)
+  {
+    return(NULL);
+  }
+  gf_init(erasure);
+  erasure->block_size = block_size;
+  erasure->repair_frames = repair_frames;
+
+  return(erasure);
+}
+
+void erasure_free(erasure_t erasure)
+{
+  if(erasure)
+  {
+    free(erasure->tx_symbols);
+    free(erasure->rx_rows);
+    free(erasure->rx_row);
+    free(erasure);
+  }
+}
+
+static int fill_block(erasure_t erasure,
+                      int (*data_callback)(void *, unsigned char *, unsigned int),
+                      void *callback_context)
+{
+  unsigned int size = erasure->tx_symbol_size;
+  unsigned char *symbol;
+  int n = 0;
+
+  while(erasure->tx_k < erasure->block_size)
+  {
+    symbol = &erasure->tx_symbols[erasure->tx_k * size];
+    n = data_callback(callback_context,
+                      &symbol[LENGTH_SIZE],
+                      size - LENGTH_SIZE);
+    if(n < 0)
+    {
+      erasure->tx_end = 1;
+      break;
+    }
+    if(n == 0)
+    {
+      break;
+    }
+    symbol[0] = (n >> 8) & 255;
+    symbol[1] = n & 255;
+    memset(&symbol[LENGTH_SIZE + n], 0, size - LENGTH_SIZE - n);
+    erasure->tx_k++;
+  }
+
+  if(erasure->tx_k == 0)
+  {
+    return(erasure->tx_end ? -1 : 0);
+  }
+  /* Send a partial block if the data is not coming fast enough, to avoid
+   * delaying it */
+  erasure->tx_emitting = 1;
+  erasure->tx_index = 0;
+  return(1);
+}
+
+int erasure_get_frame(erasure_t erasure,
+                      unsigned char *header,
+                      unsigned char *payload,
+                      unsigned int payload_size,
+                      int (*data_callback)(void *, unsigned char *, unsigned int),
+                      void *callback_context)
+{
+  unsigned int size;
+  unsigned int k;
+  unsigned int i;
+  unsigned char coefficients[ERASURE_MAX_BLOCK_SIZE];
+  int r;
+
+  if(erasure->tx_symbols == NULL)
+  {
+    if(payload_size <= LENGTH_SIZE)
+    {
+      return(-1);
+    }
+    erasure->tx_symbols = malloc(erasure->block_size * payload_size);
+    if(erasure->tx_symbols == NULL)
+    {
+      return(-1);
+    }
+    erasure->tx_symbol_size = payload_size;
+  }
+  size = erasure->tx_symbol_size;
+
+  if(!erasure->tx_emitting)
+  {
+    r = fill_block(erasure, data_callback, callback_context);
+    if(r <= 0)
+    {
+      return(r);
+    }
+  }
+
+  k = erasure->tx_k;
+  if(erasure->tx_index < k)
+  {
+    memcpy(payload, &erasure->tx_symbols[erasure->tx_index * size], size);
+  }
+  else
+  {
+    get_coefficients(erasure->tx_block, erasure->tx_index, k, coefficients);
+    memset(payload, 0, size);
+    for(i = 0; i < k; i++)
+    {
+      gf_add_scaled(erasure,
+                    payload,
+                    &erasure->tx_symbols[i * size],
+                    coefficients[i],
+                    size);
+    }
+  }
+
+  put_uint32(&header[4], erasure->tx_counter);
+  put_uint32(&header[8], erasure->tx_block);
+  header[12] = (erasure->tx_index >> 8) & 255;
+  header[13] = erasure->tx_index & 255;
+  header[14] = k;
+  erasure->tx_counter++;
+
+  erasure->tx_index++;
+  if(erasure->tx_index >= k + erasure->repair_frames)
+  {
+    erasure->tx_emitting = 0;
+    erasure->tx_k = 0;
+    erasure->tx_block++;
+  }
+
+  return(size);
+}
+
+static int start_block(erasure_t erasure,
+                       uint32_t block,
+                       unsigned int k,
+                       unsigned int symbol_size)
+{
+  unsigned int row_size = k + symbol_size;
+  unsigned char *p;
+
+  /* The blocks can have different numbers of frames and sizes of payload,
+   * each buffer is checked against its own capacity */
+  if(k * row_size > erasure->rx_rows_size)
+  {
+    p = realloc(erasure->rx_rows, k * row_size);
+    if(p == NULL)
+    {
+      return(-1);
+    }
+    erasure->rx_rows = p;
+    erasure->rx_rows_size = k * row_size;
+  }
+  if(row_size > erasure->rx_row_size)
+  {
+    p = realloc(erasure->rx_row, row_size);
+    if(p == NULL)
+    {
+      return(-1);
+    }
+    erasure->rx_row = p;
+    erasure->rx_row_size = row_size;
+  }
+  memset(erasure->rx_pivots, 0, sizeof(erasure->rx_pivots));
+  erasure->rx_block = block;
+  erasure->rx_k = k;
+  erasure->rx_symbol_size = symbol_size;
+  erasure->rx_rank = 0;
+  erasure->rx_done = 0;
+  erasure->rx_started = 1;
+  return(0);
+}
+
+static void deliver_block(erasure_t erasure,
+                          int (*data_callback)(void *, unsigned char *, unsigned int),
+                          void *callback_context)
+{
+  unsigned int k = erasure->rx_k;
+  unsigned int row_size = k + erasure->rx_symbol_size;
+  unsigned char *row;
+  unsigned char *symbol;
+  unsigned int n;
+  int i;
+  unsigned int j;
+
+  /* Back substitution, the rows are already in echelon form */
+  for(i = k - 1; i >= 0; i--)
+  {
+    row = &erasure->rx_rows[i * row_size];
+    for(j = i + 1; j < k; j++)
+    {
+      gf_add_scaled(erasure,
+                    row,
+                    &erasure->rx_rows[j * row_size],
+                    row[j],
+                    row_size);
+    }
+  }
+
+  for(j = 0; j < k; j++)
+  {
+    symbol = &erasure->rx_rows[(j * row_size) + k];
+    n = (symbol[0] << 8) | symbol[1];
+    if(n > erasure->rx_symbol_size - LENGTH_SIZE)
+    {
+      n = erasure->rx_symbol_size - LENGTH_SIZE;
+    }
+    data_callback(callback_context, &symbol[LENGTH_SIZE], n);
+  }
+}
+
+void erasure_frame_received(erasure_t erasure,
+                            unsigned char *header,
+                            unsigned char *payload,
+                            unsigned int payload_size,
+                            int (*data_callback)(void *, unsigned char *, unsigned int),
+                            void *callback_context)
+{
+  uint32_t block = get_uint32(&header[8]);
+  unsigned int index = (header[12] << 8) | header[13];
+  unsigned int k = header[14];
+  unsigned int row_size;
+  unsigned char *row;
+  unsigned int i;
+  unsigned int pivot;
+
+  if((k == 0) || (payload_size <= LENGTH_SIZE))
+  {
+    return;
+  }
+
+  if(!erasure->rx_started || (block != erasure->rx_block))
+  {
+    if(erasure->rx_started && ((int32_t) (block - erasure->rx_block) < 0))
+    {
+      /* Frame from a block that has already been processed */
+      return;
+    }
+    if(erasure->rx_started && !erasure->rx_done)
+    {
+      erasure->blocks_lost++;
+    }
+    if(start_block(erasure, block, k, payload_size) < 0)
+    {
+      erasure->rx_started = 0;
+      return;
+    }
+  }
+  if(erasure->rx_done ||
+     (k != erasure->rx_k) ||
+     (payload_size != erasure->rx_symbol_size))
+  {
+    return;
+  }
+
+  /* Reduce the new row using the rows already received */
+  row_size = k + payload_size;
+  if((row_size > erasure->rx_row_size) ||
+     (k * row_size > erasure->rx_rows_size))
+  {
+    return;
+  }
+  row = erasure->rx_row;
+  get_coefficients(block, index, k, row);
+  memcpy(&row[k], payload, payload_size);
+  for(i = 0; i < k; i++)
+  {
+    if((row[i] != 0) && erasure->rx_pivots[i])
+    {
+      gf_add_scaled(erasure,
+                    row,
+                    &erasure->rx_rows[i * row_size],
+                    row[i],
+                    row_size);
+    }
+  }
+  for(pivot = 0; (pivot < k) && (row[pivot] == 0); pivot++);
+  if(pivot == k)
+  {
+    /* Not independent from the frames already received */
+    return;
+  }
+  gf_scale(erasure, row, gf_inverse(erasure, row[pivot]), row_size);
+  memcpy(&erasure->rx_rows[pivot * row_size], row, row_size);
+  erasure->rx_pivots[pivot] = 1;
+  erasure->rx_rank++;
+
+  if(erasure->rx_rank == k)
+  {
+    deliver_block(erasure, data_callback, callback_context);
+    erasure->rx_done = 1;
+    erasure->blocks_decoded++;
+  }
+}
+
+void erasure_get_statistics(erasure_t erasure,
+                            unsigned long int *blocks_decoded,
+                            unsigned long int *blocks_lost)
+{
+  *blocks_decoded = erasure->blocks_decoded;
+  *blocks_lost = erasure->blocks_lost;
+  if(erasure->rx_started && !erasure->rx_done)
+  {
+    (*blocks_lost)++;
+  }
+}
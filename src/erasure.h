@@ -0,0 +1,82 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ERASURE_H
+#define ERASURE_H
+
+/* Header of the frames when erasure coding is used:
+ *  - transfer id (4 bytes)
+ *  - frame counter (4 bytes)
+ *  - block number (4 bytes)
+ *  - index of the frame in the block (2 bytes)
+ *  - number of source frames in the block (1 byte)
+ */
+#define ERASURE_HEADER_SIZE 15
+
+/* Maximum number of source frames in a block */
+#define ERASURE_MAX_BLOCK_SIZE 255
+
+/* Maximum number of repair frames for a block */
+#define ERASURE_MAX_REPAIR_FRAMES (65536 - ERASURE_MAX_BLOCK_SIZE)
+
+typedef struct erasure_s *erasure_t;
+
+/* Create the state of an erasure coding layer
+ *  - block_size: number of source frames in a block
+ *  - repair_frames: number of repair frames sent after each block
+ *
+ * If the initialization fails, the function returns NULL.
+ */
+erasure_t erasure_create(unsigned int block_size, unsigned int repair_frames);
+
+/* Cleanup after an erasure coding layer */
+void erasure_free(erasure_t erasure);
+
+/* Get the next frame to send
+ * The data for a block of source frames is obtained by calling
+ * 'data_callback', then the source frames and the repair frames are returned
+ * one by one. The function writes the header (after the transfer id) and
+ * the payload of the frame, and returns the size of the payload. It returns
+ * 0 if there is nothing to send for now, and -1 when there is no more data.
+ */
+int erasure_get_frame(erasure_t erasure,
+                      unsigned char *header,
+                      unsigned char *payload,
+                      unsigned int payload_size,
+                      int (*data_callback)(void *, unsigned char *, unsigned int),
+                      void *callback_context);
+
+/* Process a received frame
+ * When enough frames of a block have been received, the source frames are
+ * reconstructed and their data is given in order to 'data_callback'.
+ */
+void erasure_frame_received(erasure_t erasure,
+                            unsigned char *header,
+                            unsigned char *payload,
+                            unsigned int payload_size,
+                            int (*data_callback)(void *, unsigned char *, unsigned int),
+                            void *callback_context);
+
+/* Get the number of blocks decoded and lost by the receiver */
+void erasure_get_statistics(erasure_t erasure,
+                            unsigned long int *blocks_decoded,
+                            unsigned long int *blocks_lost);
+
+#endif
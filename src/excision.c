@@ -0,0 +1,170 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <complex.h>
+#include <math.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <time.h>
+#include "excision.h"
+
+/* Number of coefficients of the predictor */
+#define ORDER 32
+
+/* Step size of the normalized LMS algorithm */
+#define STEP 0.005
+
+/* Narrowband signals are predictable from the samples received a few chips
+ * before, but the DSSS signal and the noise are not. The excision stage
+ * predicts each sample from the samples received more than 2 chips before
+ * with an adaptive linear predictor, and only keeps the prediction error,
+ * which removes the carriers and other narrowband interferers without
+ * affecting the DSSS signal much. */
+struct excision_s
+{
+  unsigned int delay;
+  /* Past samples, the most recent first, twice to avoid wrapping */
+  complex float *history;
+  unsigned int history_size;
+  unsigned int index;
+  complex float weights[ORDER];
+  float energy;
+  double input_power;
+  double output_power;
+  clock_t cpu_time;
+};
+
+excision_t excision_create(unsigned int samples_per_chip)
+{
+  excision_t excision = malloc(sizeof(struct excision_s));
+
+  if(excision == NULL)
+  {
+    return(NULL);
+  }
+  bzero(excision, sizeof(struct excision_s));
+  excision->delay = 2 * samples_per_chip;
+  excision->history_size = excision->delay + ORDER;
+  excision->history = malloc(2 * excision->history_size *
+                             sizeof(complex float));
+  if(excision->history == NULL)
+  {
+    free(excision);
+    return(NULL);
+  }
+  excision_reset(excision);
+
+  return(excision);
+}
+
+void excision_free(excision_t excision)
+{
+  if(excision)
+  {
+    free(excision->history);
+    free(excision);
+  }
+}
+
+void excision_reset(excision_t excision)
+{
+  bzero(excision->history,
+        2 * excision->history_size * sizeof(complex float));
+  bzero(excision->weights, sizeof(excision->weights));
+  excision->index = 0;
+  excision->energy = 0;
+}
+
+void excision_execute(excision_t excision,
+                      complex float *samples,
+                      unsigned int samples_size)
+{
+  clock_t start = clock();
+  complex float *past;
+  complex float prediction;
+  complex float error;
+  complex float x;
+  float step;
+  unsigned int i;
+  unsigned int j;
+
+  for(i = 0; i < samples_size; i++)
+  {
+    x = samples[i];
+    /* Samples used by the predictor: x[n - delay - j] */
+    past = &excision->history[excision->index + excision->delay];
+    prediction = 0;
+    for(j = 0; j < ORDER; j++)
+    {
+      prediction += conjf(excision->weights[j]) * past[j];
+    }
+    error = x - prediction;
+    step = STEP / (excision->energy + 1e-6);
+    for(j = 0; j < ORDER; j++)
+    {
+      excision->weights[j] += step * past[j] * conjf(error);
+    }
+
+    /* Update the energy of the samples used by the predictor and insert the
+     * new sample in the history */
+    excision->energy -= crealf(past[ORDER - 1] * conjf(past[ORDER - 1]));
+    excision->energy += crealf(past[-1] * conjf(past[-1]));
+    if(excision->energy < 0)
+    {
+      excision->energy = 0;
+    }
+    excision->index = (excision->index == 0) ?
+      excision->history_size - 1 :
+      excision->index - 1;
+    excision->history[excision->index] = x;
+    excision->history[excision->index + excision->history_size] = x;
+    if(excision->index == 0)
+    {
+      /* Compute the energy again from time to time to avoid accumulating
+       * rounding errors */
+      past = &excision->history[excision->delay];
+      excision->energy = 0;
+      for(j = 0; j < ORDER; j++)
+      {
+        excision->energy += crealf(past[j] * conjf(past[j]));
+      }
+    }
+
+    excision->input_power += crealf(x * conjf(x));
+    excision->output_power += crealf(error * conjf(error));
+    samples[i] = error;
+  }
+
+  excision->cpu_time += clock() - start;
+}
+
+float excision_get_suppression(excision_t excision)
+{
+  if((excision->input_power <= 0) || (excision->output_power <= 0))
+  {
+    return(0);
+  }
+  return(10 * log10(excision->input_power / excision->output_power));
+}
+
+double excision_get_cpu_time(excision_t excision)
+{
+  return((double) excision->cpu_time / CLOCKS_PER_SEC);
+}
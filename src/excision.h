@@ -0,0 +1,53 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EXCISION_H
+#define EXCISION_H
+
+#include <complex.h>
+
+typedef struct excision_s *excision_t;
+
+/* Create a narrowband interference excision stage
+ *  - samples_per_chip: number of samples per chip of the input samples
+ *
+ * If the initialization fails, the function returns NULL.
+ */
+excision_t excision_create(unsigned int samples_per_chip);
+
+/* Cleanup after an excision stage */
+void excision_free(excision_t excision);
+
+/* Forget the interference learned from the previous samples */
+void excision_reset(excision_t excision);
+
+/* Remove the narrowband interference from a block of samples (in place) */
+void excision_execute(excision_t excision,
+                      complex float *samples,
+                      unsigned int samples_size);
+
+/* Get the ratio between the power of the input samples and the power of the
+ * output samples (dB) */
+float excision_get_suppression(excision_t excision);
+
+/* Get the processor time used by the excision stage (seconds) */
+double excision_get_cpu_time(excision_t excision);
+
+#endif
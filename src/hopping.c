@@ -0,0 +1,198 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <strings.h>
+#include "hopping.h"
+
+struct hopping_s
+{
+  unsigned int channels;
+  float spacing;
+  uint32_t seed;
+  /* Permutation of the channels for the current period */
+  unsigned int *permutation;
+  unsigned int period;
+  unsigned char permutation_valid;
+
+  /* Receiver */
+  unsigned char rx_synchronized;
+  unsigned int rx_counter;
+  double rx_time;
+  double rx_frame_time;
+  unsigned int rx_expected;
+};
+
+static uint32_t next_random(uint32_t *state)
+{
+  /* xorshift32 */
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return(*state);
+}
+
+/* Shuffle the channels for a period of the pattern */
+static void make_permutation(hopping_t hopping, unsigned int period)
+{
+  uint32_t state = hopping->seed ^ (period * 0x9e3779b9);
+  unsigned int i;
+  unsigned int j;
+  unsigned int tmp;
+
+  if(state == 0)
+  {
+    state = 0x9e3779b9;
+  }
+  for(i = 0; i < hopping->channels; i++)
+  {
+    hopping->permutation[i] = i;
+  }
+  for(i = hopping->channels - 1; i > 0; i--)
+  {
+    j = next_random(&state) % (i + 1);
+    tmp = hopping->permutation[i];
+    hopping->permutation[i] = hopping->permutation[j];
+    hopping->permutation[j] = tmp;
+  }
+  hopping->period = period;
+  hopping->permutation_valid = 1;
+}
+
+hopping_t hopping_create(unsigned int channels, float spacing, char *id)
+{
+  hopping_t hopping;
+  unsigned int i;
+
+  if((channels < 2) || (channels > HOPPING_MAX_CHANNELS) || (spacing <= 0))
+  {
+    return(NULL);
+  }
+  hopping = malloc(sizeof(struct hopping_s));
+  if(hopping == NULL)
+  {
+    return(NULL);
+  }
+  bzero(hopping, sizeof(struct hopping_s));
+  hopping->permutation = malloc(channels * sizeof(unsigned int));
+  if(hopping->permutation == NULL)
+  {
+    free(hopping);
+    return(NULL);
+  }
+  hopping->channels = channels;
+  hopping->spacing = spacing;
+  /* FNV-1a hash of the id */
+  hopping->seed = 2166136261U;
+  for(i = 0; (i < 4) && (id[i] != '\0'); i++)
+  {
+    hopping->seed = (hopping->seed ^ (unsigned char) id[i]) * 16777619U;
+  }
+
+  return(hopping);
+}
+
+void hopping_free(hopping_t hopping)
+{
+  if(hopping)
+  {
+    free(hopping->permutation);
+    free(hopping);
+  }
+}
+
+float hopping_get_offset(hopping_t hopping, unsigned int counter)
+{
+  unsigned int period = counter / hopping->channels;
+
+  if(!hopping->permutation_valid || (hopping->period != period))
+  {
+    make_permutation(hopping, period);
+  }
+
+  return((hopping->permutation[counter % hopping->channels] -
+          ((hopping->channels - 1) / 2.0)) * hopping->spacing);
+}
+
+float hopping_get_max_offset(hopping_t hopping)
+{
+  return(((hopping->channels - 1) / 2.0) * hopping->spacing);
+}
+
+void hopping_reset(hopping_t hopping)
+{
+  hopping->rx_synchronized = 0;
+  hopping->rx_counter = 0;
+  hopping->rx_time = 0;
+  hopping->rx_frame_time = 0;
+  hopping->rx_expected = 0;
+}
+
+void hopping_frame_received(hopping_t hopping,
+                            unsigned int counter,
+                            double time)
+{
+  if(hopping->rx_synchronized && (counter > hopping->rx_counter))
+  {
+    hopping->rx_frame_time = (time - hopping->rx_time) /
+      (counter - hopping->rx_counter);
+  }
+  else if(hopping->rx_synchronized && (counter < hopping->rx_counter))
+  {
+    /* New transfer, the time between its frames may be different */
+    hopping->rx_frame_time = 0;
+  }
+  hopping->rx_synchronized = 1;
+  hopping->rx_counter = counter;
+  hopping->rx_time = time;
+  hopping->rx_expected = counter + 1;
+}
+
+int hopping_update(hopping_t hopping, double time, int frame_open)
+{
+  double deadline;
+
+  if(!hopping->rx_synchronized || (hopping->rx_frame_time <= 0) || frame_open)
+  {
+    /* Wait on the channel until a frame is received, the pattern comes
+     * back to each channel once per period */
+    return(0);
+  }
+  /* The expected frame began about when the previous one ended */
+  deadline = hopping->rx_time +
+    ((hopping->rx_expected - hopping->rx_counter - 0.5) *
+     hopping->rx_frame_time);
+  if((time < deadline) ||
+     (hopping->rx_expected - hopping->rx_counter > 2 * hopping->channels))
+  {
+    /* After missing too many frames, the estimated time between frames may
+     * not be accurate enough anymore, wait on the channel */
+    return(0);
+  }
+  hopping->rx_expected++;
+
+  return(1);
+}
+
+unsigned int hopping_get_expected(hopping_t hopping)
+{
+  return(hopping->rx_expected);
+}
@@ -0,0 +1,78 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HOPPING_H
+#define HOPPING_H
+
+/* Maximum number of channels */
+#define HOPPING_MAX_CHANNELS 256
+
+/* Minimum silence between two frames sent on different channels (s), giving
+ * the receiver time to retune before the preamble of the next frame */
+#define HOPPING_GUARD_TIME 0.01
+
+typedef struct hopping_s *hopping_t;
+
+/* Create the state of a frequency hopping pattern
+ *  - channels: number of channels
+ *  - spacing: frequency between two adjacent channels (Hz)
+ *  - id: transfer id (4 bytes), used as seed for the pattern
+ *
+ * The channels are centered on the frequency of the transfer. The frame
+ * with counter 'c' is sent on the channel given by the permutation of the
+ * channels for the period 'c / channels', at index 'c % channels', so every
+ * channel is used once per period.
+ * If the initialization fails, the function returns NULL.
+ */
+hopping_t hopping_create(unsigned int channels, float spacing, char *id);
+
+/* Cleanup after a frequency hopping pattern */
+void hopping_free(hopping_t hopping);
+
+/* Get the offset (Hz) of the channel of the frame with counter 'counter'
+ * from the center frequency */
+float hopping_get_offset(hopping_t hopping, unsigned int counter);
+
+/* Get the maximum offset (Hz) of a channel from the center frequency */
+float hopping_get_max_offset(hopping_t hopping);
+
+/* Forget the frames received by a previous transfer */
+void hopping_reset(hopping_t hopping);
+
+/* Tell the receiver that a frame with counter 'counter' was received
+ * at 'time' (s). The next frame is expected on the channel of counter + 1.
+ * The time between frames is estimated from the counters and the times of
+ * the frames received. */
+void hopping_frame_received(hopping_t hopping,
+                            unsigned int counter,
+                            double time);
+
+/* Check whether the expected frame has been missed
+ * When no frame has been detected ('frame_open' is 0) half a frame after
+ * the beginning of the expected frame, the receiver moves on to the channel
+ * of the next frame. The function returns 1 if the expected frame changed,
+ * and 0 otherwise.
+ */
+int hopping_update(hopping_t hopping, double time, int frame_open);
+
+/* Get the counter of the frame expected by the receiver */
+unsigned int hopping_get_expected(hopping_t hopping);
+
+#endif
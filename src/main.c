@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include "dsss-transfer.h"
 #include "gettext.h"
@@ -50,33 +51,105 @@ void usage()
   printf(_("Usage: dsss-transfer [options] [filename]\n"));
   printf("\n");
   printf(_("Options:\n"));
+  printf(_("  -A <range>  (default: 0 Hz)\n"));
+  printf(_("    When receiving, search for frames with a carrier frequency\n"
+           "    offset of up to +/- 'range' Hz. This uses more processing\n"
+           "    power, but it can receive frames from radios with a large\n"
+           "    clock error. A range of 0 disables the search.\n"));
   printf("  -a\n");
   printf(_("    Use audio samples instead of IQ samples.\n"));
   printf(_("  -b <bit rate>  (default: 100 b/s)\n"));
   printf(_("    Bit rate of the DSSS transmission.\n"));
+  printf("  -C\n");
+  printf(_("    When receiving, track the carrier and the timing from one\n"
+           "    frame to the next. This is useful for long continuous\n"
+           "    transmissions.\n"));
   printf(_("  -c <ppm>  (default: 0.0, can be negative)\n"));
-  printf(_("    Correction for the radio clock.\n"));
+  printf(_("    Correction for the radio clock. If 'ppm' is 'auto', the clock\n"
+           "    error is estimated from the received frames and corrected\n"
+           "    continuously. The estimate is saved for the next transfers\n"
+           "    using the same radio.\n"));
   printf(_("  -d <filename>\n"));
   printf(_("    Dump a copy of the samples sent to or received from\n"
            "    the radio.\n"));
+  printf(_("  -E <frames[,repair]>  (default: 0,0)\n"));
+  printf(_("    Erasure coding. When sending, add 'repair' frames after\n"
+           "    each block of 'frames' frames (at most 255), so that any\n"
+           "    receiver can rebuild a block from any 'frames' frames of\n"
+           "    the block. When receiving, any non-zero 'frames' enables\n"
+           "    the decoding. 0 disables erasure coding.\n"));
   printf(_("  -e <fec[,fec]>  (default: h128,none)\n"));
   printf(_("    Inner and outer forward error correction codes to use.\n"));
+  printf(_("  -F <offset>  (default: 0)\n"));
+  printf(_("    When sending a file, start at 'offset' bytes in the file,\n"
+           "    to resume an interrupted transfer. The receiver should use\n"
+           "    '-R' to complete the file it has already received.\n"));
   printf(_("  -f <frequency>  (default: 434000000 Hz)\n"));
   printf(_("    Frequency of the DSSS transmission.\n"));
   printf(_("  -g <gain>  (default: 0)\n"));
   printf(_("    Gain of the radio transceiver, or audio gain in dB.\n"));
+  printf(_("  -H <fec[,fec[,crc]]>  (default: same as '-e', crc32)\n"));
+  printf(_("    Inner and outer forward error correction codes, and CRC\n"
+           "    to use for the headers of the frames. When omitted, the\n"
+           "    CRC defaults to crc32.\n"));
   printf("  -h\n");
   printf(_("    This help.\n"));
+  printf(_("  -I <depth>  (default: 1)\n"));
+  printf(_("    When sending, spread the payload of each frame over\n"
+           "    'depth' consecutive frames (at most 16) to resist bursts\n"
+           "    of errors destroying whole frames. The FEC must be strong\n"
+           "    enough to correct the missing parts.\n"));
   printf(_("  -i <id>  (default: \"\")\n"));
   printf(_("    Transfer id (at most 4 bytes). When receiving, the frames\n"
            "    with a different id will be ignored.\n"));
+  printf(_("  -J <channels,spacing>  (default: 0,0)\n"));
+  printf(_("    Frequency hopping. Send each frame on one of 'channels'\n"
+           "    channels separated by 'spacing' Hz around the frequency,\n"
+           "    following a pattern derived from the transfer id. The\n"
+           "    channels must fit in the sample rate. 0 disables frequency\n"
+           "    hopping.\n"));
+  printf(_("  -K <frames>  (default: 0)\n"));
+  printf(_("    When receiving, keep the soft symbols of the last 'frames'\n"
+           "    frames that could not be decoded, and combine them with\n"
+           "    the next copies of the same frames (repeated by ARQ or by\n"
+           "    a carousel) before decoding them again.\n"));
+  printf(_("  -L <passes>  (default: 1)\n"));
+  printf(_("    When sending a file, number of times the file is sent\n"
+           "    (0 for no limit). The repetitions carry the same offsets,\n"
+           "    so a receiver using '-R' can merge them and stop as soon\n"
+           "    as it has all the data. This implies '-X'.\n"));
+  printf(_("  -M <radio>\n"));
+  printf(_("    When receiving, also receive the frames with 'radio'\n"
+           "    (diversity reception). Each radio decodes the frames in\n"
+           "    its own thread, and the first copy of each frame is kept.\n"
+           "    This option can be used several times (at most 7).\n"));
+  printf("  -N\n");
+  printf(_("    When receiving, remove the narrowband interference (like\n"
+           "    carriers) in the band of the transfer before despreading.\n"));
   printf(_("  -n <factor>  (default: 64, must be between 2 and 64)\n"));
   printf(_("    Spectrum spreading factor.\n"));
   printf(_("  -o <offset>  (default: 0 Hz, can be negative)\n"));
   printf(_("    Set the central frequency of the transceiver 'offset' Hz\n"
            "    lower than the signal frequency to send or receive.\n"));
+  printf(_("  -P <threshold>  (default: 0.5)\n"));
+  printf(_("    When receiving, threshold of the preamble detector\n"
+           "    (between 0 and 1). A lower threshold can detect weaker\n"
+           "    frames, but it gives more false alarms.\n"));
+  printf(_("  -p <size>  (default: 64)\n"));
+  printf(_("    Number of symbols in the preamble of the frames (between\n"
+           "    16 and 1024). The sender and the receiver must use the\n"
+           "    same size.\n"));
+  printf("  -R\n");
+  printf(_("    When receiving to a file, write the data at its position\n"
+           "    in the file and keep a map of the data missing beside it\n"
+           "    (in 'file.map'), so that the holes can be filled by\n"
+           "    receiving the data again. This implies '-X'.\n"));
   printf(_("  -r <radio>  (default: \"\")\n"));
   printf(_("    Radio to use.\n"));
+  printf(_("  -S <frames>  (default: 1)\n"));
+  printf(_("    When sending, number of frames that can be sent after\n"
+           "    a single preamble. Sending several frames without preamble\n"
+           "    increases the throughput for long transmissions.\n"));
   printf(_("  -s <sample rate>  (default: 2000000 S/s)\n"));
   printf(_("    Sample rate to use.\n"));
   printf(_("  -T <timeout>  (default: 0 s)\n"));
@@ -90,6 +163,10 @@ void usage()
   printf(_("    Wait a little before switching the radio off.\n"
            "    This can be useful if the hardware needs some time to send\n"
            "    the last samples it has buffered.\n"));
+  printf("  -X\n");
+  printf(_("    Use an extended header giving the position of the data\n"
+           "    in the stream. The receiver can detect the data lost,\n"
+           "    and stop as soon as the end of the stream is received.\n"));
   printf("\n");
   printf(_("By default the program is in 'receive' mode.\n"
            "Use the '-t' option to use the 'transmit' mode.\n"));
@@ -161,9 +238,41 @@ void get_fec_schemes(char *str, char *inner_fec, char *outer_fec)
   }
 }
 
+void get_header_schemes(char *str, char *inner_fec, char *outer_fec, char *crc)
+{
+  unsigned int size = strlen(str);
+  char spec[size + 1];
+  char *separation;
+
+  strcpy(spec, str);
+  strcpy(crc, "crc32");
+  if((separation = strchr(spec, ',')) != NULL)
+  {
+    separation = strchr(separation + 1, ',');
+  }
+  if(separation != NULL)
+  {
+    *separation = '\0';
+    if(strlen(separation + 1) < 32)
+    {
+      strcpy(crc, separation + 1);
+    }
+    else
+    {
+      strcpy(crc, "unknown");
+    }
+  }
+
+  get_fec_schemes(spec, inner_fec, outer_fec);
+}
+
 int main(int argc, char **argv)
 {
   dsss_transfer_t transfer;
+  dsss_transfer_t branches[argc];
+  char *diversity_radios[argc];
+  unsigned int diversity_radios_count = 0;
+  unsigned int i;
   char *radio_driver = "";
   unsigned int emit = 0;
   unsigned long int sample_rate = 2000000;
@@ -175,6 +284,10 @@ int main(int argc, char **argv)
   unsigned int spreading_factor = 64;
   char inner_fec[32];
   char outer_fec[32];
+  char header_inner_fec[32];
+  char header_outer_fec[32];
+  char header_crc[32];
+  unsigned char header_fec = 0;
   char *id = "";
   char *file = NULL;
   char *dump = NULL;
@@ -183,6 +296,24 @@ int main(int argc, char **argv)
   unsigned int final_delay_usec = 0;
   unsigned int timeout = 0;
   unsigned char audio = 0;
+  unsigned int acquisition_range = 0;
+  unsigned char auto_ppm = 0;
+  unsigned char tracking = 0;
+  unsigned char excision = 0;
+  unsigned int superframe = 1;
+  unsigned int interleaving = 1;
+  unsigned int passes = 1;
+  unsigned int combining = 0;
+  unsigned long long int start_offset = 0;
+  unsigned char extended_header = 0;
+  unsigned char random_access = 0;
+  unsigned int preamble_size = 64;
+  float detector_threshold = 0.5;
+  unsigned int erasure_block_size = 0;
+  unsigned int erasure_repair_frames = 0;
+  unsigned int hopping_channels = 0;
+  unsigned int hopping_spacing = 0;
+  char *separation;
   int opt;
 
   strcpy(inner_fec, "h128");
@@ -193,10 +324,14 @@ int main(int argc, char **argv)
   bindtextdomain(PACKAGE, LOCALEDIR);
   textdomain(PACKAGE);
 
-  while((opt = getopt(argc, argv, "ab:c:d:e:f:g:hi:n:o:r:s:T:tvw:")) != -1)
+  while((opt = getopt(argc, argv, "A:ab:Cc:d:E:e:F:f:g:H:hI:i:J:K:L:M:Nn:o:P:p:Rr:S:s:T:tvw:X")) != -1)
   {
     switch(opt)
     {
+    case 'A':
+      acquisition_range = strtoul(optarg, NULL, 10);
+      break;
+
     case 'a':
       audio = 1;
       break;
@@ -205,18 +340,41 @@ int main(int argc, char **argv)
       bit_rate = strtoul(optarg, NULL, 10);
       break;
 
+    case 'C':
+      tracking = 1;
+      break;
+
     case 'c':
-      ppm = strtof(optarg, NULL);
+      if(strcasecmp(optarg, "auto") == 0)
+      {
+        auto_ppm = 1;
+      }
+      else
+      {
+        ppm = strtof(optarg, NULL);
+      }
       break;
 
     case 'd':
       dump = optarg;
       break;
 
+    case 'E':
+      erasure_block_size = strtoul(optarg, NULL, 10);
+      separation = strchr(optarg, ',');
+      erasure_repair_frames = (separation != NULL) ?
+        strtoul(separation + 1, NULL, 10) :
+        0;
+      break;
+
     case 'e':
       get_fec_schemes(optarg, inner_fec, outer_fec);
       break;
 
+    case 'F':
+      start_offset = strtoull(optarg, NULL, 10);
+      break;
+
     case 'f':
       frequency = strtoul(optarg, NULL, 10);
       break;
@@ -225,14 +383,48 @@ int main(int argc, char **argv)
       gain = optarg;
       break;
 
+    case 'H':
+      get_header_schemes(optarg, header_inner_fec, header_outer_fec, header_crc);
+      header_fec = 1;
+      break;
+
     case 'h':
       usage();
       return(EXIT_SUCCESS);
 
+    case 'I':
+      interleaving = strtoul(optarg, NULL, 10);
+      break;
+
     case 'i':
       id = optarg;
       break;
 
+    case 'J':
+      hopping_channels = strtoul(optarg, NULL, 10);
+      separation = strchr(optarg, ',');
+      hopping_spacing = (separation != NULL) ?
+        strtoul(separation + 1, NULL, 10) :
+        0;
+      break;
+
+    case 'K':
+      combining = strtoul(optarg, NULL, 10);
+      break;
+
+    case 'L':
+      passes = strtoul(optarg, NULL, 10);
+      break;
+
+    case 'M':
+      diversity_radios[diversity_radios_count] = optarg;
+      diversity_radios_count++;
+      break;
+
+    case 'N':
+      excision = 1;
+      break;
+
     case 'n':
       spreading_factor = strtoul(optarg, NULL, 10);
       break;
@@ -241,10 +433,26 @@ int main(int argc, char **argv)
       frequency_offset = strtol(optarg, NULL, 10);
       break;
 
+    case 'P':
+      detector_threshold = strtof(optarg, NULL);
+      break;
+
+    case 'p':
+      preamble_size = strtoul(optarg, NULL, 10);
+      break;
+
+    case 'R':
+      random_access = 1;
+      break;
+
     case 'r':
       radio_driver = optarg;
       break;
 
+    case 'S':
+      superframe = strtoul(optarg, NULL, 10);
+      break;
+
     case 's':
       sample_rate = strtoul(optarg, NULL, 10);
       break;
@@ -265,6 +473,10 @@ int main(int argc, char **argv)
       final_delay = strtof(optarg, NULL);
       break;
 
+    case 'X':
+      extended_header = 1;
+      break;
+
     default:
       fprintf(stderr, _("Error: Unknown parameter: '-%c %s'\n"), opt, optarg);
       return(EXIT_FAILURE);
@@ -304,6 +516,90 @@ int main(int argc, char **argv)
     fprintf(stderr, _("Error: Failed to initialize transfer\n"));
     return(EXIT_FAILURE);
   }
+  dsss_transfer_set_acquisition_range(transfer, acquisition_range);
+  if(auto_ppm)
+  {
+    dsss_transfer_set_auto_ppm(transfer, 1);
+  }
+  dsss_transfer_set_tracking(transfer, tracking);
+  dsss_transfer_set_excision(transfer, excision);
+  dsss_transfer_set_combining(transfer, combining);
+  dsss_transfer_set_superframe(transfer, superframe);
+  dsss_transfer_set_interleaving(transfer, interleaving);
+  dsss_transfer_set_extended_header(transfer, extended_header);
+  if(random_access)
+  {
+    dsss_transfer_set_random_access(transfer, 1);
+  }
+  dsss_transfer_set_carousel(transfer, passes);
+  dsss_transfer_set_start_offset(transfer, start_offset);
+  if(header_fec)
+  {
+    dsss_transfer_set_header_fec(transfer,
+                                 header_inner_fec,
+                                 header_outer_fec,
+                                 header_crc);
+  }
+  dsss_transfer_set_preamble_size(transfer, preamble_size);
+  dsss_transfer_set_detector_threshold(transfer, detector_threshold);
+  if(erasure_block_size > 0)
+  {
+    dsss_transfer_set_erasure_coding(transfer,
+                                     erasure_block_size,
+                                     erasure_repair_frames);
+  }
+  if(hopping_channels > 0)
+  {
+    dsss_transfer_set_hopping(transfer, hopping_channels, hopping_spacing);
+  }
+  for(i = 0; i < diversity_radios_count; i++)
+  {
+    /* The other radios use the same reception settings */
+    branches[i] = dsss_transfer_create_callback(diversity_radios[i],
+                                                0,
+                                                NULL,
+                                                NULL,
+                                                sample_rate,
+                                                bit_rate,
+                                                frequency,
+                                                frequency_offset,
+                                                gain,
+                                                ppm,
+                                                spreading_factor,
+                                                inner_fec,
+                                                outer_fec,
+                                                id,
+                                                NULL,
+                                                0,
+                                                audio);
+    if(branches[i] == NULL)
+    {
+      fprintf(stderr, _("Error: Failed to initialize transfer\n"));
+      return(EXIT_FAILURE);
+    }
+    dsss_transfer_set_acquisition_range(branches[i], acquisition_range);
+    if(auto_ppm)
+    {
+      dsss_transfer_set_auto_ppm(branches[i], 1);
+    }
+    dsss_transfer_set_tracking(branches[i], tracking);
+    dsss_transfer_set_excision(branches[i], excision);
+    dsss_transfer_set_combining(branches[i], combining);
+    if(header_fec)
+    {
+      dsss_transfer_set_header_fec(branches[i],
+                                   header_inner_fec,
+                                   header_outer_fec,
+                                   header_crc);
+    }
+    dsss_transfer_set_preamble_size(branches[i], preamble_size);
+    dsss_transfer_set_detector_threshold(branches[i], detector_threshold);
+    if(hopping_channels > 0)
+    {
+      dsss_transfer_set_hopping(branches[i], hopping_channels, hopping_spacing);
+    }
+    dsss_transfer_add_diversity_branch(transfer, branches[i]);
+  }
   dsss_transfer_start(transfer);
   if(final_delay > 0)
   {
@@ -320,6 +616,10 @@ int main(int argc, char **argv)
     }
   }
   dsss_transfer_free(transfer);
+  for(i = 0; i < diversity_radios_count; i++)
+  {
+    dsss_transfer_free(branches[i]);
+  }
 
   if(dsss_transfer_is_verbose())
   {
@@ -0,0 +1,190 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dsss-transfer.h"
+
+struct context_s
+{
+  unsigned char data[128];
+  unsigned int size;
+  unsigned int index;
+};
+
+int read_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+  unsigned int size = payload_size;
+
+  if(ctx->index == ctx->size)
+  {
+    return(-1);
+  }
+  if(ctx->index + size > ctx->size)
+  {
+    size = ctx->size - ctx->index;
+  }
+  memcpy(payload, ctx->data + ctx->index, size);
+  ctx->index += size;
+
+  return(size);
+}
+
+int write_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+
+  if(ctx->size + payload_size > sizeof(ctx->data))
+  {
+    payload_size = sizeof(ctx->data) - ctx->size;
+  }
+  memcpy(ctx->data + ctx->size, payload, payload_size);
+  ctx->size += payload_size;
+
+  return(payload_size);
+}
+
+/* Run a transfer in the background and wait for its end with poll(), as an
+ * event loop would do. The function returns the events received. */
+unsigned int run(dsss_transfer_t transfer)
+{
+  struct pollfd event;
+  unsigned int events = 0;
+
+  event.fd = dsss_transfer_get_event_fd(transfer);
+  event.events = POLLIN;
+  if((event.fd < 0) || (dsss_transfer_start_async(transfer) != 0))
+  {
+    return(0);
+  }
+  while(!(events & DSSS_TRANSFER_EVENT_DONE))
+  {
+    if(poll(&event, 1, 10000) <= 0)
+    {
+      fprintf(stderr, "Error: No event received\n");
+      dsss_transfer_stop(transfer);
+      break;
+    }
+    events |= dsss_transfer_get_events(transfer);
+  }
+  dsss_transfer_wait(transfer);
+
+  return(events);
+}
+
+int main()
+{
+  dsss_transfer_t send;
+  dsss_transfer_t receive;
+  struct context_s context;
+  char message[] = "This is a test transmission using dsss-transfer.";
+  char samples_file[] = "/tmp/samples.XXXXXX";
+  char radio[64];
+  int samples_fd = mkstemp(samples_file);
+  unsigned int events;
+  int ok = 0;
+
+  fprintf(stderr, "Test: Send and receive using asynchronous transfers\n");
+
+  if(samples_fd == -1)
+  {
+    fprintf(stderr, "Error: Failed to create temporary file\n");
+    return(EXIT_FAILURE);
+  }
+  close(samples_fd);
+  snprintf(radio, sizeof(radio), "file=%s", samples_file);
+
+  bzero(&context, sizeof(context));
+  strcpy(context.data, message);
+  context.size = strlen(message);
+  send = dsss_transfer_create_callback(radio,
+                                       1,
+                                       read_data,
+                                       &context,
+                                       2000000,
+                                       1200,
+                                       434000000,
+                                       0,
+                                       "0",
+                                       0,
+                                       64,
+                                       "h128",
+                                       "none",
+                                       "",
+                                       NULL,
+                                       0,
+                                       0);
+  if(send == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    unlink(samples_file);
+    return(EXIT_FAILURE);
+  }
+  events = run(send);
+  dsss_transfer_free(send);
+
+  if(events & DSSS_TRANSFER_EVENT_DONE)
+  {
+    bzero(&context, sizeof(context));
+    receive = dsss_transfer_create_callback(radio,
+                                            0,
+                                            write_data,
+                                            &context,
+                                            2000000,
+                                            1200,
+                                            434000000,
+                                            0,
+                                            "0",
+                                            0,
+                                            64,
+                                            "h128",
+                                            "none",
+                                            "",
+                                            NULL,
+                                            0,
+                                            0);
+    if(receive == NULL)
+    {
+      fprintf(stderr, "Error: Failed to initialize transfer\n");
+      unlink(samples_file);
+      return(EXIT_FAILURE);
+    }
+    events = run(receive);
+    dsss_transfer_free(receive);
+
+    ok = (events & DSSS_TRANSFER_EVENT_DATA) &&
+      (events & DSSS_TRANSFER_EVENT_DONE) &&
+      (context.size == strlen(message)) &&
+      (memcmp(message, context.data, context.size) == 0);
+  }
+  unlink(samples_file);
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
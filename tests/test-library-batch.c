@@ -0,0 +1,166 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dsss-transfer.h"
+
+struct context_s
+{
+  unsigned char data[1024];
+  unsigned int size;
+  unsigned int calls;
+};
+
+/* Give the data to send in two buffers, used by the transfer without copy */
+int send_batch(void *context, struct iovec *buffers, unsigned int count)
+{
+  struct context_s *ctx = (struct context_s *) context;
+  unsigned int half = ctx->size / 2;
+
+  ctx->calls++;
+  if((ctx->calls > 1) || (count < 2))
+  {
+    return(-1);
+  }
+  buffers[0].iov_base = ctx->data;
+  buffers[0].iov_len = half;
+  buffers[1].iov_base = ctx->data + half;
+  buffers[1].iov_len = ctx->size - half;
+
+  return(2);
+}
+
+int receive_batch(void *context, struct iovec *payloads, unsigned int count)
+{
+  struct context_s *ctx = (struct context_s *) context;
+  unsigned int i;
+
+  ctx->calls++;
+  for(i = 0; i < count; i++)
+  {
+    if(ctx->size + payloads[i].iov_len <= sizeof(ctx->data))
+    {
+      memcpy(ctx->data + ctx->size, payloads[i].iov_base, payloads[i].iov_len);
+      ctx->size += payloads[i].iov_len;
+    }
+  }
+
+  return(count);
+}
+
+int main()
+{
+  dsss_transfer_t send;
+  dsss_transfer_t receive;
+  struct context_s send_context;
+  struct context_s receive_context;
+  unsigned int i;
+  char samples_file[] = "/tmp/samples.XXXXXX";
+  char radio[64];
+  int samples_fd = mkstemp(samples_file);
+  int ok = 0;
+
+  fprintf(stderr, "Test: Send and receive using batch callbacks\n");
+
+  if(samples_fd == -1)
+  {
+    fprintf(stderr, "Error: Failed to create temporary file\n");
+    return(EXIT_FAILURE);
+  }
+  close(samples_fd);
+  snprintf(radio, sizeof(radio), "file=%s", samples_file);
+
+  bzero(&send_context, sizeof(send_context));
+  for(i = 0; i < 600; i++)
+  {
+    send_context.data[i] = i & 255;
+  }
+  send_context.size = 600;
+  send = dsss_transfer_create_callback(radio,
+                                       1,
+                                       NULL,
+                                       NULL,
+                                       2000000,
+                                       9600,
+                                       434000000,
+                                       0,
+                                       "0",
+                                       0,
+                                       16,
+                                       "h128",
+                                       "none",
+                                       "",
+                                       NULL,
+                                       0,
+                                       0);
+  if(send == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    unlink(samples_file);
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_set_batch_callback(send, send_batch, &send_context);
+  dsss_transfer_start(send);
+  dsss_transfer_free(send);
+
+  bzero(&receive_context, sizeof(receive_context));
+  receive = dsss_transfer_create_callback(radio,
+                                          0,
+                                          NULL,
+                                          NULL,
+                                          2000000,
+                                          9600,
+                                          434000000,
+                                          0,
+                                          "0",
+                                          0,
+                                          16,
+                                          "h128",
+                                          "none",
+                                          "",
+                                          NULL,
+                                          0,
+                                          0);
+  if(receive == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    unlink(samples_file);
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_set_batch_callback(receive, receive_batch, &receive_context);
+  dsss_transfer_start(receive);
+  dsss_transfer_free(receive);
+
+  ok = (receive_context.calls > 0) &&
+    (receive_context.size == send_context.size) &&
+    (memcmp(send_context.data, receive_context.data, send_context.size) == 0);
+  unlink(samples_file);
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
@@ -0,0 +1,270 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dsss-transfer.h"
+
+#define SAMPLE_RATE 200000
+#define CHUNK_SIZE 4096
+
+#define MIN(x, y) ((x < y) ? x : y)
+
+int identical(char *message, char *decoded_file)
+{
+  FILE *decoded;
+  unsigned int size = strlen(message);
+  unsigned char buffer[1024];
+  unsigned int n;
+
+  if((decoded = fopen(decoded_file, "rb")) == NULL)
+  {
+    fprintf(stderr, "Error: Failed to open '%s'\n", decoded_file);
+    return(0);
+  }
+  n = fread(buffer, 1, sizeof(buffer), decoded);
+  fclose(decoded);
+
+  return((n == size) && (memcmp(message, buffer, size) == 0));
+}
+
+dsss_transfer_t create_transfer(unsigned char emit, char *file)
+{
+  return(dsss_transfer_create("external",
+                              emit,
+                              file,
+                              SAMPLE_RATE,
+                              1200,
+                              434000000,
+                              0,
+                              "0",
+                              0,
+                              64,
+                              "h128",
+                              "none",
+                              "",
+                              NULL,
+                              0,
+                              0));
+}
+
+/* Get all the samples of a file sent 3 times by a carousel */
+float * send_samples(char *message_file, unsigned int *samples_size)
+{
+  dsss_transfer_t send;
+  float *samples = NULL;
+  float *p;
+  unsigned int size = 0;
+  unsigned int n;
+
+  send = create_transfer(1, message_file);
+  if(send == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(NULL);
+  }
+  dsss_transfer_set_carousel(send, 3);
+  if(dsss_transfer_start_async(send) != 0)
+  {
+    dsss_transfer_free(send);
+    return(NULL);
+  }
+  do
+  {
+    p = realloc(samples, 2 * (size + CHUNK_SIZE) * sizeof(float));
+    if(p == NULL)
+    {
+      fprintf(stderr, "Error: Memory allocation failed\n");
+      dsss_transfer_stop(send);
+      free(samples);
+      samples = NULL;
+      break;
+    }
+    samples = p;
+    n = dsss_transfer_pull_samples(send, &samples[2 * size], CHUNK_SIZE);
+    size += n;
+  }
+  while(n == CHUNK_SIZE);
+  dsss_transfer_wait(send);
+  dsss_transfer_free(send);
+
+  *samples_size = size;
+  return(samples);
+}
+
+/* Add white gaussian noise with a power 'snr' dB below the power of the
+ * signal */
+void add_noise(float *samples,
+               float *noisy_samples,
+               unsigned int samples_size,
+               float snr)
+{
+  float power = 0;
+  float sigma;
+  float u1;
+  float u2;
+  unsigned int i;
+
+  for(i = 0; i < 2 * samples_size; i++)
+  {
+    power += samples[i] * samples[i];
+  }
+  power /= samples_size;
+  sigma = sqrtf((power / powf(10, snr / 10)) / 2);
+
+  srand(1);
+  for(i = 0; i < 2 * samples_size; i += 2)
+  {
+    u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    noisy_samples[i] = samples[i] + (sigma * sqrtf(-2 * logf(u1)) *
+                                     cosf(2 * M_PI * u2));
+    noisy_samples[i + 1] = samples[i + 1] + (sigma * sqrtf(-2 * logf(u1)) *
+                                             sinf(2 * M_PI * u2));
+  }
+}
+
+/* Receive the samples with random access output, combining the copies of
+ * the frames if 'combining' is not 0 */
+int receive_samples(char *message,
+                    char *decoded_file,
+                    float *samples,
+                    unsigned int samples_size,
+                    unsigned int combining)
+{
+  dsss_transfer_t receive;
+  unsigned int i;
+  unsigned int n;
+
+  if(truncate(decoded_file, 0) != 0)
+  {
+    fprintf(stderr, "Error: Failed to truncate '%s'\n", decoded_file);
+    return(0);
+  }
+  receive = create_transfer(0, decoded_file);
+  if(receive == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(0);
+  }
+  dsss_transfer_set_random_access(receive, 1);
+  dsss_transfer_set_combining(receive, combining);
+  if(dsss_transfer_start_async(receive) != 0)
+  {
+    dsss_transfer_free(receive);
+    return(0);
+  }
+  for(i = 0; i < samples_size; i += n)
+  {
+    n = MIN(CHUNK_SIZE, samples_size - i);
+    if(dsss_transfer_push_samples(receive, &samples[2 * i], n) != n)
+    {
+      /* The receiver stops as soon as it has all the data */
+      break;
+    }
+  }
+  dsss_transfer_push_samples(receive, NULL, 0);
+  dsss_transfer_wait(receive);
+  dsss_transfer_free(receive);
+
+  return(identical(message, decoded_file));
+}
+
+int main()
+{
+  char message[] = "This is a test transmission using dsss-transfer.";
+  char message_file[] = "/tmp/message.XXXXXX";
+  int message_fd = mkstemp(message_file);
+  char decoded_file[] = "/tmp/decoded.XXXXXX";
+  int decoded_fd = mkstemp(decoded_file);
+  float *samples;
+  float *noisy_samples;
+  unsigned int samples_size;
+  float snr;
+  int single;
+  int combined;
+  int ok = 0;
+
+  fprintf(stderr, "Test: Soft combining of the copies sent by a carousel\n");
+
+  if((message_fd == -1) || (decoded_fd == -1))
+  {
+    fprintf(stderr, "Error: Failed to create temporary files\n");
+    return(EXIT_FAILURE);
+  }
+  write(message_fd, message, strlen(message));
+  close(message_fd);
+  close(decoded_fd);
+
+  samples = send_samples(message_file, &samples_size);
+  noisy_samples = malloc(2 * samples_size * sizeof(float));
+  if((samples == NULL) || (noisy_samples == NULL))
+  {
+    free(samples);
+    free(noisy_samples);
+    unlink(message_file);
+    unlink(decoded_file);
+    return(EXIT_FAILURE);
+  }
+
+  /* Lower the signal to noise ratio until the copies of some frames can't
+   * be decoded separately anymore; combining them must still give the whole
+   * file */
+  for(snr = -12; snr >= -36; snr -= 2)
+  {
+    add_noise(samples, noisy_samples, samples_size, snr);
+    single = receive_samples(message,
+                             decoded_file,
+                             noisy_samples,
+                             samples_size,
+                             0);
+    combined = receive_samples(message,
+                               decoded_file,
+                               noisy_samples,
+                               samples_size,
+                               16);
+    fprintf(stderr,
+            "SNR %.0f dB: single copies %s, combining %s\n",
+            snr,
+            single ? "ok" : "failed",
+            combined ? "ok" : "failed");
+    if(!single)
+    {
+      ok = combined;
+      break;
+    }
+  }
+
+  free(samples);
+  free(noisy_samples);
+  unlink(message_file);
+  unlink(decoded_file);
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
@@ -0,0 +1,110 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <complex.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "excision.h"
+
+#define SAMPLES_PER_CHIP 2
+#define BLOCK_SIZE 1000
+#define BLOCKS 200
+/* The suppression is measured once the predictor has converged */
+#define MEASURED_BLOCKS 50
+#define TONE_AMPLITUDE 10
+#define TONE_FREQUENCY 0.05
+
+int main()
+{
+  excision_t excision;
+  complex float chips[BLOCK_SIZE];
+  complex float samples[BLOCK_SIZE];
+  complex float tone_correlation = 0;
+  complex float chip_correlation = 0;
+  float chip_energy = 0;
+  float tone_power;
+  float chip_gain;
+  unsigned long int n = 0;
+  unsigned int i;
+  unsigned int j;
+  int ok;
+
+  fprintf(stderr, "Test: Narrowband interference excision\n");
+
+  excision = excision_create(SAMPLES_PER_CHIP);
+  if(excision == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize excision stage\n");
+    return(EXIT_FAILURE);
+  }
+
+  /* Random QPSK chips with a strong tone 20 dB above them */
+  srand(1);
+  for(i = 0; i < BLOCKS; i++)
+  {
+    for(j = 0; j < BLOCK_SIZE; j++, n++)
+    {
+      if((j % SAMPLES_PER_CHIP) == 0)
+      {
+        chips[j] = (((rand() & 1) ? M_SQRT1_2 : -M_SQRT1_2) +
+                    (((rand() & 1) ? M_SQRT1_2 : -M_SQRT1_2) * I));
+      }
+      else
+      {
+        chips[j] = chips[j - 1];
+      }
+      samples[j] = chips[j] + (TONE_AMPLITUDE *
+                               cexpf(2 * M_PI * TONE_FREQUENCY * n * I));
+    }
+    excision_execute(excision, samples, BLOCK_SIZE);
+    if(i >= BLOCKS - MEASURED_BLOCKS)
+    {
+      for(j = 0; j < BLOCK_SIZE; j++)
+      {
+        tone_correlation += samples[j] * cexpf(-2 * M_PI * TONE_FREQUENCY *
+                                               (n - BLOCK_SIZE + j) * I);
+        chip_correlation += samples[j] * conjf(chips[j]);
+        chip_energy += crealf(chips[j] * conjf(chips[j]));
+      }
+    }
+  }
+  excision_free(excision);
+
+  /* The tone must be attenuated by at least 20 dB, and most of the chips
+   * must remain */
+  tone_power = crealf(tone_correlation * conjf(tone_correlation)) /
+    powf(MEASURED_BLOCKS * BLOCK_SIZE, 2);
+  chip_gain = crealf(chip_correlation) / chip_energy;
+  fprintf(stderr,
+          "Tone attenuated by %.1f dB, chip gain %.2f\n",
+          10 * log10f((TONE_AMPLITUDE * TONE_AMPLITUDE) / tone_power),
+          chip_gain);
+  ok = (tone_power < (TONE_AMPLITUDE * TONE_AMPLITUDE) / 100.0) &&
+    (chip_gain > 0.7);
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
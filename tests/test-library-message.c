@@ -0,0 +1,172 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dsss-transfer.h"
+
+#define MESSAGES 3
+
+struct context_s
+{
+  unsigned char data[MESSAGES][1024];
+  unsigned int size[MESSAGES];
+  unsigned int count;
+};
+
+int receive_message(void *context,
+                    unsigned char *message,
+                    unsigned int message_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+
+  if((ctx->count < MESSAGES) && (message_size <= sizeof(ctx->data[0])))
+  {
+    memcpy(ctx->data[ctx->count], message, message_size);
+    ctx->size[ctx->count] = message_size;
+  }
+  ctx->count++;
+
+  return(message_size);
+}
+
+int main()
+{
+  dsss_transfer_t send;
+  dsss_transfer_t receive;
+  struct context_s context;
+  unsigned char messages[MESSAGES][1024];
+  unsigned int sizes[MESSAGES] = {5, 12, 1000};
+  char samples_file[] = "/tmp/samples.XXXXXX";
+  int samples_fd = mkstemp(samples_file);
+  unsigned int i;
+  unsigned int j;
+  int ok = 0;
+
+  fprintf(stderr, "Test: Send and receive messages\n");
+
+  for(i = 0; i < MESSAGES; i++)
+  {
+    for(j = 0; j < sizes[i]; j++)
+    {
+      messages[i][j] = i + (j * 7);
+    }
+  }
+
+  if(samples_fd == -1)
+  {
+    fprintf(stderr, "Error: Failed to create temporary file\n");
+    return(EXIT_FAILURE);
+  }
+
+  if(dup2(samples_fd, STDIN_FILENO) == -1)
+  {
+    fprintf(stderr, "Error: Failed to redirect standard input\n");
+    return(EXIT_FAILURE);
+  }
+  if(dup2(samples_fd, STDOUT_FILENO) == -1)
+  {
+    fprintf(stderr, "Error: Failed to redirect standard output\n");
+    return(EXIT_FAILURE);
+  }
+
+  send = dsss_transfer_create_callback("io",
+                                       1,
+                                       NULL,
+                                       NULL,
+                                       2000000,
+                                       1200,
+                                       434000000,
+                                       0,
+                                       "0",
+                                       0,
+                                       64,
+                                       "h128",
+                                       "none",
+                                       "",
+                                       NULL,
+                                       0,
+                                       0);
+  if(send == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_set_message_mode(send, NULL, NULL);
+  for(i = 0; i < MESSAGES; i++)
+  {
+    if(dsss_transfer_send_message(send, messages[i], sizes[i]) != 0)
+    {
+      fprintf(stderr, "Error: Failed to queue message\n");
+      return(EXIT_FAILURE);
+    }
+  }
+  dsss_transfer_send_message(send, NULL, 0);
+  dsss_transfer_start(send);
+  dsss_transfer_free(send);
+
+  lseek(samples_fd, 0, SEEK_SET);
+  bzero(&context, sizeof(context));
+  receive = dsss_transfer_create_callback("io",
+                                          0,
+                                          NULL,
+                                          NULL,
+                                          2000000,
+                                          1200,
+                                          434000000,
+                                          0,
+                                          "0",
+                                          0,
+                                          64,
+                                          "h128",
+                                          "none",
+                                          "",
+                                          NULL,
+                                          0,
+                                          0);
+  if(receive == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_set_message_mode(receive, receive_message, &context);
+  dsss_transfer_start(receive);
+  dsss_transfer_free(receive);
+
+  ok = (context.count == MESSAGES);
+  for(i = 0; ok && (i < MESSAGES); i++)
+  {
+    ok = (context.size[i] == sizes[i]) &&
+      (memcmp(context.data[i], messages[i], sizes[i]) == 0);
+  }
+  close(samples_fd);
+  unlink(samples_file);
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
@@ -0,0 +1,162 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dsss-transfer.h"
+
+struct context_s
+{
+  unsigned char data[128];
+  unsigned int size;
+  unsigned int index;
+};
+
+int read_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+  unsigned int size = payload_size;
+
+  if(ctx->index == ctx->size)
+  {
+    return(-1);
+  }
+  if(ctx->index + size > ctx->size)
+  {
+    size = ctx->size - ctx->index;
+  }
+  memcpy(payload, ctx->data + ctx->index, size);
+  ctx->index += size;
+
+  return(size);
+}
+
+int write_data(void *context, unsigned char *payload, unsigned int payload_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+
+  if(ctx->size + payload_size > sizeof(ctx->data))
+  {
+    payload_size = sizeof(ctx->data) - ctx->size;
+  }
+  memcpy(ctx->data + ctx->size, payload, payload_size);
+  ctx->size += payload_size;
+
+  return(payload_size);
+}
+
+int main()
+{
+  dsss_transfer_t send;
+  dsss_transfer_t receive;
+  struct context_s send_context;
+  struct context_s receive_context;
+  char message[] = "This is a test transmission using dsss-transfer.";
+  float samples[2 * 4096];
+  unsigned int n;
+  int ok = 0;
+
+  fprintf(stderr, "Test: Send and receive using external samples\n");
+
+  bzero(&send_context, sizeof(send_context));
+  strcpy(send_context.data, message);
+  send_context.size = strlen(message);
+  send = dsss_transfer_create_callback("external",
+                                       1,
+                                       read_data,
+                                       &send_context,
+                                       2000000,
+                                       1200,
+                                       434000000,
+                                       0,
+                                       "0",
+                                       0,
+                                       64,
+                                       "h128",
+                                       "none",
+                                       "",
+                                       NULL,
+                                       0,
+                                       0);
+  if(send == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    return(EXIT_FAILURE);
+  }
+
+  bzero(&receive_context, sizeof(receive_context));
+  receive = dsss_transfer_create_callback("external",
+                                          0,
+                                          write_data,
+                                          &receive_context,
+                                          2000000,
+                                          1200,
+                                          434000000,
+                                          0,
+                                          "0",
+                                          0,
+                                          64,
+                                          "h128",
+                                          "none",
+                                          "",
+                                          NULL,
+                                          0,
+                                          0);
+  if(receive == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    dsss_transfer_free(send);
+    return(EXIT_FAILURE);
+  }
+
+  if((dsss_transfer_start_async(send) == 0) &&
+     (dsss_transfer_start_async(receive) == 0))
+  {
+    /* Move the samples from the sender to the receiver like an external
+     * signal processing chain would do */
+    do
+    {
+      n = dsss_transfer_pull_samples(send, samples, 4096);
+      if(dsss_transfer_push_samples(receive, samples, n) != n)
+      {
+        fprintf(stderr, "Error: Samples not taken by the receiver\n");
+        break;
+      }
+    }
+    while(n == 4096);
+    dsss_transfer_push_samples(receive, NULL, 0);
+    dsss_transfer_wait(send);
+    dsss_transfer_wait(receive);
+    ok = (receive_context.size == strlen(message)) &&
+      (memcmp(message, receive_context.data, receive_context.size) == 0);
+  }
+  dsss_transfer_free(send);
+  dsss_transfer_free(receive);
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
@@ -0,0 +1,142 @@
+/*
+This file is part of dsss-transfer, a program to send or receive data
+by software defined radio using the DSSS modulation.
+
+Copyright 2022 Guillaume LE VAILLANT
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dsss-transfer.h"
+
+struct context_s
+{
+  unsigned char data[1024];
+  unsigned int size;
+  unsigned int count;
+};
+
+int receive_message(void *context,
+                    unsigned char *message,
+                    unsigned int message_size)
+{
+  struct context_s *ctx = (struct context_s *) context;
+
+  if(message_size <= sizeof(ctx->data))
+  {
+    memcpy(ctx->data, message, message_size);
+    ctx->size = message_size;
+  }
+  ctx->count++;
+
+  return(message_size);
+}
+
+/* Send a message, then receive it with the same transfer */
+int exchange(dsss_transfer_t transfer,
+             struct context_s *context,
+             unsigned char *message,
+             unsigned int message_size)
+{
+  dsss_transfer_set_direction(transfer, 1, NULL);
+  if(dsss_transfer_send_message(transfer, message, message_size) != 0)
+  {
+    fprintf(stderr, "Error: Failed to queue message\n");
+    return(0);
+  }
+  dsss_transfer_send_message(transfer, NULL, 0);
+  dsss_transfer_start(transfer);
+
+  bzero(context, sizeof(struct context_s));
+  dsss_transfer_set_direction(transfer, 0, NULL);
+  dsss_transfer_start(transfer);
+
+  return((context->count == 1) &&
+         (context->size == message_size) &&
+         (memcmp(context->data, message, message_size) == 0));
+}
+
+int main()
+{
+  dsss_transfer_t transfer;
+  struct context_s context;
+  unsigned char message1[] = "Request";
+  unsigned char message2[] = "Response to the request";
+  unsigned char message3[] = "Request at another bit rate";
+  char samples_file[] = "/tmp/samples.XXXXXX";
+  char radio[64];
+  int samples_fd = mkstemp(samples_file);
+  int ok = 0;
+
+  fprintf(stderr, "Test: Switch the direction and reconfigure a transfer\n");
+
+  if(samples_fd == -1)
+  {
+    fprintf(stderr, "Error: Failed to create temporary file\n");
+    return(EXIT_FAILURE);
+  }
+  close(samples_fd);
+  snprintf(radio, sizeof(radio), "file=%s", samples_file);
+
+  transfer = dsss_transfer_create_callback(radio,
+                                           1,
+                                           NULL,
+                                           NULL,
+                                           2000000,
+                                           1200,
+                                           434000000,
+                                           0,
+                                           "0",
+                                           0,
+                                           64,
+                                           "h128",
+                                           "none",
+                                           "",
+                                           NULL,
+                                           0,
+                                           0);
+  if(transfer == NULL)
+  {
+    fprintf(stderr, "Error: Failed to initialize transfer\n");
+    unlink(samples_file);
+    return(EXIT_FAILURE);
+  }
+  dsss_transfer_set_message_mode(transfer, receive_message, &context);
+
+  ok = exchange(transfer, &context, message1, sizeof(message1));
+  if(ok)
+  {
+    dsss_transfer_set_frequency(transfer, 434100000);
+    ok = exchange(transfer, &context, message2, sizeof(message2));
+  }
+  if(ok)
+  {
+    dsss_transfer_reconfigure(transfer, 2400, 0, NULL, "rs8", "h74");
+    ok = exchange(transfer, &context, message3, sizeof(message3));
+  }
+  dsss_transfer_free(transfer);
+  unlink(samples_file);
+
+  if(ok)
+  {
+    return(EXIT_SUCCESS);
+  }
+  else
+  {
+    return(EXIT_FAILURE);
+  }
+}
@@ -83,6 +83,54 @@ check_nok_io "Wrong bit rate 100 150" "-b 100" "-b 150"
 check_ok_io "Frequency offset 200000" "-o 200000" "-o 200000"
 check_ok_file "Frequency offset -123456" "-o -123456" "-o -123456"
 check_nok_io "Wrong frequency offset 200000 250000" "-o 200000" "-o 250000"
+check_ok_io "Acquisition range 5000" "-o 200000" "-o 203000 -A 5000"
+check_ok_file "Acquisition range 20000" "-o -100000" "-o -112345 -A 20000"
+check_ok_io "Automatic clock correction" "-o 200000" "-o 200300 -c auto"
+check_ok_io "Preamble size 32" "-p 32" "-p 32"
+check_ok_file "Preamble size 256, threshold 0.3" "-p 256" "-p 256 -P 0.3"
+check_ok_file "Preamble size 1024" "-p 1024" "-p 1024"
+check_nok_io "Wrong preamble size 64 128" "-p 64" "-p 128"
+check_ok_io "Tracking" "" "-C"
+check_ok_io "Extended header" "-X" "-X"
+check_ok_file "Extended header, superframes of 4" "-X -S 4" "-X"
+check_nok_io "Extended header only when sending" "-X" ""
+: > ${DECODED}
+check_ok_io "Random access output" "-X" "-R"
+test ! -e ${DECODED}.map
+check_ok_file "Random access output, superframes of 4" "-X -S 4" "-R -X"
+check_ok_io "Carousel, 3 passes" "-L 3" "-R"
+check_ok_io "Carousel, receiver without random access" "-L 2" "-X"
+check_ok_io "Soft combining" "" "-K 16"
+check_ok_io "Carousel, soft combining" "-L 2" "-R -K 16"
+
+echo "Test: Resumed transfer"
+: > ${DECODED}
+${DSSS_TRANSFER} -t -r io -X -F 20 ${MESSAGE} > ${SAMPLES}
+${DSSS_TRANSFER} -r io -R ${DECODED} < ${SAMPLES}
+test -e ${DECODED}.map
+${DSSS_TRANSFER} -t -r io -X ${MESSAGE} > ${SAMPLES}
+${DSSS_TRANSFER} -r io -R ${DECODED} < ${SAMPLES}
+diff -q ${MESSAGE} ${DECODED} > /dev/null
+test ! -e ${DECODED}.map
+
+check_ok_io "Erasure coding 8,4" "-E 8,4" "-E 8"
+check_ok_io "Frequency hopping" "-J 8,50000" "-J 8,50000"
+check_ok_io "Narrowband excision" "" "-N"
+check_nok_io "Frequency hopping only when sending" "-J 8,50000" ""
+check_nok_io "Frequency hopping rejected with interleaving" \
+             "-I 4 -J 8,50000" \
+             "-J 8,50000"
+check_nok_io "Frequency hopping rejected with tracking" \
+             "-J 8,50000" \
+             "-C -J 8,50000"
+check_ok_io "Diversity reception" "" "-M file=${SAMPLES}"
+check_ok_io "Diversity reception, extended header" \
+            "-X" \
+            "-X -M file=${SAMPLES} -M file=${SAMPLES}"
+check_ok_io "Interleaving 4" "-I 4 -e g2412" "-e g2412"
+check_ok_file "Interleaving 16, superframes of 4" "-I 16 -S 4" ""
+check_nok_io "Erasure coding only when sending" "-E 8,4" ""
+check_ok_file "Tracking, bit rate 1200" "-b 1200" "-b 1200 -C"
 check_ok_io "Sample rate 4000000" "-s 4000000" "-s 4000000"
 check_ok_file "Sample rate 10000000" "-s 10000000" "-s 10000000"
 check_nok_io "Wrong sample rate 1000000 2000000" "-s 1000000" "-s 2000000"
@@ -90,6 +138,12 @@ check_ok_io "Spreading factor 2" "-n 2" "-n 2"
 check_ok_file "Spreading factor 10" "-n 10" "-n 10"
 check_nok_io "Wrong spreading factor 30 29" "-n 30" "-n 29"
 check_ok_io "FEC Hamming(7/4)" "-e h74" "-e h74"
+check_ok_io "Header FEC Hamming(8/4)" "-H h84" "-H h84"
+check_ok_file "Header FEC Hamming(12/8) and CRC16, FEC Golay(24/12) and repeat(3)" \
+              "-H h128,none,crc16 -e g2412,rep3" \
+              "-H h128,none,crc16 -e g2412,rep3"
+check_nok_io "Wrong header FEC h84 g2412" "-H h84" "-H g2412"
+check_ok_io "Default header FEC same as payload FEC" "-e h74 -H h74" "-e h74"
 check_ok_file "FEC Golay(24/12) and repeat(3)" "-e g2412,rep3" "-e g2412,rep3"
 check_ok_io "Id a1B2" "-i a1B2" "-i a1B2"
 check_nok_file "Wrong id ABCD ABC" "-i ABCD" "-i ABC"
@@ -107,6 +161,15 @@ dd if=/dev/random of=${MESSAGE} bs=1000 count=200 status=none
 check_ok_file "Bit rate 8000000, sample rate 100000000, spreading 8" \
               "-s 100000000 -n 8 -b 8000000" \
               "-s 100000000 -n 8 -b 8000000"
+check_ok_file "Tracking, bit rate 8000000, sample rate 100000000, spreading 8" \
+              "-s 100000000 -n 8 -b 8000000" \
+              "-s 100000000 -n 8 -b 8000000 -C"
+check_ok_file "Superframes of 16 frames" \
+              "-s 100000000 -n 8 -b 8000000 -S 16" \
+              "-s 100000000 -n 8 -b 8000000"
+check_ok_file "Erasure coding 32,8, bit rate 8000000" \
+              "-s 100000000 -n 8 -b 8000000 -E 32,8" \
+              "-s 100000000 -n 8 -b 8000000 -E 1 -C"
 
-rm -f ${MESSAGE} ${DECODED} ${SAMPLES}
+rm -f ${MESSAGE} ${DECODED} ${DECODED}.map ${SAMPLES}
 echo "All tests passed."